@@ -18,7 +18,10 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <queue>
@@ -28,6 +31,9 @@
 #include "BoostAliases.h"
 #include "Common.h"
 #include "Compat.h"
+#include "Compression.h"
+#include "TFrameReader.h"
+#include "TOutboundQueue.h"
 #include "VehicleData.h"
 
 class TServer;
@@ -42,10 +48,37 @@ struct TConnection final {
     ip::tcp::endpoint SockAddr;
 };
 
-class TClient final {
+// State of a client which is handled by the asynchronous (reactor) networking mode,
+// see `TNetwork::StartAsyncClient`. Everything except `Strand` is only ever touched
+// from within `Strand`.
+struct TAsyncClientState {
+    explicit TAsyncClientState(io_context& IoCtx)
+        : Strand(make_strand(IoCtx)) { }
+
+    strand<io_context::executor_type> Strand;
+    // a packet and its size header, written without copying them together
+    struct TFrame {
+        std::array<uint8_t, sizeof(int32_t)> Header;
+        TSharedBuffer Data;
+    };
+    // frames waiting to be written, and the frames of the write in progress
+    std::deque<TFrame> WriteQueue;
+    std::vector<TFrame> InFlight;
+    bool Writing { false };
+    bool CloseAfterWrite { false };
+    bool Finished { false };
+};
+
+class TClient final : public std::enable_shared_from_this<TClient> {
 public:
     using TSetOfVehicleData = std::vector<TVehicleData>;
 
+    // optional protocol extensions, which a client announces with an `Xc` packet
+    enum TCapability : uint32_t {
+        CapPositionDeltas = 1 << 0,
+        CapPositionBatches = 1 << 1,
+    };
+
     struct TVehicleDataLockPair {
         TSetOfVehicleData* VehicleData;
         std::unique_lock<std::mutex> Lock;
@@ -58,18 +91,16 @@ public:
 
     void AddNewCar(int Ident, const std::string& Data);
     void SetCarData(int Ident, const std::string& Data);
-    void SetCarPosition(int Ident, const std::string& Data);
     TVehicleDataLockPair GetAllCars();
     void SetName(const std::string& Name) { mName = Name; }
     void SetRoles(const std::string& Role) { mRole = Role; }
     void SetIdentifier(const std::string& key, const std::string& value) { mIdentifiers[key] = value; }
     std::string GetCarData(int Ident);
-    std::string GetCarPositionRaw(int Ident);
     void SetUDPAddr(const ip::udp::endpoint& Addr) { mUDPAddress = Addr; }
     void SetDownSock(ip::tcp::socket&& CSock) { mDownSocket = std::move(CSock); }
     void SetTCPSock(ip::tcp::socket&& CSock) { mSocket = std::move(CSock); }
     void Disconnect(std::string_view Reason);
-    bool IsDisconnected() const { return !mSocket.is_open(); }
+    bool IsDisconnected() const { return mIsDisconnecting || !mSocket.is_open(); }
     // locks
     void DeleteCar(int Ident);
     [[nodiscard]] const std::unordered_map<std::string, std::string>& GetIdentifiers() const { return mIdentifiers; }
@@ -79,6 +110,9 @@ public:
     [[nodiscard]] const ip::tcp::socket& GetDownSock() const { return mDownSocket; }
     [[nodiscard]] ip::tcp::socket& GetTCPSock() { return mSocket; }
     [[nodiscard]] const ip::tcp::socket& GetTCPSock() const { return mSocket; }
+    // the peer address of the TCP connection, taken once when it's accepted, so other
+    // threads don't need to touch the socket for it. Unspecified if it couldn't be read.
+    [[nodiscard]] const ip::address& GetTCPAddress() const { return mTCPAddress; }
     [[nodiscard]] std::string GetRoles() const { return mRole; }
     [[nodiscard]] std::string GetName() const { return mName; }
     void SetUnicycleID(int ID) { mUnicycleID = ID; }
@@ -95,33 +129,68 @@ public:
     void SetIsGuest(bool NewIsGuest) { mIsGuest = NewIsGuest; }
     void SetIsSynced(bool NewIsSynced) { mIsSynced = NewIsSynced; }
     void SetIsSyncing(bool NewIsSyncing) { mIsSyncing = NewIsSyncing; }
-    void EnqueuePacket(const std::vector<uint8_t>& Packet);
-    [[nodiscard]] std::queue<std::vector<uint8_t>>& MissedPacketQueue() { return mPacketsSync; }
-    [[nodiscard]] const std::queue<std::vector<uint8_t>>& MissedPacketQueue() const { return mPacketsSync; }
-    [[nodiscard]] size_t MissedPacketQueueSize() const { return mPacketsSync.size(); }
-    [[nodiscard]] std::mutex& MissedPacketQueueMutex() const { return mMissedPacketsMutex; }
+    // queues a packet to be sent once the client is synced. Never blocks. If `SupersedeKey`
+    // isn't 0, the packet is dropped if a newer packet with the same key is queued before
+    // it is sent. A client whose queue exceeds Network.MaxQueuedPackets or
+    // Network.MaxQueuedMB is disconnected.
+    void EnqueuePacket(TSharedBuffer Packet, uint32_t SupersedeKey = 0);
+    // only the flushing thread (Looper, or the strand in async mode) may consume from this
+    [[nodiscard]] TOutboundQueue& MissedPacketQueue() { return mPacketsSync; }
+    // consumer only. Like TOutboundQueue::DrainInto, but skips superseded packets.
+    size_t DrainMissedPackets(std::vector<TSharedBuffer>& Out, size_t Max);
+    [[nodiscard]] size_t MissedPacketQueueSize() const { return mPacketsSync.Size(); }
+    [[nodiscard]] size_t MissedPacketQueueBytes() const { return mPacketsSync.Bytes(); }
+    // packets which were never sent, because a newer one replaced them
+    [[nodiscard]] uint64_t SupersededPackets() const { return mSupersede.Superseded(); }
     void SetIsConnected(bool NewIsConnected) { mIsConnected = NewIsConnected; }
+    void AddCapabilities(uint32_t Capabilities) { mCapabilities |= Capabilities; }
+    [[nodiscard]] bool HasCapability(TCapability Capability) const { return (mCapabilities & Capability) != 0; }
+    // the codec packets to this client are compressed with, zlib unless it negotiated another one
+    void SetCodec(const ICodec& Codec) { mCodec = &Codec; }
+    [[nodiscard]] const ICodec& Codec() const { return *mCodec.load(); }
+    // limits how much decompressed data this client may send, see Network.DecompressionBudgetKBps
+    [[nodiscard]] TDecompressionBudget& DecompressionBudget() { return mDecompressionBudget; }
+    // only the thread reading from the TCP socket (the client's thread, or the strand in async mode) may use this
+    [[nodiscard]] TFrameReader& FrameReader() { return mFrameReader; }
     [[nodiscard]] TServer& Server() const;
     void UpdatePingTime();
     int SecondsSinceLastPing();
+    // switches this client to the asynchronous networking mode. `OnOutbound` is called
+    // (from any thread) whenever there may be new queued packets to flush.
+    void MakeAsync(std::function<void()> OnOutbound);
+    [[nodiscard]] bool IsAsync() const { return mIsAsync; }
+    [[nodiscard]] TAsyncClientState& AsyncState() { return mAsyncState; }
+    // notifies whoever flushes the missed packet queue that there may be work to do
+    void NotifyOutbound();
+    // used with WaitForOutbound to sleep until the next NotifyOutbound
+    [[nodiscard]] uint32_t OutboundSignal() const { return mOutboundSignal.load(); }
+    // blocks until NotifyOutbound was called since `Seen` was obtained via OutboundSignal()
+    void WaitForOutbound(uint32_t Seen) const { mOutboundSignal.wait(Seen); }
+    // closes the sockets immediately, must be called from the strand in async mode
+    void CloseSockets();
 
 private:
     void InsertVehicle(int ID, const std::string& Data);
 
     TServer& mServer;
     bool mIsConnected = false;
-    bool mIsSynced = false;
-    bool mIsSyncing = false;
-    mutable std::mutex mMissedPacketsMutex;
-    std::queue<std::vector<uint8_t>> mPacketsSync;
+    std::atomic<bool> mIsSynced = false;
+    std::atomic<bool> mIsSyncing = false;
+    // packets which are held back while the client is syncing
+    const size_t mMaxQueuedPackets;
+    const size_t mMaxQueuedBytes;
+    TOutboundQueue mPacketsSync;
+    TDecompressionBudget mDecompressionBudget;
+    TFrameReader mFrameReader;
+    TSupersedeFilter mSupersede;
+    std::atomic<uint32_t> mOutboundSignal { 0 };
     std::unordered_map<std::string, std::string> mIdentifiers;
     bool mIsGuest = false;
     mutable std::mutex mVehicleDataMutex;
-    mutable std::mutex mVehiclePositionMutex;
     TSetOfVehicleData mVehicleData;
-    SparseArray<std::string> mVehiclePosition;
     std::string mName = "Unknown Client";
     ip::tcp::socket mSocket;
+    const ip::address mTCPAddress;
     ip::tcp::socket mDownSocket;
     ip::udp::endpoint mUDPAddress {};
     int mUnicycleID = -1;
@@ -129,6 +198,12 @@ private:
     std::string mDID;
     int mID = -1;
     std::chrono::time_point<std::chrono::high_resolution_clock> mLastPingTime = std::chrono::high_resolution_clock::now();
+    std::atomic<bool> mIsAsync { false };
+    std::atomic<bool> mIsDisconnecting { false };
+    std::atomic<uint32_t> mCapabilities { 0 };
+    std::atomic<const ICodec*> mCodec { &Compression::Zlib() };
+    std::function<void()> mOnOutbound;
+    TAsyncClientState mAsyncState;
 };
 
 std::optional<std::weak_ptr<TClient>> GetClient(class TServer& Server, int ID);
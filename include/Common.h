@@ -263,6 +263,7 @@ void RegisterThread(const std::string& str);
 
 void LogChatMessage(const std::string& name, int id, const std::string& msg);
 
+// plain zlib data, without a codec prefix (see Compression.h)
 std::vector<uint8_t> Comp(std::span<const uint8_t> input);
 std::vector<uint8_t> DeComp(std::span<const uint8_t> input);
 
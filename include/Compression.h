@@ -0,0 +1,128 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+/*
+ * Packet compression.
+ *
+ * A compressed packet starts with the 4 byte prefix of the codec it was compressed with
+ * ("ABG:" for zlib), followed by the compressed data. Every client understands zlib,
+ * other codecs are only used for clients which announced support for them (see
+ * TServer::HandleCapabilities). Packets from clients are accepted in zlib and in the codec
+ * the client chose.
+ *
+ * zlib can also be used with a preset dictionary of strings which are common in vehicle
+ * packets (see tools/TrainDictionary.cpp). Such a codec is named after the dictionary's ID,
+ * so that only clients with the same dictionary select it.
+ *
+ * The codecs keep one (de)compression context per thread and reset it for every packet,
+ * instead of setting up a new one each time. Decompression streams into buffers from a
+ * shared pool and stops as soon as the output would exceed the allowed size.
+ */
+
+#include "TBufferPool.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <vector>
+
+class ICodec {
+public:
+    virtual ~ICodec() = default;
+
+    // the name used in capability packets
+    [[nodiscard]] virtual std::string_view Name() const = 0;
+    [[nodiscard]] virtual std::string_view Prefix() const = 0;
+    // appends the compressed data to `Out`. Throws std::runtime_error.
+    virtual void Compress(std::span<const uint8_t> Input, std::vector<uint8_t>& Out) const = 0;
+    // appends the decompressed data to `Out`. Throws std::runtime_error if the data is invalid
+    // or would decompress into more than `MaxSize` bytes.
+    virtual void Decompress(std::span<const uint8_t> Input, std::vector<uint8_t>& Out, size_t MaxSize) const = 0;
+};
+
+/*
+ * Limits how much decompressed data a client may produce: a token bucket which is refilled
+ * with `BytesPerSecond` and holds at most `Burst` bytes. A packet which would decompress
+ * into more than is left is rejected after producing at most that many bytes, and still
+ * costs them.
+ */
+class TDecompressionBudget {
+public:
+    using TClock = std::chrono::steady_clock;
+
+    // 0 bytes per second means unlimited
+    TDecompressionBudget(uint64_t BytesPerSecond, uint64_t Burst);
+
+    [[nodiscard]] bool IsLimited() const { return mBytesPerSecond != 0; }
+    // how many bytes the next packet may decompress into
+    [[nodiscard]] size_t Available(TClock::time_point Now = TClock::now());
+    void Consume(size_t Bytes);
+
+private:
+    const uint64_t mBytesPerSecond;
+    const uint64_t mBurst;
+    std::mutex mMutex;
+    double mTokens;
+    TClock::time_point mLastRefill;
+};
+
+namespace Compression {
+
+// clients have a similar limit, so larger packets are rejected instead of being a way to
+// make us allocate huge amounts of memory with few bytes
+constexpr size_t MaxDecompressedSize = 30 * 1024 * 1024;
+// zlib only looks back this far
+constexpr size_t MaxDictionarySize = 32 * 1024;
+
+[[nodiscard]] const ICodec& Zlib();
+// all codecs this build supports, zlib first
+[[nodiscard]] std::span<const ICodec* const> Codecs();
+// the adler32 checksum of the dictionary, which zlib also stores in the stream
+[[nodiscard]] uint32_t DictionaryID(std::span<const uint8_t> Dictionary);
+// a codec "zdict-<ID>" using this dictionary, which isn't added to Codecs(). Throws
+// std::runtime_error if the dictionary is empty or too large.
+[[nodiscard]] std::unique_ptr<ICodec> MakeDictionaryCodec(std::vector<uint8_t> Dictionary);
+// adds the codec "zdict-<ID>" using this dictionary. Must be called before any packets are
+// handled, and only once. Throws std::runtime_error.
+const ICodec& LoadDictionary(std::vector<uint8_t> Dictionary);
+// nullptr if there's no such codec
+[[nodiscard]] const ICodec* Find(std::string_view Name);
+// the codec whose prefix the packet starts with, or nullptr if it isn't compressed
+[[nodiscard]] const ICodec* CodecOf(std::span<const uint8_t> Packet);
+
+// prefix and compressed data, in one buffer
+[[nodiscard]] std::vector<uint8_t> CompressPacket(const ICodec& Codec, std::span<const uint8_t> Data);
+// returns the packet as-is if it isn't compressed. Otherwise, the compressed packet goes back
+// into the pool, and so should the result once it's no longer needed.
+// Throws std::runtime_error if the packet is invalid or decompresses into more than
+// MaxDecompressedSize bytes or what's left of `Budget`. A packet which fails uses up all of
+// what it was allowed to decompress into. If `Negotiated` is given, packets in codecs other
+// than zlib and that one are rejected, too.
+[[nodiscard]] std::vector<uint8_t> DecompressPacket(std::vector<uint8_t>&& Packet, TDecompressionBudget* Budget = nullptr, const ICodec* Negotiated = nullptr);
+
+// packet buffers, for receiving and decompressing
+[[nodiscard]] TBufferPool& BufferPool();
+
+}
@@ -0,0 +1,69 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+/*
+ * Sends (parts of) files over a socket without loading them into memory.
+ *
+ * On Linux the data goes straight from the page cache to the socket with sendfile(),
+ * everywhere else (and if sendfile() isn't supported for the file) it is written from
+ * the file's mapping, or streamed through a small buffer if it isn't mapped.
+ */
+
+#include "BoostAliases.h"
+#include "TMappedFile.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace FileTransfer {
+
+// size of the buffer used when sendfile() isn't available
+constexpr size_t FallbackBufferSize = 64 * 1024;
+// size of the chunks a throttled transfer is split into
+constexpr size_t ThrottledChunkSize = 64 * 1024;
+
+// a transfer whose peer doesn't take any data for this long is aborted
+constexpr std::chrono::seconds StallTimeout { 30 };
+
+// called with the size of the next chunk before it's sent, may block to limit the rate.
+// Returning false cancels the transfer.
+using TThrottle = std::function<bool(uint64_t)>;
+// called regularly while waiting for the peer to take more data. Returning false cancels
+// the transfer, e.g. because the client disconnected.
+using TIsAlive = std::function<bool()>;
+
+struct TResult {
+    bool Ok { false };
+    // bytes sent with sendfile(), and bytes which went through the fallback buffer
+    uint64_t ZeroCopyBytes { 0 };
+    uint64_t CopiedBytes { 0 };
+    std::string Error;
+};
+
+// sends `Size` bytes of the file, starting at `Offset`. Blocks until everything was sent
+// or an error occurred.
+TResult SendRange(ip::tcp::socket& Socket, const TMappedFile& File, uint64_t Offset, uint64_t Size, const TThrottle& Throttle = {}, const TIsAlive& IsAlive = {});
+// same as above, opens the file just for this transfer
+TResult SendRange(ip::tcp::socket& Socket, const std::string& Path, uint64_t Offset, uint64_t Size);
+
+}
@@ -20,6 +20,7 @@
 
 #include <Common.h>
 #include <IThreaded.h>
+#include <atomic>
 #include <filesystem>
 #include <string>
 #include <unordered_map>
@@ -37,6 +38,9 @@
 
 namespace fs = std::filesystem;
 
+class TBandwidthScheduler;
+class TResourceManager;
+
 namespace Http {
 std::string GET(const std::string& host, int port, const std::string& target, unsigned int* status = nullptr);
 std::string POST(const std::string& host, int port, const std::string& target, const std::string& body, const std::string& ContentType, unsigned int* status = nullptr, const httplib::Headers& headers = {});
@@ -48,13 +52,25 @@ const std::string ErrorString = "-1";
 namespace Server {
     class THttpServerInstance {
     public:
-        THttpServerInstance();
+        // mod downloads share `Bandwidth` with the ones over the game protocol
+        THttpServerInstance(TResourceManager& ResourceManager, TBandwidthScheduler& Bandwidth);
+        ~THttpServerInstance();
 
     protected:
         void operator()();
 
     private:
+        void ServeModList(httplib::Response& res);
+        void ServeMod(const httplib::Request& req, httplib::Response& res);
+        // stops the server and waits for its thread, may be called more than once
+        void Stop();
+
+        TResourceManager& mResourceManager;
+        TBandwidthScheduler& mBandwidth;
+        std::unique_ptr<httplib::Server> mServer;
         std::thread mThread;
+        std::atomic<bool> mStopping { false };
+        std::atomic<bool> mListening { false };
     };
 }
 }
@@ -87,7 +87,40 @@ struct Settings {
         General_LogChat,
         General_ResourceFolder,
         General_Debug,
-        General_AllowGuests
+        General_AllowGuests,
+        General_AuthProvider,
+        General_AuthBackend,
+        General_AuthFile,
+
+        // [Network]
+        Network_AsyncIO,
+        Network_IoThreads,
+        Network_UDPThreads,
+        Network_InterestManagement,
+        Network_InterestNearRadius,
+        Network_InterestFarRadius,
+        Network_InterestMidInterval,
+        Network_InterestFarInterval,
+        Network_PositionTickRate,
+        Network_PositionDeltas,
+        Network_MaxQueuedPackets,
+        Network_MaxQueuedMB,
+        Network_AuthWorkers,
+        Network_AuthCacheSeconds,
+        Network_HandshakeWorkers,
+        Network_MaxPendingHandshakes,
+        Network_HandshakeTimeout,
+        Network_UplinkKBps,
+        Network_GameplayReserveKBps,
+        Network_DecompressionBudgetKBps,
+        Network_CompressionDictionary,
+        Network_ReceiveQuotaMB,
+
+        // [HTTP]
+        HTTP_Enabled,
+        HTTP_Ip,
+        HTTP_Port,
+        HTTP_ModMirror
     };
 
     Sync<std::unordered_map<Key, SettingsTypeVariant>> SettingsMap;
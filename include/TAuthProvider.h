@@ -0,0 +1,97 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+/*
+ * Turns the key a client sends when joining into an identity (name, roles, ...).
+ *
+ * The default provider asks the BeamMP authentication backend. The file provider reads
+ * a fixed list of keys from a json file instead, which is useful for LAN events without
+ * internet access and for load tests:
+ *
+ *     {
+ *         "some-key": { "username": "Player1", "roles": "USER", "guest": false, "identifiers": ["beammp:1"] }
+ *     }
+ */
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct TAuthRequest {
+    std::string Key;
+    std::string ClientIp;
+};
+
+struct TAuthIdentity {
+    std::string Username;
+    std::string Roles;
+    bool Guest { false };
+    // "beammp:1234" is { "beammp", "1234" }
+    std::vector<std::pair<std::string, std::string>> Identifiers;
+
+    // parses the backend's json format, nullopt if it's invalid
+    static std::optional<TAuthIdentity> FromJson(const std::string& Json);
+};
+
+struct TAuthResult {
+    std::optional<TAuthIdentity> Identity;
+    // reason shown to the client if there is no identity
+    std::string Error;
+    // errors which are not the client's fault (backend down, ...) are never cached
+    bool Cacheable { true };
+};
+
+class IAuthProvider {
+public:
+    virtual ~IAuthProvider() = default;
+    // may block, is called from the auth worker threads
+    virtual TAuthResult Authenticate(const TAuthRequest& Request) = 0;
+    [[nodiscard]] virtual std::string Name() const = 0;
+};
+
+class TBackendAuthProvider : public IAuthProvider {
+public:
+    TBackendAuthProvider(std::string Host, int Port, std::string AuthKey);
+    TAuthResult Authenticate(const TAuthRequest& Request) override;
+    [[nodiscard]] std::string Name() const override { return "backend (" + mHost + ")"; }
+
+private:
+    std::string mHost;
+    int mPort;
+    std::string mAuthKey;
+};
+
+class TFileAuthProvider : public IAuthProvider {
+public:
+    // throws std::runtime_error if the file can't be read or is invalid
+    explicit TFileAuthProvider(const std::filesystem::path& Path);
+    TAuthResult Authenticate(const TAuthRequest& Request) override;
+    [[nodiscard]] std::string Name() const override { return "file (" + mPath + ")"; }
+
+private:
+    std::string mPath;
+    std::vector<std::pair<std::string, TAuthIdentity>> mIdentities;
+};
+
+// the provider selected with General.AuthProvider
+std::unique_ptr<IAuthProvider> MakeAuthProviderFromSettings();
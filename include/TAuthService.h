@@ -0,0 +1,101 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+/*
+ * Runs authentication requests on a fixed number of worker threads, so that no more
+ * than that many requests are sent to the provider at once, no matter how many players
+ * join at the same time.
+ *
+ * Successful results are cached for a short time per key and IP, so that reconnecting
+ * players (after a server restart, for example) don't need another backend round trip.
+ * Concurrent requests for the same key and IP share one provider call.
+ *
+ * Results are handed to a callback, so that nobody has to block a thread waiting for a
+ * slow or unreachable backend.
+ */
+
+#include "TAuthProvider.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class TAuthService {
+public:
+    // `CacheTTL` of 0 disables the cache. Requests beyond `MaxPending` waiting ones are
+    // rejected right away. Without a provider, every request fails.
+    TAuthService(std::unique_ptr<IAuthProvider> Provider, size_t Workers, std::chrono::seconds CacheTTL, size_t MaxPending = 256);
+    ~TAuthService();
+
+    TAuthService(const TAuthService&) = delete;
+    TAuthService& operator=(const TAuthService&) = delete;
+
+    using TCallback = std::function<void(const TAuthResult&)>;
+
+    // never blocks. `Done` is called exactly once, from an auth worker, or right away
+    // from this call if the result is already known (cached, rejected, shutting down).
+    void Authenticate(const TAuthRequest& Request, TCallback Done);
+    // never blocks
+    std::shared_future<TAuthResult> Authenticate(const TAuthRequest& Request);
+    // stops the workers, requests which haven't started yet fail
+    void Shutdown();
+
+    [[nodiscard]] std::string ProviderName() const { return mProvider ? mProvider->Name() : "none"; }
+    [[nodiscard]] uint64_t CacheHits() const { return mCacheHits.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t ProviderCalls() const { return mProviderCalls.load(std::memory_order_relaxed); }
+
+private:
+    using TClock = std::chrono::steady_clock;
+    struct TJob {
+        TAuthRequest Request;
+        std::string CacheKey;
+        // everyone who asked for the same key and IP while this was pending
+        std::vector<TCallback> Waiting;
+    };
+    struct TCacheEntry {
+        TAuthResult Result;
+        TClock::time_point Expiry;
+    };
+
+    void WorkerMain();
+
+    std::unique_ptr<IAuthProvider> mProvider;
+    const std::chrono::seconds mCacheTTL;
+    const size_t mMaxPending;
+    std::mutex mMutex;
+    std::condition_variable mJobsChanged;
+    std::deque<std::unique_ptr<TJob>> mJobs;
+    // queued or running jobs by cache key, owned by mJobs or the worker running them
+    std::unordered_map<std::string, TJob*> mInFlight;
+    std::unordered_map<std::string, TCacheEntry> mCache;
+    bool mShutdown { false };
+    std::vector<std::thread> mWorkers;
+    std::atomic<uint64_t> mCacheHits { 0 };
+    std::atomic<uint64_t> mProviderCalls { 0 };
+};
@@ -0,0 +1,88 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+/*
+ * A token bucket shared by all mod downloads, so that together they don't use more than
+ * a fixed rate of the uplink and leave the rest for gameplay traffic.
+ *
+ * Downloads ask for every chunk before sending it. Requests are served strictly in
+ * order, and a download asks for its next chunk only after sending the previous one, so
+ * it lines up behind every other active download. With equal chunk sizes, each download
+ * gets an equal share of the rate.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+class TBandwidthScheduler {
+public:
+    using TClock = std::chrono::steady_clock;
+    // where the scheduler gets the time from, and how it waits for time to pass. Tests
+    // use a fake one.
+    struct TTimeSource {
+        std::function<TClock::time_point()> Now;
+        // waits until `Condition` is notified or at most `Duration`, `Lock` is held again on return
+        std::function<void(std::unique_lock<std::mutex>& Lock, std::condition_variable& Condition, TClock::duration Duration)> WaitFor;
+    };
+    [[nodiscard]] static TTimeSource RealTime();
+
+    // `BytesPerSecond` of 0 means unlimited
+    explicit TBandwidthScheduler(uint64_t BytesPerSecond, TTimeSource Time = RealTime());
+
+    // blocks until `Bytes` may be sent. Returns false if the scheduler was shut down.
+    [[nodiscard]] bool Acquire(uint64_t Bytes);
+    // wakes up and fails all waiting Acquire() calls
+    void Shutdown();
+
+    [[nodiscard]] bool IsLimited() const { return mRate > 0; }
+    [[nodiscard]] uint64_t Rate() const { return mRate; }
+    // Acquire() calls which are currently waiting
+    [[nodiscard]] size_t Waiting() const { return mWaiting.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t BytesGranted() const { return mBytesGranted.load(std::memory_order_relaxed); }
+    // total time spent waiting in Acquire(), over all calls
+    [[nodiscard]] std::chrono::milliseconds TimeWaited() const { return std::chrono::milliseconds(mMsWaited.load(std::memory_order_relaxed)); }
+    // granted bytes per second, measured over the last full second
+    [[nodiscard]] uint64_t CurrentRate();
+
+private:
+    void Refill(TClock::time_point Now);
+
+    const TTimeSource mTime;
+    const uint64_t mRate;
+    // allows a short burst after being idle, but not more than this
+    const double mCapacity;
+    std::mutex mMutex;
+    std::condition_variable mTurnChanged;
+    double mTokens { 0 };
+    TClock::time_point mLastRefill;
+    uint64_t mNextTicket { 0 };
+    uint64_t mServing { 0 };
+    bool mShutdown { false };
+    TClock::time_point mWindowStart;
+    uint64_t mWindowBytes { 0 };
+    uint64_t mLastWindowRate { 0 };
+    std::atomic<size_t> mWaiting { 0 };
+    std::atomic<uint64_t> mBytesGranted { 0 };
+    std::atomic<uint64_t> mMsWaited { 0 };
+};
@@ -0,0 +1,63 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+/*
+ * A pool of byte buffers in power-of-two size classes, so that packet buffers, which are
+ * needed over and over again, don't have to be allocated for every packet.
+ *
+ * Acquire() returns an empty vector with at least the requested capacity. Returning it with
+ * Release() is optional, buffers which are never returned (e.g. because a TSharedBuffer
+ * took them over) are freed as usual. At most `MaxPooledBytes` are kept in the pool.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class TBufferPool {
+public:
+    static constexpr size_t MinClassSize = 1024;
+
+    // buffers larger than `MaxBufferSize` are never pooled
+    TBufferPool(size_t MaxBufferSize, size_t MaxPooledBytes);
+
+    [[nodiscard]] std::vector<uint8_t> Acquire(size_t Capacity);
+    void Release(std::vector<uint8_t>&& Buffer);
+
+    // the smallest size class which fits `Capacity`
+    [[nodiscard]] static size_t ClassSize(size_t Capacity);
+
+    [[nodiscard]] uint64_t Hits() const { return mHits.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t Misses() const { return mMisses.load(std::memory_order_relaxed); }
+    [[nodiscard]] size_t PooledBytes() const;
+
+private:
+    const size_t mMaxBufferSize;
+    const size_t mMaxPooledBytes;
+    mutable std::mutex mMutex;
+    // index i holds buffers with a capacity of at least MinClassSize << i
+    std::vector<std::vector<std::vector<uint8_t>>> mClasses;
+    size_t mPooledBytes { 0 };
+    std::atomic<uint64_t> mHits { 0 };
+    std::atomic<uint64_t> mMisses { 0 };
+};
@@ -0,0 +1,84 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+/*
+ * Splits a client's TCP stream into packets, each of which is preceded by its size as a
+ * 32 bit integer.
+ *
+ * Every read fills as much of the connection's buffer as the socket has data for, and
+ * any number of complete packets are then taken out of it. Reading ahead is fine, but
+ * the buffer only grows as the data of a large packet actually arrives, so claiming a
+ * huge size in a header costs nothing. The buffer never grows beyond the quota, and a
+ * packet which claims to be larger than that is rejected right away.
+ *
+ * Only one thread at a time may use a reader.
+ */
+
+#include "TBufferPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+class TFrameReader {
+public:
+    enum class TStatus {
+        Packet,
+        NeedMore,
+        NegativeSize,
+        TooLarge,
+    };
+
+    static constexpr size_t HeaderSize = sizeof(int32_t);
+    // how much each read asks for at least, unless the quota is smaller
+    static constexpr size_t MinReadSize = 16 * 1024;
+
+    // `Quota` is the largest packet size accepted
+    TFrameReader(TBufferPool& Pool, size_t Quota);
+    ~TFrameReader();
+
+    TFrameReader(const TFrameReader&) = delete;
+    TFrameReader& operator=(const TFrameReader&) = delete;
+
+    // where the next read should go, never empty after Next() returned NeedMore
+    [[nodiscard]] std::span<uint8_t> WritableSpace();
+    // call after reading `Bytes` into WritableSpace()
+    void Commit(size_t Bytes);
+    // takes the next complete packet out of the buffer. The packet is in a buffer from the
+    // pool, which should go back there once it's no longer needed.
+    [[nodiscard]] TStatus Next(std::vector<uint8_t>& Packet);
+
+    [[nodiscard]] size_t Buffered() const { return mEnd - mBegin; }
+    [[nodiscard]] size_t Capacity() const { return mBuffer.size(); }
+    [[nodiscard]] size_t Quota() const { return mQuota; }
+
+private:
+    // makes room for `Size` bytes from mBegin on
+    void Reserve(size_t Size);
+
+    TBufferPool& mPool;
+    const size_t mQuota;
+    // the buffered data is [mBegin, mEnd)
+    std::vector<uint8_t> mBuffer;
+    size_t mBegin { 0 };
+    size_t mEnd { 0 };
+};
@@ -0,0 +1,119 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+/*
+ * Runs the handshakes of newly accepted connections on a fixed number of worker threads.
+ *
+ * At most `MaxPending` handshakes are queued or running at once, further connections are
+ * turned away by Submit() instead of getting a thread each. Every blocking step of a
+ * handshake should be guarded by a deadline (see Arm()), which calls back (usually to
+ * shut down the socket) if the step takes too long, so an idle or slow peer can only
+ * hold on to a worker for a bounded time.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class THandshakeExecutor {
+public:
+    using TClock = std::chrono::steady_clock;
+
+    // disarms the deadline when destroyed
+    class TDeadline {
+    public:
+        TDeadline() = default;
+        TDeadline(TDeadline&& Other) noexcept;
+        TDeadline& operator=(TDeadline&& Other) noexcept;
+        TDeadline(const TDeadline&) = delete;
+        TDeadline& operator=(const TDeadline&) = delete;
+        ~TDeadline();
+
+        // true if the callback ran, i.e. the step didn't finish in time
+        [[nodiscard]] bool Expired() const { return mExpired && mExpired->load(); }
+        void Disarm();
+
+    private:
+        friend class THandshakeExecutor;
+        THandshakeExecutor* mExecutor { nullptr };
+        std::pair<TClock::time_point, uint64_t> mKey {};
+        std::shared_ptr<std::atomic<bool>> mExpired;
+    };
+
+    THandshakeExecutor(size_t Workers, size_t MaxPending);
+    ~THandshakeExecutor();
+
+    THandshakeExecutor(const THandshakeExecutor&) = delete;
+    THandshakeExecutor& operator=(const THandshakeExecutor&) = delete;
+
+    // never blocks. Returns false if the task was rejected because too many handshakes
+    // are pending, or because of shutdown.
+    [[nodiscard]] bool Submit(std::function<void()> Task);
+    // like Submit(), but not limited by `MaxPending`: for the next step of a handshake which
+    // was already let in, e.g. after an asynchronous lookup. Only fails during shutdown.
+    [[nodiscard]] bool Resume(std::function<void()> Task);
+    // calls `OnExpired` from the watchdog thread if the returned deadline isn't disarmed
+    // (or destroyed) within `Timeout`. Disarming waits for a running callback.
+    [[nodiscard]] TDeadline Arm(TClock::duration Timeout, std::function<void()> OnExpired);
+    // stops the workers after their current task, queued tasks are dropped
+    void Shutdown();
+
+    // queued and running handshakes
+    [[nodiscard]] size_t Pending() const { return mPending.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t Rejected() const { return mRejected.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t TimedOut() const { return mTimedOut.load(std::memory_order_relaxed); }
+
+private:
+    using TTimerKey = std::pair<TClock::time_point, uint64_t>;
+    struct TTimer {
+        std::function<void()> OnExpired;
+        std::shared_ptr<std::atomic<bool>> Expired;
+    };
+
+    bool Enqueue(std::function<void()> Task, bool Limited);
+    void WorkerMain(const std::string& Name);
+    void WatchdogMain();
+    void Disarm(const TTimerKey& Key);
+
+    const size_t mMaxPending;
+    std::mutex mMutex;
+    std::condition_variable mTasksChanged;
+    std::deque<std::function<void()>> mTasks;
+    // ordered by deadline, the id makes equal deadlines unique
+    std::map<TTimerKey, TTimer> mTimers;
+    std::condition_variable mTimersChanged;
+    uint64_t mNextTimerId { 0 };
+    bool mShutdown { false };
+    std::vector<std::thread> mWorkers;
+    std::thread mWatchdog;
+    std::atomic<size_t> mPending { 0 };
+    std::atomic<uint64_t> mRejected { 0 };
+    std::atomic<uint64_t> mTimedOut { 0 };
+};
@@ -0,0 +1,98 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+/*
+ * Decides which players receive a position (Z) packet, based on how far away their
+ * own vehicles are from the vehicle the packet is about. Vehicles are kept in a
+ * uniform 2D grid (x/y) so that only nearby cells need to be looked at.
+ *
+ * Tiers:
+ *  - within NearRadius:           every update
+ *  - within FarRadius:            every MidInterval-th update
+ *  - further away:                every FarInterval-th update, or never if FarInterval is 0
+ *
+ * Players without any (known) vehicles, e.g. spectators, receive everything, as do all
+ * players for vehicles which were spawned only a few seconds ago.
+ */
+
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class TInterestManager {
+public:
+    // must match TServer::MaxClientSlots
+    static constexpr size_t MaxPlayers = 255;
+    using TRecipientSet = std::bitset<MaxPlayers>;
+    using TVec3 = std::array<double, 3>;
+    using TClock = std::chrono::steady_clock;
+
+    struct TConfig {
+        double NearRadius { 300 };
+        double FarRadius { 1000 };
+        int MidInterval { 3 };
+        int FarInterval { 10 };
+        std::chrono::milliseconds SpawnGracePeriod { std::chrono::seconds(5) };
+        // vehicles which didn't send a position for this long are forgotten
+        std::chrono::milliseconds StaleAfter { std::chrono::seconds(10) };
+    };
+
+    // reads the configuration from the settings
+    TInterestManager();
+    explicit TInterestManager(const TConfig& Config, bool Enabled = true);
+
+    [[nodiscard]] bool IsEnabled() const { return mEnabled; }
+
+    // updates the vehicle's position and returns the set of player IDs which should receive this update
+    TRecipientSet OnPosition(int PID, int VID, const TVec3& Position, TClock::time_point Now = TClock::now());
+    void RemovePlayer(int PID);
+    // e.g. after it was deleted, so it no longer counts as interest of its player
+    void RemoveVehicle(int PID, int VID);
+
+private:
+    struct TVehicle {
+        TVec3 Position {};
+        uint64_t Cell { 0 };
+        uint64_t Sequence { 0 };
+        TClock::time_point FirstSeen;
+        TClock::time_point LastSeen;
+    };
+
+    // positions far outside any map end up in the outermost cells
+    [[nodiscard]] uint64_t CellOf(const TVec3& Position) const;
+    void EraseFromCell(uint64_t Cell, uint64_t Key);
+    void RemoveStale(TClock::time_point Now);
+
+    const TConfig mConfig;
+    const bool mEnabled;
+    const double mCellSize;
+    std::mutex mMutex;
+    // key is (PID << 32) | VID
+    std::unordered_map<uint64_t, TVehicle> mVehicles;
+    std::unordered_map<uint64_t, std::vector<uint64_t>> mGrid;
+    std::array<uint16_t, MaxPlayers> mVehicleCounts {};
+    TClock::time_point mLastStaleCheck {};
+};
@@ -0,0 +1,65 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+/*
+ * A read-only file which stays open for as long as any reference to it exists, so that
+ * any number of concurrent readers share one file descriptor. Where sendfile() isn't
+ * available, the file is also memory-mapped, so readers share one mapping instead.
+ *
+ * The file must not be truncated while it's open, it should be replaced instead
+ * (written to a new file which is then renamed), in which case existing references keep
+ * seeing the old contents.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+class TMappedFile {
+public:
+    // throws std::runtime_error if the file can't be opened
+    static std::shared_ptr<const TMappedFile> Open(const std::string& Path);
+    ~TMappedFile();
+
+    TMappedFile(const TMappedFile&) = delete;
+    TMappedFile& operator=(const TMappedFile&) = delete;
+
+    [[nodiscard]] const std::string& Path() const { return mPath; }
+    [[nodiscard]] uint64_t Size() const { return mSize; }
+    [[nodiscard]] std::filesystem::file_time_type LastWriteTime() const { return mLastWriteTime; }
+    // nullptr if the file isn't mapped, e.g. because it's empty or mapping isn't supported
+    [[nodiscard]] const uint8_t* Data() const { return mData; }
+    // the file descriptor, or -1 where there is none
+    [[nodiscard]] int NativeHandle() const { return mFd; }
+    // reads up to `Size` bytes at `Offset` through the file descriptor, without touching a
+    // file position. Returns how many bytes were read, 0 if there is no file descriptor.
+    [[nodiscard]] size_t ReadAt(uint64_t Offset, uint8_t* Out, size_t Size) const;
+
+private:
+    TMappedFile() = default;
+
+    std::string mPath;
+    uint64_t mSize { 0 };
+    std::filesystem::file_time_type mLastWriteTime {};
+    const uint8_t* mData { nullptr };
+    int mFd { -1 };
+};
@@ -20,54 +20,171 @@
 
 #include "BoostAliases.h"
 #include "Compat.h"
+#include "TAuthService.h"
+#include "TBandwidthScheduler.h"
+#include "TFrameReader.h"
+#include "THandshakeExecutor.h"
+#include "TPositionDeltaEncoder.h"
+#include "TPositionSnapshots.h"
 #include "TResourceManager.h"
 #include "TServer.h"
+#include "TSharedBuffer.h"
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/udp.hpp>
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <vector>
 
 struct TConnection;
 
+// Counters which are shown by the `status` console command.
+struct TNetworkStats {
+    // framed packets written to TCP sockets
+    std::atomic<uint64_t> TCPFramesSent { 0 };
+    // write operations issued for those frames, each one is a single (vectored) write
+    std::atomic<uint64_t> TCPWrites { 0 };
+    // bytes which didn't have to be copied into a contiguous frame before sending
+    std::atomic<uint64_t> TCPCopyBytesSaved { 0 };
+    // framed packets received from TCP sockets, and the reads they took
+    std::atomic<uint64_t> TCPFramesReceived { 0 };
+    std::atomic<uint64_t> TCPReads { 0 };
+    // UDP packets dropped because of an unknown ID or a mismatched endpoint
+    std::atomic<uint64_t> UDPRejected { 0 };
+    // UDP packets dropped because they were larger than the receive buffer
+    std::atomic<uint64_t> UDPTruncated { 0 };
+    // SendToAll calls, and how often they had to compress the packet (at most once each)
+    std::atomic<uint64_t> Broadcasts { 0 };
+    std::atomic<uint64_t> BroadcastCompressions { 0 };
+    // packet buffers allocated for broadcasts, independent of the number of recipients
+    std::atomic<uint64_t> BroadcastAllocations { 0 };
+    // position updates not sent to a client because of interest management
+    std::atomic<uint64_t> InterestFiltered { 0 };
+    // position ticks, and position updates which were replaced by a newer one before the next tick
+    std::atomic<uint64_t> PositionTicks { 0 };
+    std::atomic<uint64_t> PositionsSuperseded { 0 };
+    // position updates sent delta encoded, and how many bytes that saved
+    std::atomic<uint64_t> PositionDeltasSent { 0 };
+    std::atomic<uint64_t> PositionDeltaBytesSaved { 0 };
+    // position updates which didn't need a datagram of their own, because they were batched
+    std::atomic<uint64_t> PositionDatagramsSaved { 0 };
+    // mod download bytes, and how many of those were sent without copying them through userspace
+    std::atomic<uint64_t> DownloadBytes { 0 };
+    std::atomic<uint64_t> DownloadBytesZeroCopy { 0 };
+    // downloads which only asked for a part of the file, and the bytes that saved
+    std::atomic<uint64_t> DownloadsResumed { 0 };
+    std::atomic<uint64_t> DownloadBytesSkipped { 0 };
+};
+
 class TNetwork {
 public:
     TNetwork(TServer& Server, TPPSMonitor& PPSMonitor, TResourceManager& ResourceManager);
 
     [[nodiscard]] bool TCPSend(TClient& c, const std::vector<uint8_t>& Data, bool IsSync = false);
+    [[nodiscard]] bool TCPSend(TClient& c, const TSharedBuffer& Data, bool IsSync = false);
+    // sends all packets with a single write, bypasses the syncing check like TCPSend with IsSync=true
+    [[nodiscard]] bool TCPSendBatch(TClient& c, const std::vector<TSharedBuffer>& Packets);
     [[nodiscard]] bool SendLarge(TClient& c, std::vector<uint8_t> Data, bool isSync = false);
-    [[nodiscard]] bool Respond(TClient& c, const std::vector<uint8_t>& MSG, bool Rel, bool isSync = false);
+    [[nodiscard]] bool Respond(TClient& c, const TSharedBuffer& MSG, bool Rel, bool isSync = false);
     std::shared_ptr<TClient> CreateClient(ip::tcp::socket&& TCPSock);
     std::vector<uint8_t> TCPRcv(TClient& c);
     void ClientKick(TClient& c, const std::string& R);
     [[nodiscard]] bool SyncClient(const std::weak_ptr<TClient>& c);
     void Identify(TConnection&& client);
-    std::shared_ptr<TClient> Authentication(TConnection&& ClientConnection);
+    // reads the version and key, the handshake continues in FinishAuthentication() once the key is checked
+    void Authentication(TConnection&& ClientConnection);
     void SyncResources(TClient& c);
-    [[nodiscard]] bool UDPSend(TClient& Client, std::vector<uint8_t> Data);
-    void SendToAll(TClient* c, const std::vector<uint8_t>& Data, bool Self, bool Rel);
+    [[nodiscard]] bool UDPSend(TClient& Client, const TSharedBuffer& Data);
+    // sends the same datagram to all clients, with a single sendmmsg() where supported.
+    // Unlike UDPSend, this doesn't compress, so the caller can do that once for all recipients.
+    [[nodiscard]] bool UDPSendToMany(const std::vector<std::shared_ptr<TClient>>& Clients, const TSharedBuffer& Data);
+    // `Data` is shared by all recipients, it's never copied per client. If `Recipients` is
+    // given, only clients whose ID is set in it receive the packet.
+    void SendToAll(TClient* c, const TSharedBuffer& Data, bool Self, bool Rel, const TInterestManager::TRecipientSet* Recipients = nullptr);
     void UpdatePlayer(TClient& Client);
+    // see Network.PositionTickRate
+    [[nodiscard]] bool PositionTicksEnabled() const { return mPositionTickRate > 0; }
+    // keeps the packet until the next position tick, replacing any older one of the same vehicle
+    void QueuePosition(TClient& c, int VID, TSharedBuffer Packet, std::optional<TInterestManager::TVec3> Position);
+    // drops any position state kept for this vehicle, e.g. after it was deleted
+    void ForgetVehicle(int PID, int VID);
+    // handles an `Xk:PID-VID` packet, see TPositionDeltaEncoder
+    void RequestPositionKeyframe(TClient& c, std::string_view Packet);
+    // see Network.PositionDeltas
+    [[nodiscard]] bool PositionDeltasEnabled() const { return mPositionDeltasEnabled; }
+    [[nodiscard]] const TNetworkStats& Stats() const { return mStats; }
+    [[nodiscard]] const THandshakeExecutor& Handshakes() const { return *mHandshakes; }
+    [[nodiscard]] TResourceManager& ResourceManager() { return mResourceManager; }
+    [[nodiscard]] TBandwidthScheduler& DownloadBandwidth() { return mDownloadBandwidth; }
 
 private:
-    void UDPServerMain();
+    void UDPServerMain(size_t Shard);
+    // the socket of the calling UDP thread, or the first one for all other threads
+    ip::udp::socket& UDPSocket();
     void TCPServerMain();
+    // shuts the socket down if the current handshake step takes longer than Network.HandshakeTimeout
+    [[nodiscard]] THandshakeExecutor::TDeadline HandshakeDeadline(ip::tcp::socket& Socket);
+    // runs on a handshake worker after the auth service answered
+    void FinishAuthentication(const std::shared_ptr<TClient>& Client, const TAuthResult& AuthResult);
+    void PositionTickMain();
+    // sends every client the snapshots it should get, batched for those which support it
+    void SendPositionTick(const std::vector<TPositionSnapshots::TSnapshot>& Snapshots);
+    void HandleUDPDatagram(const ip::udp::endpoint& ClientEndpoint, std::vector<uint8_t>&& Data);
+    // sends already compressed (if needed) data
+    bool UDPSendRaw(TClient& Client, const uint8_t* Data, size_t Size);
+    // sends Payloads[i] to Clients[i], or Payloads[0] to everyone if there is only one,
+    // with a single sendmmsg() where supported
+    bool UDPSendEach(const std::vector<std::shared_ptr<TClient>>& Clients, const std::vector<TSharedBuffer>& Payloads);
+    bool TCPWriteFrame(TClient& c, const uint8_t* Data, size_t Size);
+    void StartIoWorkers();
+    // hands a fully connected client over to the IO thread pool, see Network.AsyncIO
+    void StartAsyncClient(const std::shared_ptr<TClient>& c);
+    // handles all packets which are already buffered, then reads more
+    void AsyncRead(const std::shared_ptr<TClient>& c);
+    // kicks the client if the frame is invalid, returns false in that case
+    bool CheckFrame(TClient& c, TFrameReader::TStatus Status);
+    void AsyncWrite(const std::shared_ptr<TClient>& c, const TSharedBuffer& Data);
+    void AsyncWriteNext(const std::shared_ptr<TClient>& c);
+    void AsyncFlushMissedPackets(const std::shared_ptr<TClient>& c);
+    void AsyncFinish(const std::shared_ptr<TClient>& c, std::string_view Reason);
 
     TServer& mServer;
     TPPSMonitor& mPPSMonitor;
-    ip::udp::socket mUDPSock;
+    // one per UDP thread, all bound to the same port with SO_REUSEPORT
+    std::vector<std::unique_ptr<ip::udp::socket>> mUDPSockets;
     TResourceManager& mResourceManager;
-    std::thread mUDPThread;
+    std::vector<std::thread> mUDPThreads;
     std::thread mTCPThread;
-    std::mutex mOpenIDMutex;
+    bool mAsyncIO { false };
+    std::vector<std::thread> mIoThreads;
+    std::optional<executor_work_guard<io_context::executor_type>> mIoWorkGuard;
+    // OnDisconnect runs lua events and broadcasts, so it's kept off the IO threads
+    std::unique_ptr<thread_pool> mDisconnectPool;
+    TNetworkStats mStats;
+    std::atomic<bool> mSendmmsgSupported { true };
+    int mPositionTickRate { 0 };
+    TPositionSnapshots mPositionSnapshots;
+    bool mPositionDeltasEnabled { false };
+    TPositionDeltaEncoder mPositionDeltas;
+    std::unique_ptr<TAuthService> mAuth;
+    std::chrono::seconds mHandshakeTimeout;
+    std::unique_ptr<THandshakeExecutor> mHandshakes;
+    // shared by all mod downloads, see Network.UplinkKBps
+    TBandwidthScheduler mDownloadBandwidth;
+    std::thread mPositionTickThread;
 
-    std::vector<uint8_t> UDPRcvFromClient(ip::udp::endpoint& ClientEndpoint);
+    static std::vector<uint8_t> UDPRcvFromClient(ip::udp::socket& Socket, ip::udp::endpoint& ClientEndpoint);
     void HandleDownload(TConnection&& TCPSock);
     void OnConnect(const std::weak_ptr<TClient>& c);
     void TCPClient(const std::weak_ptr<TClient>& c);
     void Looper(const std::weak_ptr<TClient>& c);
-    int OpenID();
     void OnDisconnect(const std::weak_ptr<TClient>& ClientPtr);
     void Parse(TClient& c, const std::vector<uint8_t>& Packet);
-    void SendFile(TClient& c, const std::string& Name);
+    // sends the file from `Offset` on, until the end or for `Length` bytes
+    void SendFile(TClient& c, const std::string& Name, uint64_t Offset = 0, std::optional<uint64_t> Length = std::nullopt);
     static bool TCPSendRaw(TClient& C, ip::tcp::socket& socket, const uint8_t* Data, size_t Size);
-    static void SplitLoad(TClient& c, size_t Sent, size_t Size, bool D, const std::string& Name);
+    // sends the bytes [Sent, Size) of the file, over the download socket if `D` is set
+    void SplitLoad(TClient& c, size_t Sent, size_t Size, bool D, const TMappedFile& File);
     static const uint8_t* SendSplit(TClient& c, ip::tcp::socket& Socket, const uint8_t* DataPtr, size_t Size);
 };
 
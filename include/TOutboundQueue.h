@@ -0,0 +1,103 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+/*
+ * A bounded multi-producer single-consumer queue of outgoing packets.
+ *
+ * Any thread may Push() at any time, this never blocks and doesn't allocate, as all slots
+ * are allocated up front. Only one thread at a time may call the consumer functions
+ * (Pop, DrainInto, Clear). If the queue is full, Push() fails instead of waiting for
+ * the consumer.
+ *
+ * Every packet can carry a tag, which the queue doesn't interpret.
+ */
+
+#include "TSharedBuffer.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class TOutboundQueue {
+public:
+    // the capacity is rounded up to the next power of two
+    explicit TOutboundQueue(size_t MaxPackets);
+
+    TOutboundQueue(const TOutboundQueue&) = delete;
+    TOutboundQueue& operator=(const TOutboundQueue&) = delete;
+
+    // returns false if the queue is full, in which case the packet is not queued.
+    [[nodiscard]] bool Push(TSharedBuffer Packet, uint64_t Tag = 0);
+    // consumer only. returns false if the queue is (currently) empty.
+    [[nodiscard]] bool Pop(TSharedBuffer& Out, uint64_t* Tag = nullptr);
+    // consumer only. moves up to `Max` packets into `Out`, returns how many were moved.
+    size_t DrainInto(std::vector<TSharedBuffer>& Out, size_t Max);
+    // consumer only.
+    void Clear();
+
+    [[nodiscard]] size_t Size() const { return mSize.load(std::memory_order_relaxed); }
+    [[nodiscard]] size_t Bytes() const { return mBytes.load(std::memory_order_relaxed); }
+    [[nodiscard]] bool Empty() const { return Size() == 0; }
+    [[nodiscard]] size_t MaxPackets() const { return mMask + 1; }
+
+private:
+    struct Slot {
+        // tells producers and the consumer whose turn it is to use this slot
+        std::atomic<size_t> Sequence;
+        TSharedBuffer Packet;
+        uint64_t Tag { 0 };
+    };
+
+    std::unique_ptr<Slot[]> mSlots;
+    const size_t mMask;
+    std::atomic<size_t> mSize { 0 };
+    std::atomic<size_t> mBytes { 0 };
+    std::atomic<size_t> mPushPos { 0 };
+    // only touched by the consumer
+    size_t mPopPos { 0 };
+};
+
+/*
+ * Lets newer packets supersede older ones with the same key while they are still queued,
+ * e.g. vehicle edits. The version of every keyed packet is stored in its tag, and the
+ * latest queued version of every key is remembered here.
+ */
+class TSupersedeFilter {
+public:
+    // queues the packet under `Key`, which must not be 0. Returns false if the queue is full,
+    // in which case nothing changes.
+    [[nodiscard]] bool Push(TOutboundQueue& Queue, TSharedBuffer Packet, uint32_t Key);
+    // consumer only. whether a packet with this tag, which was just popped, is still the
+    // latest one for its key. Untagged packets always are.
+    [[nodiscard]] bool ShouldSend(uint64_t Tag);
+
+    [[nodiscard]] uint64_t Superseded() const { return mSuperseded.load(std::memory_order_relaxed); }
+
+private:
+    std::mutex mMutex;
+    // the latest version of every key which is currently queued
+    std::unordered_map<uint32_t, uint32_t> mVersions;
+    uint32_t mNextVersion { 0 };
+    std::atomic<uint64_t> mSuperseded { 0 };
+};
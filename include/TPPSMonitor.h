@@ -20,6 +20,7 @@
 
 #include "Common.h"
 #include "TServer.h"
+#include <atomic>
 #include <optional>
 
 class TNetwork;
@@ -41,5 +42,5 @@ private:
 
     TServer& mServer;
     std::optional<std::reference_wrapper<TNetwork>> mNetwork { std::nullopt };
-    int mInternalPPS { 0 };
+    std::atomic<int> mInternalPPS { 0 };
 };
@@ -0,0 +1,118 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+/*
+ * Compact, per-recipient encoding of position (Z) packets, for clients which announced
+ * the "zdelta" capability (see Network.PositionDeltas).
+ *
+ * A position packet `Zp:PID-VID:{json}` carries 15 numbers: tim, ping, pos[3], rot[4],
+ * vel[3] and rvel[3]. They are quantized to fixed point (see Scales) and sent as
+ *
+ *     Zd:PID-VID:<flags u8><key id u8><payload>
+ *
+ * A keyframe (flags & 1) carries all 15 values. Every other packet only carries the
+ * values which differ from the recipient's last keyframe of that vehicle: a u16 (little
+ * endian) bit mask, followed by the differences of the set values. All numbers in the
+ * payload are zigzag encoded LEB128 varints.
+ *
+ * Deltas refer to the keyframe, not to the previous packet, so a lost delta doesn't
+ * affect any later ones. A client drops deltas whose key id it doesn't know, e.g. because
+ * the keyframe was lost, and asks for a new keyframe with
+ *
+ *     Xk:PID-VID
+ *
+ * so that it only misses the updates of about one round trip. Without such a request (or
+ * if the request is lost, too), the next keyframe still comes after KeyframeInterval deltas.
+ */
+
+#include "TSharedBuffer.h"
+#include "TVehiclePositionStore.h"
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+class TPositionDeltaEncoder {
+public:
+    static constexpr size_t ValueCount = 15;
+    // tim, ping, pos, rot, vel, rvel
+    static constexpr std::array<double, ValueCount> Scales {
+        1e3, 1e3,
+        1e3, 1e3, 1e3,
+        1e4, 1e4, 1e4, 1e4,
+        1e3, 1e3, 1e3,
+        1e3, 1e3, 1e3
+    };
+    // a new keyframe is sent after this many deltas
+    static constexpr uint32_t KeyframeInterval = 30;
+
+    using TState = std::array<int64_t, ValueCount>;
+    struct TPosition {
+        int PID { -1 };
+        int VID { -1 };
+        TState State {};
+    };
+
+    // parses a `Zp:PID-VID:{json}` packet. Fails if the json has any fields which can't be
+    // encoded, in which case the packet has to be sent as-is.
+    static std::optional<TPosition> Parse(std::string_view Packet);
+
+    // encodes the position for one recipient, and remembers what it sent
+    TSharedBuffer Encode(int RecipientPID, const TPosition& Position);
+    // the next packet of this vehicle to this recipient will be a keyframe
+    void RequestKeyframe(int RecipientPID, int PID, int VID);
+    // parses an `Xk:PID-VID` packet
+    static std::optional<std::pair<int, int>> ParseKeyframeRequest(std::string_view Packet);
+    // forgets all keyframes of this vehicle, e.g. because it was deleted
+    void ForgetVehicle(int PID, int VID);
+    // forgets everything sent to and about this player
+    void ForgetPlayer(int PID);
+
+private:
+    struct TKeyframe {
+        TState State {};
+        uint8_t KeyID { 0 };
+        uint32_t DeltasSinceKey { 0 };
+    };
+
+    std::mutex mMutex;
+    // key is (recipient PID << 48) | (PID << 32) | VID
+    std::unordered_map<uint64_t, TKeyframe> mKeyframes;
+};
+
+// Reference implementation of the receiving side, turns encoded packets back into
+// `Zp:PID-VID:{json}` packets.
+class TPositionDeltaDecoder {
+public:
+    // returns nullopt for malformed packets and for deltas whose keyframe is unknown
+    std::optional<std::string> Decode(std::string_view Packet);
+
+private:
+    struct TKeyframe {
+        TPositionDeltaEncoder::TState State {};
+        uint8_t KeyID { 0 };
+    };
+    std::unordered_map<uint64_t, TKeyframe> mKeyframes;
+};
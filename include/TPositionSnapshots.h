@@ -0,0 +1,82 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+/*
+ * Holds the latest position (Z) packet of every vehicle until the next position tick,
+ * see Network.PositionTickRate. A newer packet for the same vehicle replaces the older
+ * one, so only the freshest state is ever sent.
+ *
+ * Clients which announced the "zbatch" capability receive all positions of a tick in as
+ * few datagrams as possible:
+ *
+ *     Zb:<size u16><packet><size u16><packet>...
+ *
+ * with the sizes in little endian. Every packet is exactly what would otherwise have been
+ * a datagram of its own, e.g. a compressed or delta encoded one. A batch stays below
+ * MaxBatchSize, so it isn't fragmented on typical paths.
+ */
+
+#include "TInterestManager.h"
+#include "TSharedBuffer.h"
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class TPositionSnapshots {
+public:
+    struct TSnapshot {
+        int PID { -1 };
+        int VID { -1 };
+        TSharedBuffer Packet;
+        // for interest management, if it could be parsed
+        std::optional<TInterestManager::TVec3> Position;
+    };
+
+    static constexpr std::string_view BatchPrefix = "Zb:";
+    static constexpr size_t MaxBatchSize = 1200;
+
+    // returns true if an older, not yet sent packet of the same vehicle was replaced
+    bool Store(int PID, int VID, TSharedBuffer Packet, std::optional<TInterestManager::TVec3> Position);
+    // moves all pending snapshots into `Out`, which is cleared first. Passing the same
+    // vector every tick avoids allocations.
+    void TakeAll(std::vector<TSnapshot>& Out);
+    void RemoveVehicle(int PID, int VID);
+    void RemovePlayer(int PID);
+
+    // packs the packets into batches and appends them to `Out`. A packet which doesn't fit
+    // into a batch on its own, or would be alone in one, is appended as it is.
+    static void Batch(std::span<const TSharedBuffer> Packets, std::vector<TSharedBuffer>& Out, size_t MaxSize = MaxBatchSize);
+    // reference implementation of the receiving side. nullopt for malformed batches.
+    static std::optional<std::vector<std::string_view>> Unbatch(std::string_view Datagram);
+
+private:
+    static uint64_t KeyOf(int PID, int VID) { return (uint64_t(uint32_t(PID)) << 32) | uint64_t(uint32_t(VID)); }
+    void RebuildIndex();
+
+    std::mutex mMutex;
+    std::vector<TSnapshot> mPending;
+    // index into mPending, by (PID << 32) | VID
+    std::unordered_map<uint64_t, size_t> mIndex;
+};
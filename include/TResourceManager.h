@@ -19,9 +19,27 @@
 #pragma once
 
 #include "Common.h"
+#include "TMappedFile.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 class TResourceManager {
 public:
+    struct TModInfo {
+        std::string Path;
+        uint64_t Size { 0 };
+        // last write time, in the file clock's ticks
+        int64_t LastWrite { 0 };
+        // lowercase hex SHA-256 of the contents
+        std::string Hash;
+    };
+    // path -> info, as stored in the index file
+    using TModIndex = std::unordered_map<std::string, TModInfo>;
+
     TResourceManager();
 
     [[nodiscard]] size_t MaxModSize() const { return mMaxModSize; }
@@ -29,8 +47,33 @@ public:
     [[nodiscard]] std::string TrimmedList() const { return mTrimmedList; }
     [[nodiscard]] std::string FileSizes() const { return mFileSizes; }
     [[nodiscard]] int ModsLoaded() const { return mModsLoaded; }
+    // the mods' hashes, in the same order as FileList()
+    [[nodiscard]] std::string FileHashes() const { return mFileHashes; }
+    [[nodiscard]] const std::vector<TModInfo>& Mods() const { return mMods; }
+
+    // A shared, open view of the mod, which all concurrent downloads of it use. It's closed
+    // once the last download ends, and re-opened if the file changed since it was opened.
+    // Throws std::runtime_error if the file can't be opened.
+    [[nodiscard]] std::shared_ptr<const TMappedFile> OpenMod(const std::string& Path);
+    // how many mods are currently open, i.e. being downloaded
+    [[nodiscard]] size_t OpenModCount();
+
+    // throws std::runtime_error
+    static std::string HashFile(const std::string& Path);
+    // a missing or broken index is treated as empty
+    static TModIndex ReadIndex(const std::string& IndexPath);
+    // throws std::runtime_error
+    static void WriteIndex(const std::string& IndexPath, const std::vector<TModInfo>& Mods);
 
 private:
+    // fills in the hashes which weren't taken from the index, one task per file
+    static void HashMods(std::vector<TModInfo*>& ToHash);
+
+    std::vector<TModInfo> mMods;
+    std::string mFileHashes;
+    std::mutex mOpenModsMutex;
+    // only a cache, downloads own the files
+    std::unordered_map<std::string, std::weak_ptr<const TMappedFile>> mOpenMods;
     size_t mMaxModSize = 0;
     std::string mFileSizes;
     std::string mFileList;
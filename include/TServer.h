@@ -20,10 +20,14 @@
 
 #include "IThreaded.h"
 #include "RWMutex.h"
+#include "TInterestManager.h"
+#include "TVehiclePositionStore.h"
 #include "TScopedTimer.h"
+#include <array>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "BoostAliases.h"
@@ -32,9 +36,17 @@ class TClient;
 class TNetwork;
 class TPPSMonitor;
 
+struct TUDPEndpointHash {
+    size_t operator()(const ip::udp::endpoint& Endpoint) const;
+};
+
 class TServer final {
 public:
     using TClientSet = std::unordered_set<std::shared_ptr<TClient>>;
+    // player IDs are sent as ID+1 in a single byte in UDP packets, so there can't be more than this
+    static constexpr size_t MaxClientSlots = 255;
+    static_assert(MaxClientSlots == TInterestManager::MaxPlayers);
+    static_assert(MaxClientSlots == TVehiclePositionStore::MaxPlayers);
 
     TServer(const std::vector<std::string_view>& Arguments);
 
@@ -42,6 +54,14 @@ public:
     void RemoveClient(const std::weak_ptr<TClient>&);
     void ForEachClient(const std::function<bool(std::weak_ptr<TClient>)>& Fn);
     size_t ClientCount() const;
+    // assigns the lowest free player ID to the client, or returns -1 if there is none
+    int AssignClientID(const std::shared_ptr<TClient>& Client);
+    // O(1), returns nullptr if there is no such client
+    std::shared_ptr<TClient> GetClientByID(int ID) const;
+    // O(1), returns nullptr if no client has sent UDP from this endpoint yet
+    std::shared_ptr<TClient> GetClientByUDPEndpoint(const ip::udp::endpoint& Endpoint) const;
+    // remembers the endpoint as the client's UDP endpoint, replacing any previous one
+    void BindUDPEndpoint(const std::shared_ptr<TClient>& Client, const ip::udp::endpoint& Endpoint);
 
     void GlobalParser(const std::weak_ptr<TClient>& Client, std::vector<uint8_t>&& Packet, TPPSMonitor& PPSMonitor, TNetwork& Network);
     static void HandleEvent(TClient& c, const std::string& Data);
@@ -51,16 +71,25 @@ public:
 
     // asio io context
     io_context& IoCtx() { return mIoCtx; }
+    TInterestManager& InterestManager() { return mInterestManager; }
+    TVehiclePositionStore& VehiclePositions() { return mVehiclePositions; }
 
 private:
     io_context mIoCtx {};
     TClientSet mClients;
     mutable RWMutex mClientsMutex;
+    // lookup tables for the UDP hot path, indexed by ID and by UDP endpoint
+    std::array<std::weak_ptr<TClient>, MaxClientSlots> mClientSlots;
+    std::unordered_map<ip::udp::endpoint, std::weak_ptr<TClient>, TUDPEndpointHash> mUDPEndpoints;
+    mutable RWMutex mClientSlotsMutex;
+    TInterestManager mInterestManager;
+    TVehiclePositionStore mVehiclePositions;
     static void ParseVehicle(TClient& c, const std::string& Pckt, TNetwork& Network);
     static bool ShouldSpawn(TClient& c, const std::string& CarJson, int ID);
     static bool IsUnicycle(TClient& c, const std::string& CarJson);
     static void Apply(TClient& c, int VID, const std::string& pckt);
-    void HandlePosition(TClient& c, const std::string& Packet);
+    void HandleCapabilities(TClient& c, const std::string& Packet, TNetwork& Network);
+    void HandlePosition(TClient& c, std::vector<uint8_t>&& Packet, const std::string& StringPacket, TNetwork& Network);
 };
 
 struct BufferView {
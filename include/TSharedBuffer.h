@@ -0,0 +1,68 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+/*
+ * An immutable, reference counted packet buffer.
+ *
+ * Copying a TSharedBuffer only copies a pointer, so the same packet can be queued for
+ * any number of clients while the data exists only once. The data is freed when the
+ * last copy is destroyed.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class TSharedBuffer {
+public:
+    TSharedBuffer() = default;
+    // takes over the vector's memory, doesn't copy the data
+    TSharedBuffer(std::vector<uint8_t>&& Data);
+    // copies the data into a new buffer
+    TSharedBuffer(const std::vector<uint8_t>& Data);
+    TSharedBuffer(const uint8_t* Data, size_t Size);
+
+    static TSharedBuffer FromString(std::string_view Str);
+
+    [[nodiscard]] const uint8_t* data() const { return mData.get(); }
+    [[nodiscard]] size_t size() const { return mSize; }
+    [[nodiscard]] bool empty() const { return mSize == 0; }
+    [[nodiscard]] const uint8_t* begin() const { return data(); }
+    [[nodiscard]] const uint8_t* end() const { return data() + mSize; }
+    [[nodiscard]] uint8_t operator[](size_t i) const { return mData.get()[i]; }
+    // throws std::out_of_range
+    [[nodiscard]] uint8_t at(size_t i) const;
+
+    // a view into a part of this buffer, which shares ownership of the data
+    [[nodiscard]] TSharedBuffer Sub(size_t Offset, size_t Size) const;
+    [[nodiscard]] std::vector<uint8_t> ToVector() const { return { begin(), end() }; }
+    [[nodiscard]] std::string_view AsStringView() const { return { reinterpret_cast<const char*>(data()), mSize }; }
+    [[nodiscard]] long UseCount() const { return mData.use_count(); }
+
+    // how many buffers were allocated by the calling thread, used for statistics
+    [[nodiscard]] static uint64_t ThreadAllocationCount();
+
+private:
+    std::shared_ptr<const uint8_t> mData;
+    size_t mSize { 0 };
+};
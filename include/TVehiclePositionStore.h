@@ -0,0 +1,92 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+/*
+ * The last known position of every vehicle, decoded once when the position (Z) packet
+ * arrives, so that readers (Lua, interest management, ...) don't have to parse json.
+ *
+ * Records are kept per player in a vector indexed by vehicle ID, each player has its
+ * own lock, so updates of different players never contend. The json text is only kept
+ * for packets which can't be fully represented by a TVehiclePosition.
+ */
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct TVehiclePosition {
+    double Time { 0 };
+    double Ping { 0 };
+    std::array<double, 3> Pos {};
+    std::array<double, 4> Rot {};
+    std::array<double, 3> Vel {};
+    std::array<double, 3> RVel {};
+
+    // parses the json of a position packet, {"tim":..,"ping":..,"pos":[..],"rot":[..],"vel":[..],"rvel":[..]}.
+    // Fails if any of these is missing, or if there are any other fields.
+    static std::optional<TVehiclePosition> Parse(std::string_view Json);
+    // the json representation, which parses back to exactly the same values
+    [[nodiscard]] std::string ToJson() const;
+};
+
+class TVehiclePositionStore {
+public:
+    // must match TServer::MaxClientSlots
+    static constexpr size_t MaxPlayers = 255;
+    // vehicle IDs are handed out from 0 upwards, higher ones are ignored
+    static constexpr size_t MaxVehiclesPerPlayer = 256;
+
+    // decodes and stores the json of a position packet. Returns the decoded position, if
+    // decoding worked.
+    std::optional<TVehiclePosition> Set(int PID, int VID, std::string_view Json);
+    // nullopt if the vehicle is unknown, or its last position couldn't be decoded
+    [[nodiscard]] std::optional<TVehiclePosition> Get(int PID, int VID) const;
+    // the last position as json, either rebuilt from the decoded position or as received.
+    // Empty if the vehicle is unknown.
+    [[nodiscard]] std::string GetJson(int PID, int VID) const;
+    void RemoveVehicle(int PID, int VID);
+    void RemovePlayer(int PID);
+
+private:
+    struct TEntry {
+        enum class TState : uint8_t {
+            Empty,
+            Decoded,
+            // couldn't be decoded, only `Raw` is valid
+            RawOnly,
+        } State { TState::Empty };
+        TVehiclePosition Position;
+        std::string Raw;
+    };
+    struct TPlayer {
+        mutable std::mutex Mutex;
+        std::vector<TEntry> Vehicles;
+    };
+
+    // nullptr if the IDs are out of range
+    TPlayer* PlayerOf(int PID, int VID);
+    const TPlayer* PlayerOf(int PID, int VID) const;
+
+    std::array<TPlayer, MaxPlayers> mPlayers;
+};
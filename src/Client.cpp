@@ -66,18 +66,30 @@ TClient::TVehicleDataLockPair TClient::GetAllCars() {
     return { &mVehicleData, std::unique_lock(mVehicleDataMutex) };
 }
 
-std::string TClient::GetCarPositionRaw(int Ident) {
-    std::unique_lock lock(mVehiclePositionMutex);
-    try {
-        return mVehiclePosition.at(size_t(Ident));
-    } catch (const std::out_of_range& oor) {
-        beammp_debugf("Failed to get vehicle position for {}: {}", Ident, oor.what());
-        return "";
+void TClient::Disconnect(std::string_view Reason) {
+    beammp_debugf("Disconnecting client {} for reason: {}", GetID(), Reason);
+    if (mIsAsync) {
+        // the socket may only be touched from the strand. If a write is still in
+        // progress (for example a kick message), we let it finish first, unless
+        // we were already asked to disconnect before.
+        bool AlreadyDisconnecting = mIsDisconnecting.exchange(true);
+        post(mAsyncState.Strand, [Self = shared_from_this(), AlreadyDisconnecting] {
+            auto& State = Self->AsyncState();
+            if (State.Writing && !AlreadyDisconnecting) {
+                State.CloseAfterWrite = true;
+            } else {
+                Self->CloseSockets();
+            }
+        });
+        return;
     }
+    CloseSockets();
+    // wakes up the Looper so it notices the disconnect
+    NotifyOutbound();
 }
 
-void TClient::Disconnect(std::string_view Reason) {
-    beammp_debugf("Disconnecting client {} for reason: {}", GetID(), Reason);
+void TClient::CloseSockets() {
+    mIsDisconnecting = true;
     boost::system::error_code ec;
     mSocket.shutdown(socket_base::shutdown_both, ec);
     if (ec) {
@@ -89,11 +101,6 @@ void TClient::Disconnect(std::string_view Reason) {
     }
 }
 
-void TClient::SetCarPosition(int Ident, const std::string& Data) {
-    std::unique_lock lock(mVehiclePositionMutex);
-    mVehiclePosition[size_t(Ident)] = Data;
-}
-
 std::string TClient::GetCarData(int Ident) {
     { // lock
         std::unique_lock lock(mVehicleDataMutex);
@@ -136,16 +143,77 @@ TServer& TClient::Server() const {
     return mServer;
 }
 
-void TClient::EnqueuePacket(const std::vector<uint8_t>& Packet) {
-    std::unique_lock Lock(mMissedPacketsMutex);
-    mPacketsSync.push(Packet);
+void TClient::EnqueuePacket(TSharedBuffer Packet, uint32_t SupersedeKey) {
+    if (mPacketsSync.Size() >= mMaxQueuedPackets || mPacketsSync.Bytes() + Packet.size() > mMaxQueuedBytes) {
+        if (!IsDisconnected()) {
+            beammp_warnf("Client {} ('{}') is too slow: {} packets ({} bytes) waiting to be sent, disconnecting",
+                mID, mName, mPacketsSync.Size(), mPacketsSync.Bytes());
+            Disconnect("Outbound packet queue full (connection too slow)");
+        }
+        return;
+    }
+    const bool Queued = SupersedeKey != 0
+        ? mSupersede.Push(mPacketsSync, std::move(Packet), SupersedeKey)
+        : mPacketsSync.Push(std::move(Packet));
+    if (!Queued) {
+        if (!IsDisconnected()) {
+            beammp_warnf("Outbound packet queue of client {} is full ({} packets), disconnecting", mID, mPacketsSync.MaxPackets());
+            Disconnect("Outbound packet queue full (connection too slow)");
+        }
+        return;
+    }
+    NotifyOutbound();
+}
+
+size_t TClient::DrainMissedPackets(std::vector<TSharedBuffer>& Out, size_t Max) {
+    size_t Count = 0;
+    TSharedBuffer Packet;
+    uint64_t Tag = 0;
+    while (Count < Max && mPacketsSync.Pop(Packet, &Tag)) {
+        if (!mSupersede.ShouldSend(Tag)) {
+            continue;
+        }
+        Out.push_back(std::move(Packet));
+        ++Count;
+    }
+    return Count;
+}
+
+void TClient::MakeAsync(std::function<void()> OnOutbound) {
+    mOnOutbound = std::move(OnOutbound);
+    // publishes mOnOutbound to other threads
+    mIsAsync = true;
+}
+
+void TClient::NotifyOutbound() {
+    if (mIsAsync) {
+        mOnOutbound();
+    } else {
+        mOutboundSignal.fetch_add(1);
+        mOutboundSignal.notify_all();
+    }
+}
+
+static ip::address RemoteAddressOf(const ip::tcp::socket& Socket) {
+    boost::system::error_code ec;
+    auto Endpoint = Socket.remote_endpoint(ec);
+    return ec ? ip::address() : Endpoint.address();
 }
 
 TClient::TClient(TServer& Server, ip::tcp::socket&& Socket)
     : mServer(Server)
+    // the queue's slots are allocated up front, so the limit shouldn't be too large
+    , mMaxQueuedPackets(size_t(std::max(1, Application::Settings.getAsInt(Settings::Key::Network_MaxQueuedPackets))))
+    , mMaxQueuedBytes(size_t(std::max(1, Application::Settings.getAsInt(Settings::Key::Network_MaxQueuedMB))) * 1024 * 1024)
+    , mPacketsSync(mMaxQueuedPackets)
+    // a single packet may always be as large as before there was a budget
+    , mDecompressionBudget(uint64_t(std::max(0, Application::Settings.getAsInt(Settings::Key::Network_DecompressionBudgetKBps))) * 1024, Compression::MaxDecompressedSize)
+    , mFrameReader(Compression::BufferPool(), size_t(std::max(1, Application::Settings.getAsInt(Settings::Key::Network_ReceiveQuotaMB))) * 1024 * 1024)
     , mSocket(std::move(Socket))
+    , mTCPAddress(RemoteAddressOf(mSocket))
     , mDownSocket(ip::tcp::socket(Server.IoCtx()))
-    , mLastPingTime(std::chrono::high_resolution_clock::now()) {
+    , mLastPingTime(std::chrono::high_resolution_clock::now())
+    , mAsyncState(Server.IoCtx()) {
 }
 
 TClient::~TClient() {
@@ -163,19 +231,8 @@ int TClient::SecondsSinceLastPing() {
 }
 
 std::optional<std::weak_ptr<TClient>> GetClient(TServer& Server, int ID) {
-    std::optional<std::weak_ptr<TClient>> MaybeClient { std::nullopt };
-    Server.ForEachClient([&](std::weak_ptr<TClient> CPtr) -> bool {
-        ReadLock Lock(Server.GetClientMutex());
-        if (!CPtr.expired()) {
-            auto C = CPtr.lock();
-            if (C->GetID() == ID) {
-                MaybeClient = CPtr;
-                return false;
-            }
-        } else {
-            beammp_debugf("Found an expired client while looking for id {}", ID);
-        }
-        return true;
-    });
-    return MaybeClient;
+    if (auto Client = Server.GetClientByID(ID)) {
+        return Client;
+    }
+    return std::nullopt;
 }
@@ -17,6 +17,7 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "Common.h"
+#include "Compression.h"
 
 #include "Env.h"
 #include "TConsole.h"
@@ -384,63 +385,14 @@ void SplitString(const std::string& str, const char delim, std::vector<std::stri
         out.push_back(str.substr(start, end - start));
     }
 }
-static constexpr size_t STARTING_MAX_DECOMPRESSION_BUFFER_SIZE = 15 * 1024 * 1024;
-static constexpr size_t MAX_DECOMPRESSION_BUFFER_SIZE = 30 * 1024 * 1024;
-
 std::vector<uint8_t> DeComp(std::span<const uint8_t> input) {
-    beammp_debugf("got {} bytes of input data", input.size());
-
-    // start with a decompression buffer of 5x the input size, clamped to a maximum of 15 MB.
-    // this buffer can and will grow, but we don't want to start it too large. A 5x compression ratio
-    // is pretty optimistic.
-    std::vector<uint8_t> output_buffer(std::min<size_t>(input.size() * 5, STARTING_MAX_DECOMPRESSION_BUFFER_SIZE));
-
-    uLongf output_size = output_buffer.size();
-
-    while (true) {
-        int res = uncompress(
-            reinterpret_cast<Bytef*>(output_buffer.data()),
-            &output_size,
-            reinterpret_cast<const Bytef*>(input.data()),
-            static_cast<uLongf>(input.size()));
-        if (res == Z_BUF_ERROR) {
-            // We assume that a reasonable maximum size for decompressed packets exists. We want to avoid
-            // a client effectively "zip bombing" us by sending a lot of small packets which decompress
-            // into huge data.
-            // If this limit were to be an issue, this could be made configurable, however clients have a similar
-            // limit. For that reason, we just reject packets which decompress into too much data.
-            if (output_buffer.size() >= MAX_DECOMPRESSION_BUFFER_SIZE) {
-                throw std::runtime_error(fmt::format("decompressed packet size of {} bytes exceeded", MAX_DECOMPRESSION_BUFFER_SIZE));
-            }
-            // if decompression fails, we double the buffer size (up to the allowed limit) and try again
-            output_buffer.resize(std::max<size_t>(output_buffer.size() * 2, MAX_DECOMPRESSION_BUFFER_SIZE));
-            beammp_warnf("zlib uncompress() failed, trying with a larger buffer size of {}", output_buffer.size());
-            output_size = output_buffer.size();
-        } else if (res != Z_OK) {
-            beammp_error("zlib uncompress() failed: " + std::to_string(res));
-            throw std::runtime_error("zlib uncompress() failed");
-        } else if (res == Z_OK) {
-            break;
-        }
-    }
-    output_buffer.resize(output_size);
-    return output_buffer;
+    std::vector<uint8_t> output;
+    Compression::Zlib().Decompress(input, output, Compression::MaxDecompressedSize);
+    return output;
 }
 
 std::vector<uint8_t> Comp(std::span<const uint8_t> input) {
-    auto max_size = compressBound(input.size());
-    std::vector<uint8_t> output(max_size);
-    uLongf output_size = output.size();
-    int res = compress(
-        reinterpret_cast<Bytef*>(output.data()),
-        &output_size,
-        reinterpret_cast<const Bytef*>(input.data()),
-        static_cast<uLongf>(input.size()));
-    if (res != Z_OK) {
-        beammp_error("zlib compress() failed: " + std::to_string(res));
-        throw std::runtime_error("zlib compress() failed");
-    }
-    beammp_debug("zlib compressed " + std::to_string(input.size()) + " B to " + std::to_string(output_size) + " B");
-    output.resize(output_size);
+    std::vector<uint8_t> output;
+    Compression::Zlib().Compress(input, output);
     return output;
 }
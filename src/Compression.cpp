@@ -0,0 +1,509 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "Compression.h"
+
+#include <algorithm>
+#include <bit>
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <zlib.h>
+
+#ifdef BEAMMP_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// how much output space a decompression starts with, relative to the input size. The
+// buffer grows as needed, but decompression never starts over.
+static constexpr size_t InitialRatio = 4;
+static constexpr size_t MinInitialSize = 1024;
+
+static size_t InitialOutputSize(size_t InputSize, size_t MaxSize) {
+    return std::min(MaxSize, std::max(MinInitialSize, InputSize * InitialRatio));
+}
+
+// moves the output into a larger buffer from the pool, if needed
+static void Reserve(std::vector<uint8_t>& Out, size_t Capacity) {
+    if (Out.capacity() >= Capacity) {
+        return;
+    }
+    auto Larger = Compression::BufferPool().Acquire(Capacity);
+    Larger.insert(Larger.end(), Out.begin(), Out.end());
+    Compression::BufferPool().Release(std::move(Out));
+    Out = std::move(Larger);
+}
+
+static std::runtime_error SizeExceeded(size_t MaxSize) {
+    return std::runtime_error("decompressed packet size of " + std::to_string(MaxSize) + " bytes exceeded");
+}
+
+class TZlibCodec final : public ICodec {
+public:
+    TZlibCodec()
+        : mName("zlib")
+        , mPrefix("ABG:") { }
+    // with a preset dictionary, which zlib identifies by its adler32 checksum
+    explicit TZlibCodec(std::vector<uint8_t> Dictionary)
+        : mName(fmt::format("zdict-{:08x}", Compression::DictionaryID(Dictionary)))
+        , mPrefix("ABD:")
+        , mDictionary(std::move(Dictionary))
+        , mDictionaryID(Compression::DictionaryID(mDictionary)) { }
+
+    std::string_view Name() const override { return mName; }
+    std::string_view Prefix() const override { return mPrefix; }
+
+    void Compress(std::span<const uint8_t> Input, std::vector<uint8_t>& Out) const override {
+        auto& Stream = tDeflate.Stream;
+        deflateReset(&Stream);
+        // the dictionary doesn't survive a reset
+        if (!mDictionary.empty() && deflateSetDictionary(&Stream, mDictionary.data(), uInt(mDictionary.size())) != Z_OK) {
+            throw std::runtime_error("zlib deflateSetDictionary() failed");
+        }
+        const size_t Start = Out.size();
+        Out.resize(Start + deflateBound(&Stream, uLong(Input.size())));
+        Stream.next_in = const_cast<Bytef*>(Input.data());
+        Stream.avail_in = uInt(Input.size());
+        Stream.next_out = Out.data() + Start;
+        Stream.avail_out = uInt(Out.size() - Start);
+        const int Res = deflate(&Stream, Z_FINISH);
+        if (Res != Z_STREAM_END) {
+            Out.resize(Start);
+            throw std::runtime_error("zlib deflate() failed: " + std::to_string(Res));
+        }
+        Out.resize(Start + Stream.total_out);
+    }
+
+    void Decompress(std::span<const uint8_t> Input, std::vector<uint8_t>& Out, size_t MaxSize) const override {
+        auto& Stream = tInflate.Stream;
+        inflateReset(&Stream);
+        Stream.next_in = const_cast<Bytef*>(Input.data());
+        Stream.avail_in = uInt(Input.size());
+        const size_t Start = Out.size();
+        const size_t Limit = Start + MaxSize;
+        Reserve(Out, Start + InitialOutputSize(Input.size(), MaxSize));
+        while (true) {
+            // all of the buffer, but never more than allowed
+            const size_t Capacity = std::min(Out.capacity(), Limit);
+            Out.resize(Capacity);
+            Stream.next_out = Out.data() + Start + Stream.total_out;
+            Stream.avail_out = uInt(Capacity - Start - Stream.total_out);
+            const int Res = inflate(&Stream, Z_NO_FLUSH);
+            if (Res == Z_STREAM_END) {
+                break;
+            }
+            if (Res == Z_NEED_DICT) {
+                if (mDictionary.empty() || Stream.adler != mDictionaryID) {
+                    Out.resize(Start);
+                    throw std::runtime_error(fmt::format("zlib inflate() failed: unknown dictionary {:08x}", Stream.adler));
+                }
+                inflateSetDictionary(&Stream, mDictionary.data(), uInt(mDictionary.size()));
+                continue;
+            }
+            if (Res != Z_OK && Res != Z_BUF_ERROR) {
+                Out.resize(Start);
+                throw std::runtime_error("zlib inflate() failed: " + std::string(Stream.msg ? Stream.msg : std::to_string(Res)));
+            }
+            if (Stream.avail_out != 0) {
+                // all input was consumed, but the stream didn't end
+                Out.resize(Start);
+                throw std::runtime_error("zlib inflate() failed: truncated input");
+            }
+            if (Capacity >= Limit) {
+                Out.resize(Start);
+                throw SizeExceeded(MaxSize);
+            }
+            // only what was decompressed so far is moved, nothing is decompressed twice
+            Out.resize(Start + Stream.total_out);
+            Reserve(Out, Capacity * 2);
+        }
+        Out.resize(Start + Stream.total_out);
+    }
+
+private:
+    struct TDeflateContext {
+        z_stream Stream {};
+        TDeflateContext() {
+            if (deflateInit(&Stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+                throw std::runtime_error("zlib deflateInit() failed");
+            }
+        }
+        ~TDeflateContext() { deflateEnd(&Stream); }
+    };
+    struct TInflateContext {
+        z_stream Stream {};
+        TInflateContext() {
+            if (inflateInit(&Stream) != Z_OK) {
+                throw std::runtime_error("zlib inflateInit() failed");
+            }
+        }
+        ~TInflateContext() { inflateEnd(&Stream); }
+    };
+    // shared by all instances, they're reset for every packet anyways
+    static thread_local TDeflateContext tDeflate;
+    static thread_local TInflateContext tInflate;
+
+    const std::string mName;
+    const std::string mPrefix;
+    const std::vector<uint8_t> mDictionary;
+    const uint32_t mDictionaryID { 0 };
+};
+
+thread_local TZlibCodec::TDeflateContext TZlibCodec::tDeflate;
+thread_local TZlibCodec::TInflateContext TZlibCodec::tInflate;
+
+#ifdef BEAMMP_HAVE_ZSTD
+class TZstdCodec final : public ICodec {
+public:
+    // the fastest level, packets are small and latency matters more than the last few percent
+    static constexpr int Level = 1;
+
+    std::string_view Name() const override { return "zstd"; }
+    std::string_view Prefix() const override { return "ZST:"; }
+
+    void Compress(std::span<const uint8_t> Input, std::vector<uint8_t>& Out) const override {
+        auto* Context = tCompress.Context;
+        ZSTD_CCtx_reset(Context, ZSTD_reset_session_only);
+        const size_t Start = Out.size();
+        Out.resize(Start + ZSTD_compressBound(Input.size()));
+        const size_t Res = ZSTD_compress2(Context, Out.data() + Start, Out.size() - Start, Input.data(), Input.size());
+        if (ZSTD_isError(Res)) {
+            Out.resize(Start);
+            throw std::runtime_error("zstd compression failed: " + std::string(ZSTD_getErrorName(Res)));
+        }
+        Out.resize(Start + Res);
+    }
+
+    void Decompress(std::span<const uint8_t> Input, std::vector<uint8_t>& Out, size_t MaxSize) const override {
+        auto* Context = tDecompress.Context;
+        ZSTD_DCtx_reset(Context, ZSTD_reset_session_only);
+        ZSTD_inBuffer In { Input.data(), Input.size(), 0 };
+        const size_t Start = Out.size();
+        const size_t Limit = Start + MaxSize;
+        Reserve(Out, Start + InitialOutputSize(Input.size(), MaxSize));
+        size_t Written = 0;
+        while (true) {
+            const size_t Capacity = std::min(Out.capacity(), Limit);
+            Out.resize(Capacity);
+            ZSTD_outBuffer Output { Out.data() + Start, Capacity - Start, Written };
+            const size_t Res = ZSTD_decompressStream(Context, &Output, &In);
+            Written = Output.pos;
+            if (ZSTD_isError(Res)) {
+                Out.resize(Start);
+                throw std::runtime_error("zstd decompression failed: " + std::string(ZSTD_getErrorName(Res)));
+            }
+            if (Res == 0) {
+                break;
+            }
+            if (Output.pos < Output.size) {
+                // all input was consumed, but the frame didn't end
+                Out.resize(Start);
+                throw std::runtime_error("zstd decompression failed: truncated input");
+            }
+            if (Capacity >= Limit) {
+                Out.resize(Start);
+                throw SizeExceeded(MaxSize);
+            }
+            Out.resize(Start + Written);
+            Reserve(Out, Capacity * 2);
+        }
+        Out.resize(Start + Written);
+    }
+
+private:
+    struct TCompressContext {
+        ZSTD_CCtx* Context { ZSTD_createCCtx() };
+        TCompressContext() {
+            if (!Context) {
+                throw std::runtime_error("ZSTD_createCCtx() failed");
+            }
+            ZSTD_CCtx_setParameter(Context, ZSTD_c_compressionLevel, Level);
+        }
+        ~TCompressContext() { ZSTD_freeCCtx(Context); }
+    };
+    // a frame can ask for a window of up to 2 GB, which the context would allocate and keep.
+    // No packet may be larger than MaxDecompressedSize, so neither needs the window to be.
+    static constexpr int WindowLogMax = int(std::bit_width(Compression::MaxDecompressedSize - 1));
+
+    struct TDecompressContext {
+        ZSTD_DCtx* Context { ZSTD_createDCtx() };
+        TDecompressContext() {
+            if (!Context) {
+                throw std::runtime_error("ZSTD_createDCtx() failed");
+            }
+            ZSTD_DCtx_setParameter(Context, ZSTD_d_windowLogMax, WindowLogMax);
+        }
+        ~TDecompressContext() { ZSTD_freeDCtx(Context); }
+    };
+    static thread_local TCompressContext tCompress;
+    static thread_local TDecompressContext tDecompress;
+};
+
+thread_local TZstdCodec::TCompressContext TZstdCodec::tCompress;
+thread_local TZstdCodec::TDecompressContext TZstdCodec::tDecompress;
+#endif
+
+TDecompressionBudget::TDecompressionBudget(uint64_t BytesPerSecond, uint64_t Burst)
+    : mBytesPerSecond(BytesPerSecond)
+    , mBurst(Burst)
+    , mTokens(double(Burst))
+    , mLastRefill(TClock::now()) {
+}
+
+size_t TDecompressionBudget::Available(TClock::time_point Now) {
+    if (!IsLimited()) {
+        return Compression::MaxDecompressedSize;
+    }
+    std::unique_lock Lock(mMutex);
+    if (Now > mLastRefill) {
+        const double Elapsed = std::chrono::duration<double>(Now - mLastRefill).count();
+        mTokens = std::min(double(mBurst), mTokens + Elapsed * double(mBytesPerSecond));
+        mLastRefill = Now;
+    }
+    return std::min(Compression::MaxDecompressedSize, size_t(std::max(0.0, mTokens)));
+}
+
+void TDecompressionBudget::Consume(size_t Bytes) {
+    if (!IsLimited()) {
+        return;
+    }
+    std::unique_lock Lock(mMutex);
+    mTokens -= double(Bytes);
+}
+
+namespace Compression {
+
+static const TZlibCodec sZlib;
+#ifdef BEAMMP_HAVE_ZSTD
+static const TZstdCodec sZstd;
+#endif
+
+static std::vector<const ICodec*> sCodecs {
+    &sZlib,
+#ifdef BEAMMP_HAVE_ZSTD
+    &sZstd,
+#endif
+};
+static std::unique_ptr<ICodec> sDictionaryCodec;
+
+const ICodec& Zlib() {
+    return sZlib;
+}
+
+std::span<const ICodec* const> Codecs() {
+    return sCodecs;
+}
+
+uint32_t DictionaryID(std::span<const uint8_t> Dictionary) {
+    return uint32_t(adler32(adler32(0, nullptr, 0), Dictionary.data(), uInt(Dictionary.size())));
+}
+
+std::unique_ptr<ICodec> MakeDictionaryCodec(std::vector<uint8_t> Dictionary) {
+    if (Dictionary.empty() || Dictionary.size() > MaxDictionarySize) {
+        throw std::runtime_error(fmt::format("a dictionary must be between 1 and {} bytes large, this one is {} bytes", MaxDictionarySize, Dictionary.size()));
+    }
+    return std::make_unique<TZlibCodec>(std::move(Dictionary));
+}
+
+const ICodec& LoadDictionary(std::vector<uint8_t> Dictionary) {
+    if (sDictionaryCodec) {
+        throw std::runtime_error("a dictionary is already loaded");
+    }
+    sDictionaryCodec = MakeDictionaryCodec(std::move(Dictionary));
+    sCodecs.push_back(sDictionaryCodec.get());
+    return *sDictionaryCodec;
+}
+
+const ICodec* Find(std::string_view Name) {
+    auto Iter = std::find_if(sCodecs.begin(), sCodecs.end(), [&](const ICodec* Codec) { return Codec->Name() == Name; });
+    return Iter == sCodecs.end() ? nullptr : *Iter;
+}
+
+const ICodec* CodecOf(std::span<const uint8_t> Packet) {
+    const std::string_view Str(reinterpret_cast<const char*>(Packet.data()), Packet.size());
+    auto Iter = std::find_if(sCodecs.begin(), sCodecs.end(), [&](const ICodec* Codec) { return Str.starts_with(Codec->Prefix()); });
+    return Iter == sCodecs.end() ? nullptr : *Iter;
+}
+
+std::vector<uint8_t> CompressPacket(const ICodec& Codec, std::span<const uint8_t> Data) {
+    const auto Prefix = Codec.Prefix();
+    std::vector<uint8_t> Result(Prefix.begin(), Prefix.end());
+    Codec.Compress(Data, Result);
+    return Result;
+}
+
+std::vector<uint8_t> DecompressPacket(std::vector<uint8_t>&& Packet, TDecompressionBudget* Budget, const ICodec* Negotiated) {
+    const auto* Codec = CodecOf(Packet);
+    if (!Codec) {
+        return std::move(Packet);
+    }
+    if (Negotiated && Codec != &sZlib && Codec != Negotiated) {
+        throw std::runtime_error(fmt::format("packet is compressed with {}, which wasn't negotiated", Codec->Name()));
+    }
+    const size_t MaxSize = Budget ? Budget->Available() : MaxDecompressedSize;
+    std::vector<uint8_t> Result;
+    try {
+        Codec->Decompress(std::span(Packet).subspan(Codec->Prefix().size()), Result, MaxSize);
+    } catch (const std::exception&) {
+        // the work was done all the same, otherwise packets which are too large or broken would
+        // be free to send. How much was produced isn't known anymore, so it's all that was allowed.
+        if (Budget) {
+            Budget->Consume(MaxSize);
+        }
+        BufferPool().Release(std::move(Packet));
+        BufferPool().Release(std::move(Result));
+        throw;
+    }
+    if (Budget) {
+        Budget->Consume(Result.size());
+    }
+    BufferPool().Release(std::move(Packet));
+    return Result;
+}
+
+TBufferPool& BufferPool() {
+    // large enough for any packet, and for a few dozen typical ones
+    static TBufferPool Pool(MaxDecompressedSize, 64 * 1024 * 1024);
+    return Pool;
+}
+
+}
+
+TEST_CASE("Compression codecs") {
+    std::vector<uint8_t> Data;
+    for (size_t i = 0; i < 20000; ++i) {
+        Data.push_back(uint8_t("{\"jbm\":\"pickup\",\"parts\":{}}"[i % 27]));
+    }
+    for (const auto* Codec : Compression::Codecs()) {
+        REQUIRE(Codec->Prefix().size() == 4);
+        CHECK(Compression::Find(Codec->Name()) == Codec);
+
+        auto Packet = Compression::CompressPacket(*Codec, Data);
+        CHECK(Packet.size() < Data.size());
+        CHECK(Compression::CodecOf(Packet) == Codec);
+        CHECK(Compression::DecompressPacket(std::vector<uint8_t>(Packet)) == Data);
+
+        // reusing the thread's context must not leak state between packets
+        std::vector<uint8_t> Small { 'p' };
+        std::vector<uint8_t> Out;
+        Codec->Compress(Small, Out);
+        std::vector<uint8_t> Back;
+        Codec->Decompress(Out, Back, 1);
+        CHECK(Back == Small);
+
+        const auto Compressed = std::span(Packet).subspan(4);
+        std::vector<uint8_t> Limited;
+        CHECK_THROWS(Codec->Decompress(Compressed, Limited, Data.size() - 1));
+        CHECK(Limited.empty());
+        CHECK_THROWS(Codec->Decompress(Compressed.first(Compressed.size() / 2), Limited, Data.size()));
+    }
+    for (const auto* Codec : Compression::Codecs()) {
+        // from clients, only zlib and the codec they chose are accepted
+        auto Packet = Compression::CompressPacket(*Codec, Data);
+        CHECK(Compression::DecompressPacket(std::vector<uint8_t>(Packet), nullptr, Codec) == Data);
+        CHECK(Compression::DecompressPacket(std::vector<uint8_t>(Packet), nullptr, &Compression::Zlib()) == Data);
+        for (const auto* Other : Compression::Codecs()) {
+            if (Codec != Other && Codec != &Compression::Zlib()) {
+                CHECK_THROWS(Compression::DecompressPacket(std::vector<uint8_t>(Packet), nullptr, Other));
+            }
+        }
+    }
+    CHECK(Compression::Find("nope") == nullptr);
+    std::vector<uint8_t> Plain { 'O', 's', ':' };
+    CHECK(Compression::CodecOf(Plain) == nullptr);
+    CHECK(Compression::DecompressPacket(std::vector<uint8_t>(Plain)) == Plain);
+}
+
+TEST_CASE("Compression zlib is compatible with compress()/uncompress()") {
+    const std::string Text(5000, 'x');
+    std::vector<uint8_t> Compressed(compressBound(uLong(Text.size())));
+    uLongf CompressedSize = uLongf(Compressed.size());
+    REQUIRE(compress(Compressed.data(), &CompressedSize, reinterpret_cast<const Bytef*>(Text.data()), uLong(Text.size())) == Z_OK);
+    Compressed.resize(CompressedSize);
+    std::vector<uint8_t> Out;
+    Compression::Zlib().Decompress(Compressed, Out, Text.size());
+    CHECK(std::string(Out.begin(), Out.end()) == Text);
+
+    std::vector<uint8_t> Ours;
+    Compression::Zlib().Compress({ reinterpret_cast<const uint8_t*>(Text.data()), Text.size() }, Ours);
+    std::vector<uint8_t> Back(Text.size());
+    uLongf BackSize = uLongf(Back.size());
+    REQUIRE(uncompress(Back.data(), &BackSize, Ours.data(), uLong(Ours.size())) == Z_OK);
+    CHECK(BackSize == Text.size());
+}
+
+TEST_CASE("Compression budget") {
+    const std::vector<uint8_t> Data(10000, 'x');
+    const auto Packet = Compression::CompressPacket(Compression::Zlib(), Data);
+    auto Now = TDecompressionBudget::TClock::now();
+    TDecompressionBudget Budget(1000, 15000);
+    CHECK(Budget.IsLimited());
+    CHECK(Compression::DecompressPacket(std::vector<uint8_t>(Packet), &Budget) == Data);
+    CHECK(Budget.Available(Now) <= 5000);
+    // stops as soon as what's left is used up, and that's gone then
+    CHECK_THROWS(Compression::DecompressPacket(std::vector<uint8_t>(Packet), &Budget));
+    CHECK(Budget.Available(Now) == 0);
+    CHECK(Budget.Available(Now + std::chrono::seconds(12)) >= 10000);
+    CHECK(Compression::DecompressPacket(std::vector<uint8_t>(Packet), &Budget) == Data);
+    // never more than the burst
+    CHECK(Budget.Available(Now + std::chrono::hours(1)) == 15000);
+
+    // a packet which fails costs everything it was allowed to produce
+    TDecompressionBudget Failing(1000, 15000);
+    auto Broken = Packet;
+    Broken.resize(Broken.size() / 2);
+    CHECK_THROWS(Compression::DecompressPacket(std::move(Broken), &Failing));
+    CHECK(Failing.Available(Now) == 0);
+    auto Bomb = Compression::CompressPacket(Compression::Zlib(), std::vector<uint8_t>(20000, 'x'));
+    CHECK_THROWS(Compression::DecompressPacket(std::move(Bomb), &Failing));
+    CHECK(Failing.Available(Now + std::chrono::seconds(1)) <= 1000);
+
+    TDecompressionBudget Unlimited(0, 0);
+    CHECK(Unlimited.Available() == Compression::MaxDecompressedSize);
+}
+
+TEST_CASE("Compression dictionary") {
+    const std::string Dictionary = R"("jbm":"pickup","vcf":{"model":"pickup","parts":{"pickup_body":"pickup_body","pickup_engine":"pickup_engine_v8"})";
+    const std::string Text = R"(Oc:0-0:{"jbm":"pickup","vcf":{"model":"pickup","parts":{"pickup_body":"pickup_body","pickup_engine":"pickup_engine_i6"}}})";
+    const std::span<const uint8_t> Data(reinterpret_cast<const uint8_t*>(Text.data()), Text.size());
+
+    // a standalone codec, the registry stays as it is
+    CHECK_THROWS(Compression::MakeDictionaryCodec({}));
+    CHECK_THROWS(Compression::MakeDictionaryCodec(std::vector<uint8_t>(Compression::MaxDictionarySize + 1, 'x')));
+    const auto Codec = Compression::MakeDictionaryCodec({ Dictionary.begin(), Dictionary.end() });
+    CHECK(Codec->Name() == fmt::format("zdict-{:08x}", Compression::DictionaryID({ reinterpret_cast<const uint8_t*>(Dictionary.data()), Dictionary.size() })));
+    CHECK(Compression::Find(Codec->Name()) == nullptr);
+
+    std::vector<uint8_t> Compressed;
+    Codec->Compress(Data, Compressed);
+    std::vector<uint8_t> Plain;
+    Compression::Zlib().Compress(Data, Plain);
+    CHECK(Compressed.size() < Plain.size());
+    std::vector<uint8_t> Back;
+    Codec->Decompress(Compressed, Back, Text.size());
+    CHECK(std::string(Back.begin(), Back.end()) == Text);
+
+    // plain zlib can't read it, and neither can a codec with another dictionary
+    std::vector<uint8_t> Out;
+    CHECK_THROWS(Compression::Zlib().Decompress(Compressed, Out, Compression::MaxDecompressedSize));
+    const auto Other = Compression::MakeDictionaryCodec({ Text.begin(), Text.end() });
+    CHECK_THROWS(Other->Decompress(Compressed, Out, Compression::MaxDecompressedSize));
+}
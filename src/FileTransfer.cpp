@@ -0,0 +1,304 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "FileTransfer.h"
+
+#include "Environment.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <doctest/doctest.h>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#ifdef BEAMMP_LINUX
+#include <poll.h>
+#include <sys/sendfile.h>
+#endif
+
+namespace FileTransfer {
+
+namespace {
+// kept for the whole transfer, so throttled chunks don't open the file or allocate again
+struct TFallbackState {
+    std::ifstream Stream;
+    std::vector<uint8_t> Buffer;
+    bool ZeroCopyUnsupported { false };
+};
+}
+
+// reads through the shared file descriptor where there is one, otherwise through a stream
+static size_t ReadFallback(const TMappedFile& File, uint64_t Offset, size_t Size, TFallbackState& State) {
+    if (File.NativeHandle() >= 0) {
+        return File.ReadAt(Offset, State.Buffer.data(), Size);
+    }
+    if (!State.Stream.is_open()) {
+        State.Stream.open(File.Path(), std::ios::binary);
+    }
+    State.Stream.clear();
+    State.Stream.seekg(std::streamoff(Offset), std::ios::beg);
+    State.Stream.read(reinterpret_cast<char*>(State.Buffer.data()), std::streamsize(Size));
+    return size_t(State.Stream.gcount());
+}
+
+static void SendBuffered(ip::tcp::socket& Socket, const TMappedFile& File, uint64_t Offset, uint64_t Size, TFallbackState& State, TResult& Result) {
+    if (State.Buffer.empty()) {
+        State.Buffer.resize(FallbackBufferSize);
+    }
+    while (Result.ZeroCopyBytes + Result.CopiedBytes < Size) {
+        const auto Done = Result.ZeroCopyBytes + Result.CopiedBytes;
+        const auto ToRead = size_t(std::min<uint64_t>(State.Buffer.size(), Size - Done));
+        if (ReadFallback(File, Offset + Done, ToRead, State) != ToRead) {
+            Result.Error = "Failed to read " + File.Path();
+            return;
+        }
+        boost::system::error_code ec;
+        write(Socket, buffer(State.Buffer.data(), ToRead), ec);
+        if (ec) {
+            Result.Error = ec.message();
+            return;
+        }
+        Result.CopiedBytes += ToRead;
+    }
+    Result.Ok = true;
+}
+
+static void SendMapped(ip::tcp::socket& Socket, const uint8_t* Data, uint64_t Offset, uint64_t Size, TResult& Result) {
+    boost::system::error_code ec;
+    write(Socket, buffer(Data + Offset, size_t(Size)), ec);
+    if (ec) {
+        Result.Error = ec.message();
+        return;
+    }
+    Result.CopiedBytes += Size;
+    Result.Ok = true;
+}
+
+#ifdef BEAMMP_LINUX
+// waits until the socket takes more data, for at most StallTimeout
+static bool WaitWritable(int SocketFd, const TIsAlive& IsAlive, std::string& Error) {
+    constexpr auto PollInterval = std::chrono::milliseconds(100);
+    const auto Deadline = std::chrono::steady_clock::now() + StallTimeout;
+    while (true) {
+        if (IsAlive && !IsAlive()) {
+            Error = "Transfer cancelled";
+            return false;
+        }
+        const auto Left = Deadline - std::chrono::steady_clock::now();
+        if (Left <= std::chrono::steady_clock::duration::zero()) {
+            Error = "Peer stopped receiving";
+            return false;
+        }
+        pollfd Poll { SocketFd, POLLOUT, 0 };
+        const auto Timeout = std::chrono::ceil<std::chrono::milliseconds>(std::min<std::chrono::steady_clock::duration>(Left, PollInterval));
+        const int Ready = poll(&Poll, 1, int(Timeout.count()));
+        if (Ready > 0) {
+            // errors on the socket are reported by the next send
+            return true;
+        }
+        if (Ready < 0 && errno != EINTR) {
+            Error = std::strerror(errno);
+            return false;
+        }
+    }
+}
+
+// returns false if the rest should be sent another way, sets Result.Error on fatal errors
+static bool SendZeroCopy(ip::tcp::socket& Socket, int Fd, const std::string& Path, uint64_t Offset, uint64_t Size, const TIsAlive& IsAlive, TResult& Result) {
+    const int SocketFd = Socket.native_handle();
+    // a blocking sendfile() to a peer which stopped reading would never return. asio's own
+    // blocking operations handle a non-blocking descriptor, so this doesn't affect them.
+    boost::system::error_code ec;
+    Socket.native_non_blocking(true, ec);
+    // sendfile() doesn't touch the file position when given an offset, so the
+    // descriptor can be shared by any number of concurrent transfers
+    auto FileOffset = off_t(Offset);
+    while (Result.ZeroCopyBytes < Size) {
+        // sendfile() transfers at most ~2 GB per call
+        const auto Chunk = size_t(std::min<uint64_t>(Size - Result.ZeroCopyBytes, 1 << 30));
+        const auto Sent = sendfile(SocketFd, Fd, &FileOffset, Chunk);
+        if (Sent > 0) {
+            Result.ZeroCopyBytes += uint64_t(Sent);
+        } else if (Sent == 0) {
+            Result.Error = "Unexpected end of " + Path;
+            break;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN) {
+            if (!WaitWritable(SocketFd, IsAlive, Result.Error)) {
+                break;
+            }
+        } else if ((errno == EINVAL || errno == ENOSYS) && Result.ZeroCopyBytes == 0) {
+            // not supported for this file (system), nothing was sent yet
+            return false;
+        } else {
+            Result.Error = std::strerror(errno);
+            break;
+        }
+    }
+    Result.Ok = Result.Error.empty();
+    return true;
+}
+#endif
+
+static TResult SendChunk(ip::tcp::socket& Socket, const TMappedFile& File, uint64_t Offset, uint64_t Size, TFallbackState& State, const TIsAlive& IsAlive) {
+    TResult Result;
+#ifdef BEAMMP_LINUX
+    if (File.NativeHandle() >= 0 && !State.ZeroCopyUnsupported) {
+        if (SendZeroCopy(Socket, File.NativeHandle(), File.Path(), Offset, Size, IsAlive, Result)) {
+            return Result;
+        }
+        State.ZeroCopyUnsupported = true;
+    }
+#endif
+    if (File.Data()) {
+        SendMapped(Socket, File.Data(), Offset, Size, Result);
+    } else {
+        SendBuffered(Socket, File, Offset, Size, State, Result);
+    }
+    return Result;
+}
+
+TResult SendRange(ip::tcp::socket& Socket, const TMappedFile& File, uint64_t Offset, uint64_t Size, const TThrottle& Throttle, const TIsAlive& IsAlive) {
+    if (Offset > File.Size() || Size > File.Size() - Offset) {
+        TResult Result;
+        Result.Error = "Range " + std::to_string(Offset) + "+" + std::to_string(Size) + " is outside of " + File.Path();
+        return Result;
+    }
+    TFallbackState State;
+    if (!Throttle) {
+        return SendChunk(Socket, File, Offset, Size, State, IsAlive);
+    }
+    TResult Total;
+    uint64_t Done = 0;
+    while (Done < Size) {
+        const auto ChunkSize = std::min<uint64_t>(ThrottledChunkSize, Size - Done);
+        if (!Throttle(ChunkSize)) {
+            Total.Error = "Transfer cancelled";
+            return Total;
+        }
+        auto Chunk = SendChunk(Socket, File, Offset + Done, ChunkSize, State, IsAlive);
+        Total.ZeroCopyBytes += Chunk.ZeroCopyBytes;
+        Total.CopiedBytes += Chunk.CopiedBytes;
+        if (!Chunk.Ok) {
+            Total.Error = std::move(Chunk.Error);
+            return Total;
+        }
+        Done += ChunkSize;
+    }
+    Total.Ok = true;
+    return Total;
+}
+
+TResult SendRange(ip::tcp::socket& Socket, const std::string& Path, uint64_t Offset, uint64_t Size) {
+    std::shared_ptr<const TMappedFile> File;
+    try {
+        File = TMappedFile::Open(Path);
+    } catch (const std::exception& e) {
+        TResult Result;
+        Result.Error = e.what();
+        return Result;
+    }
+    return SendRange(Socket, *File, Offset, Size);
+}
+
+}
+
+TEST_CASE("FileTransfer::SendRange") {
+    const auto Path = (std::filesystem::temp_directory_path() / "beammp_file_transfer_test.bin").string();
+    std::vector<char> Content(3 * FileTransfer::FallbackBufferSize + 123);
+    for (size_t i = 0; i < Content.size(); ++i) {
+        Content[i] = char(i * 7);
+    }
+    {
+        std::ofstream File(Path, std::ios::binary);
+        File.write(Content.data(), std::streamsize(Content.size()));
+    }
+    io_context Io;
+    ip::tcp::acceptor Acceptor(Io, ip::tcp::endpoint(ip::address_v4::loopback(), 0));
+    ip::tcp::socket Sender(Io);
+    Sender.connect(Acceptor.local_endpoint());
+    auto Receiver = Acceptor.accept();
+
+    const uint64_t Offset = 1000;
+    const uint64_t Size = Content.size() - Offset - 10;
+    std::vector<char> Received(Size);
+    std::thread Reader([&] {
+        read(Receiver, buffer(Received));
+    });
+    auto Result = FileTransfer::SendRange(Sender, Path, Offset, Size);
+    Reader.join();
+    CHECK(Result.Ok);
+    CHECK(Result.ZeroCopyBytes + Result.CopiedBytes == Size);
+    CHECK(std::equal(Received.begin(), Received.end(), Content.begin() + Offset));
+
+    std::vector<char> Throttled(Size);
+    size_t ThrottleCalls = 0;
+    std::thread ThrottledReader([&] {
+        read(Receiver, buffer(Throttled));
+    });
+    auto ThrottledResult = FileTransfer::SendRange(Sender, *TMappedFile::Open(Path), Offset, Size, [&](uint64_t ChunkSize) {
+        CHECK(ChunkSize <= FileTransfer::ThrottledChunkSize);
+        ++ThrottleCalls;
+        return true;
+    });
+    ThrottledReader.join();
+    CHECK(ThrottledResult.Ok);
+    CHECK(ThrottleCalls == (Size + FileTransfer::ThrottledChunkSize - 1) / FileTransfer::ThrottledChunkSize);
+    CHECK(Throttled == Received);
+    auto Cancelled = FileTransfer::SendRange(Sender, *TMappedFile::Open(Path), 0, 1, [](uint64_t) { return false; });
+    CHECK(!Cancelled.Ok);
+
+    auto Missing = FileTransfer::SendRange(Sender, Path + ".missing", 0, 1);
+    CHECK(!Missing.Ok);
+    CHECK(!Missing.Error.empty());
+    auto OutOfRange = FileTransfer::SendRange(Sender, *TMappedFile::Open(Path), Content.size() - 1, 2);
+    CHECK(!OutOfRange.Ok);
+    CHECK(OutOfRange.ZeroCopyBytes + OutOfRange.CopiedBytes == 0);
+    std::filesystem::remove(Path);
+}
+
+#ifdef BEAMMP_LINUX
+TEST_CASE("FileTransfer::SendRange to a peer which stopped reading") {
+    const auto Path = (std::filesystem::temp_directory_path() / "beammp_file_transfer_stall_test.bin").string();
+    {
+        std::ofstream File(Path, std::ios::binary);
+        std::vector<char> Content(8 * 1024 * 1024);
+        File.write(Content.data(), std::streamsize(Content.size()));
+    }
+    io_context Io;
+    ip::tcp::acceptor Acceptor(Io, ip::tcp::endpoint(ip::address_v4::loopback(), 0));
+    ip::tcp::socket Sender(Io);
+    Sender.connect(Acceptor.local_endpoint());
+    auto Receiver = Acceptor.accept();
+    Sender.set_option(socket_base::send_buffer_size(4096));
+    Receiver.set_option(socket_base::receive_buffer_size(4096));
+
+    // the receiver never reads, so the transfer only ends because the client is gone
+    int Checks = 0;
+    auto File = TMappedFile::Open(Path);
+    auto Result = FileTransfer::SendRange(Sender, *File, 0, File->Size(), {}, [&] { return ++Checks < 3; });
+    CHECK(!Result.Ok);
+    CHECK(Checks == 3);
+    CHECK(Result.ZeroCopyBytes < File->Size());
+    std::filesystem::remove(Path);
+}
+#endif
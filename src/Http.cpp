@@ -21,8 +21,12 @@
 #include "Client.h"
 #include "Common.h"
 #include "CustomAssert.h"
+#include "FileTransfer.h"
 #include "LuaAPI.h"
+#include "TBandwidthScheduler.h"
+#include "TResourceManager.h"
 
+#include <fstream>
 #include <map>
 #include <nlohmann/json.hpp>
 #include <random>
@@ -194,15 +198,108 @@ TEST_CASE("Http::Status::ToString") {
     CHECK(Http::Status::ToString(-1) == "Invalid Response Code");
 }
 
-Http::Server::THttpServerInstance::THttpServerInstance() {
+Http::Server::THttpServerInstance::THttpServerInstance(TResourceManager& ResourceManager, TBandwidthScheduler& Bandwidth)
+    : mResourceManager(ResourceManager)
+    , mBandwidth(Bandwidth)
+    , mServer(std::make_unique<httplib::Server>()) {
     Application::SetSubsystemStatus("HTTPServer", Application::Status::Starting);
+    Application::RegisterShutdownHandler([this] {
+        Application::SetSubsystemStatus("HTTPServer", Application::Status::ShuttingDown);
+        Stop();
+        Application::SetSubsystemStatus("HTTPServer", Application::Status::Shutdown);
+    });
     mThread = std::thread(&Http::Server::THttpServerInstance::operator(), this);
-    mThread.detach();
+}
+
+Http::Server::THttpServerInstance::~THttpServerInstance() {
+    Stop();
+}
+
+void Http::Server::THttpServerInstance::Stop() {
+    mStopping = true;
+    // stop() does nothing until listen() is actually running, so either the thread sees
+    // mStopping and never listens, or we wait here until stop() can reach it
+    while (mListening && !mServer->is_running()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    mServer->stop();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void Http::Server::THttpServerInstance::ServeModList(httplib::Response& res) {
+    auto List = json::array();
+    for (const auto& Mod : mResourceManager.Mods()) {
+        List.push_back({
+            { "name", fs::path(Mod.Path).filename().string() },
+            { "size", Mod.Size },
+            { "sha256", Mod.Hash },
+        });
+    }
+    res.set_content(List.dump(), "application/json");
+}
+
+void Http::Server::THttpServerInstance::ServeMod(const httplib::Request& req, httplib::Response& res) {
+    const auto Name = req.matches[1].str();
+    // only files from the mod list can be requested, which rules out any path tricks
+    const auto& Mods = mResourceManager.Mods();
+    auto Mod = std::find_if(Mods.begin(), Mods.end(), [&](const TResourceManager::TModInfo& Info) {
+        return fs::path(Info.Path).filename().string() == Name;
+    });
+    if (Mod == Mods.end()) {
+        res.status = 404;
+        return;
+    }
+    std::shared_ptr<const TMappedFile> File;
+    try {
+        File = mResourceManager.OpenMod(Mod->Path);
+    } catch (const std::exception& e) {
+        beammp_warnf("Http Server: failed to open mod: {}", e.what());
+        res.status = 404;
+        return;
+    }
+    // the hash is from startup, it's only valid if the file hasn't changed since
+    if (!Mod->Hash.empty() && File->Size() == Mod->Size && File->LastWriteTime().time_since_epoch().count() == Mod->LastWrite) {
+        const auto ETag = "\"" + Mod->Hash + "\"";
+        res.set_header("ETag", ETag);
+        if (req.get_header_value("If-None-Match") == ETag) {
+            res.status = 304;
+            return;
+        }
+    }
+    res.set_header("Cache-Control", "no-cache");
+    // httplib answers range requests (206, Content-Range, 416) itself, calling this only for the requested bytes
+    // both are kept for the whole response, not allocated per chunk
+    std::shared_ptr<std::ifstream> Stream;
+    std::vector<char> Buffer;
+    res.set_content_provider(size_t(File->Size()), "application/zip",
+        [this, File, Stream, Buffer](size_t Offset, size_t Length, httplib::DataSink& Sink) mutable {
+            const auto ChunkSize = std::min<size_t>(Length, FileTransfer::ThrottledChunkSize);
+            if (mBandwidth.IsLimited() && !mBandwidth.Acquire(ChunkSize)) {
+                return false;
+            }
+            if (File->Data()) {
+                // straight from the shared mapping, no per-request buffer
+                return Sink.write(reinterpret_cast<const char*>(File->Data() + Offset), ChunkSize);
+            }
+            Buffer.resize(FileTransfer::ThrottledChunkSize);
+            if (File->NativeHandle() >= 0) {
+                // the shared file descriptor, no need to open the file again
+                return File->ReadAt(Offset, reinterpret_cast<uint8_t*>(Buffer.data()), ChunkSize) == ChunkSize && Sink.write(Buffer.data(), ChunkSize);
+            }
+            if (!Stream) {
+                Stream = std::make_shared<std::ifstream>(File->Path(), std::ios::binary);
+            }
+            Stream->seekg(std::streamoff(Offset));
+            Stream->read(Buffer.data(), std::streamsize(ChunkSize));
+            return size_t(Stream->gcount()) == ChunkSize && Sink.write(Buffer.data(), ChunkSize);
+        });
 }
 
 void Http::Server::THttpServerInstance::operator()() try {
-    std::unique_ptr<httplib::Server> HttpLibServerInstance;
-    HttpLibServerInstance = std::make_unique<httplib::Server>();
+    RegisterThread("HTTPServer");
+    auto& HttpLibServerInstance = mServer;
     // todo: make this IP agnostic so people can set their own IP
     HttpLibServerInstance->Get("/", [](const httplib::Request&, httplib::Response& res) {
         res.set_content("<!DOCTYPE html><article><h1>Hello World!</h1><section><p>BeamMP Server can now serve HTTP requests!</p></section></article></html>", "text/html");
@@ -238,10 +335,33 @@ void Http::Server::THttpServerInstance::operator()() try {
     HttpLibServerInstance->Get({ 0x2f, 0x6b, 0x69, 0x74, 0x74, 0x79 }, [](const httplib::Request&, httplib::Response& res) {
         res.set_content(std::string(Magic), "text/plain");
     });
+    if (Application::Settings.getAsBool(Settings::Key::HTTP_ModMirror)) {
+        HttpLibServerInstance->Get("/mods", [this](const httplib::Request&, httplib::Response& res) {
+            ServeModList(res);
+        });
+        HttpLibServerInstance->Get(R"(/mods/([^/]+\.zip))", [this](const httplib::Request& req, httplib::Response& res) {
+            ServeMod(req, res);
+        });
+    }
     HttpLibServerInstance->set_logger([](const httplib::Request& Req, const httplib::Response& Res) {
         beammp_debug("Http Server: " + Req.method + " " + Req.target + " -> " + std::to_string(Res.status));
     });
+    const auto Ip = Application::Settings.getAsString(Settings::Key::HTTP_Ip);
+    const auto Port = Application::Settings.getAsInt(Settings::Key::HTTP_Port);
     Application::SetSubsystemStatus("HTTPServer", Application::Status::Good);
+    beammp_infof("HTTP server listening on {}:{}", Ip, Port);
+    mListening = true;
+    if (mStopping) {
+        mListening = false;
+        return;
+    }
+    // blocks until stopped
+    if (!HttpLibServerInstance->listen(Ip, Port)) {
+        beammp_errorf("HTTP server failed to listen on {}:{}", Ip, Port);
+        Application::SetSubsystemStatus("HTTPServer", Application::Status::Bad);
+    }
+    mListening = false;
 } catch (const std::exception& e) {
+    mListening = false;
     beammp_error("Failed to start http server. Please ensure the http server is configured properly in the ServerConfig.toml, or turn it off if you don't need it. Error: " + std::string(e.what()));
 }
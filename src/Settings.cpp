@@ -35,6 +35,35 @@ Settings::Settings() {
         { General_ResourceFolder, std::string("Resources") },
         { General_Debug, false },
         { General_AllowGuests, true },
+        { General_AuthProvider, std::string("backend") },
+        { General_AuthBackend, std::string("auth.beammp.com:443") },
+        { General_AuthFile, std::string("auth.json") },
+        { Network_AsyncIO, false },
+        { Network_IoThreads, 0 },
+        { Network_UDPThreads, 1 },
+        { Network_InterestManagement, false },
+        { Network_InterestNearRadius, 300 },
+        { Network_InterestFarRadius, 1000 },
+        { Network_InterestMidInterval, 3 },
+        { Network_InterestFarInterval, 10 },
+        { Network_PositionTickRate, 0 },
+        { Network_PositionDeltas, false },
+        { Network_MaxQueuedPackets, 4096 },
+        { Network_MaxQueuedMB, 64 },
+        { Network_AuthWorkers, 4 },
+        { Network_AuthCacheSeconds, 60 },
+        { Network_HandshakeWorkers, 16 },
+        { Network_MaxPendingHandshakes, 256 },
+        { Network_HandshakeTimeout, 10 },
+        { Network_UplinkKBps, 0 },
+        { Network_GameplayReserveKBps, 0 },
+        { Network_DecompressionBudgetKBps, 4096 },
+        { Network_CompressionDictionary, std::string("") },
+        { Network_ReceiveQuotaMB, 32 },
+        { HTTP_Enabled, false },
+        { HTTP_Ip, std::string("127.0.0.1") },
+        { HTTP_Port, 8080 },
+        { HTTP_ModMirror, false },
         { Misc_SendErrorsShowMessage, true },
         { Misc_SendErrors, true },
         { Misc_ImScaredOfUpdates, true },
@@ -56,6 +85,35 @@ Settings::Settings() {
         { { "General", "ResourceFolder" }, { General_ResourceFolder, READ_ONLY } },
         { { "General", "Debug" }, { General_Debug, READ_WRITE } },
         { { "General", "AllowGuests" }, { General_AllowGuests, READ_WRITE } },
+        { { "General", "AuthProvider" }, { General_AuthProvider, READ_ONLY } },
+        { { "General", "AuthBackend" }, { General_AuthBackend, READ_ONLY } },
+        { { "General", "AuthFile" }, { General_AuthFile, READ_ONLY } },
+        { { "Network", "AsyncIO" }, { Network_AsyncIO, READ_ONLY } },
+        { { "Network", "IoThreads" }, { Network_IoThreads, READ_ONLY } },
+        { { "Network", "UDPThreads" }, { Network_UDPThreads, READ_ONLY } },
+        { { "Network", "InterestManagement" }, { Network_InterestManagement, READ_ONLY } },
+        { { "Network", "InterestNearRadius" }, { Network_InterestNearRadius, READ_ONLY } },
+        { { "Network", "InterestFarRadius" }, { Network_InterestFarRadius, READ_ONLY } },
+        { { "Network", "InterestMidInterval" }, { Network_InterestMidInterval, READ_ONLY } },
+        { { "Network", "InterestFarInterval" }, { Network_InterestFarInterval, READ_ONLY } },
+        { { "Network", "PositionTickRate" }, { Network_PositionTickRate, READ_ONLY } },
+        { { "Network", "PositionDeltas" }, { Network_PositionDeltas, READ_ONLY } },
+        { { "Network", "MaxQueuedPackets" }, { Network_MaxQueuedPackets, READ_ONLY } },
+        { { "Network", "MaxQueuedMB" }, { Network_MaxQueuedMB, READ_ONLY } },
+        { { "Network", "AuthWorkers" }, { Network_AuthWorkers, READ_ONLY } },
+        { { "Network", "AuthCacheSeconds" }, { Network_AuthCacheSeconds, READ_ONLY } },
+        { { "Network", "HandshakeWorkers" }, { Network_HandshakeWorkers, READ_ONLY } },
+        { { "Network", "MaxPendingHandshakes" }, { Network_MaxPendingHandshakes, READ_ONLY } },
+        { { "Network", "HandshakeTimeout" }, { Network_HandshakeTimeout, READ_ONLY } },
+        { { "Network", "UplinkKBps" }, { Network_UplinkKBps, READ_ONLY } },
+        { { "Network", "GameplayReserveKBps" }, { Network_GameplayReserveKBps, READ_ONLY } },
+        { { "Network", "DecompressionBudgetKBps" }, { Network_DecompressionBudgetKBps, READ_ONLY } },
+        { { "Network", "CompressionDictionary" }, { Network_CompressionDictionary, READ_ONLY } },
+        { { "Network", "ReceiveQuotaMB" }, { Network_ReceiveQuotaMB, READ_ONLY } },
+        { { "HTTP", "Enabled" }, { HTTP_Enabled, READ_ONLY } },
+        { { "HTTP", "Ip" }, { HTTP_Ip, READ_ONLY } },
+        { { "HTTP", "Port" }, { HTTP_Port, READ_ONLY } },
+        { { "HTTP", "ModMirror" }, { HTTP_ModMirror, READ_ONLY } },
         { { "Misc", "SendErrorsShowMessage" }, { Misc_SendErrorsShowMessage, READ_WRITE } },
         { { "Misc", "SendErrors" }, { Misc_SendErrors, READ_WRITE } },
         { { "Misc", "ImScaredOfUpdates" }, { Misc_ImScaredOfUpdates, READ_WRITE } },
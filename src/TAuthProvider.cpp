@@ -0,0 +1,180 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "TAuthProvider.h"
+
+#include "Common.h"
+#include "Http.h"
+
+#include <doctest/doctest.h>
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+static std::optional<TAuthIdentity> IdentityFromJson(const nlohmann::json& AuthRes) {
+    if (!AuthRes.is_object() || !AuthRes.contains("username") || !AuthRes.contains("roles")
+        || !AuthRes.contains("guest") || !AuthRes.contains("identifiers")) {
+        return std::nullopt;
+    }
+    if (!AuthRes["username"].is_string() || !AuthRes["roles"].is_string()
+        || !AuthRes["guest"].is_boolean() || !AuthRes["identifiers"].is_array()) {
+        return std::nullopt;
+    }
+    TAuthIdentity Identity;
+    Identity.Username = AuthRes["username"];
+    Identity.Roles = AuthRes["roles"];
+    Identity.Guest = AuthRes["guest"];
+    for (const auto& ID : AuthRes["identifiers"]) {
+        if (!ID.is_string()) {
+            return std::nullopt;
+        }
+        auto Raw = std::string(ID);
+        auto SepIndex = Raw.find(':');
+        if (SepIndex == std::string::npos) {
+            Identity.Identifiers.emplace_back(Raw, "");
+        } else {
+            Identity.Identifiers.emplace_back(Raw.substr(0, SepIndex), Raw.substr(SepIndex + 1));
+        }
+    }
+    return Identity;
+}
+
+std::optional<TAuthIdentity> TAuthIdentity::FromJson(const std::string& Json) {
+    auto Parsed = nlohmann::json::parse(Json, nullptr, false);
+    if (Parsed.is_discarded()) {
+        return std::nullopt;
+    }
+    return IdentityFromJson(Parsed);
+}
+
+TBackendAuthProvider::TBackendAuthProvider(std::string Host, int Port, std::string AuthKey)
+    : mHost(std::move(Host))
+    , mPort(Port)
+    , mAuthKey(std::move(AuthKey)) {
+}
+
+TAuthResult TBackendAuthProvider::Authenticate(const TAuthRequest& Request) {
+    std::string AuthResStr;
+    try {
+        nlohmann::json AuthReq {
+            { "key", Request.Key },
+            { "auth_key", mAuthKey },
+            { "client_ip", Request.ClientIp }
+        };
+        unsigned int ResponseCode = 0;
+        AuthResStr = Http::POST(mHost, mPort, "/pkToUser", AuthReq.dump(), "application/json", &ResponseCode);
+    } catch (const std::exception& e) {
+        beammp_debugf("Invalid json sent by client, kicking: {}", e.what());
+        return { std::nullopt, "Invalid Key (invalid UTF8 string)!" };
+    }
+    if (AuthResStr == Http::ErrorString) {
+        beammp_error("Authentication backend could not be reached");
+        return { std::nullopt, "Authentication failed, please try again later.", false };
+    }
+    auto AuthRes = nlohmann::json::parse(AuthResStr, nullptr, false);
+    if (AuthRes.is_discarded()) {
+        // TODO: we should really clarify that this was a backend response or parsing error
+        beammp_errorf("Client sent invalid key. Backend responded with: {}", AuthResStr);
+        return { std::nullopt, "Invalid key! Please restart your game.", false };
+    }
+    auto Identity = IdentityFromJson(AuthRes);
+    if (!Identity) {
+        beammp_error("Invalid authentication data received from authentication backend");
+        return { std::nullopt, "Invalid authentication data!", false };
+    }
+    return { std::move(Identity), "" };
+}
+
+TFileAuthProvider::TFileAuthProvider(const std::filesystem::path& Path)
+    : mPath(Path.string()) {
+    std::ifstream File(Path);
+    if (!File) {
+        throw std::runtime_error("Failed to open auth file '" + mPath + "'");
+    }
+    auto Json = nlohmann::json::parse(File, nullptr, false);
+    if (Json.is_discarded() || !Json.is_object()) {
+        throw std::runtime_error("Auth file '" + mPath + "' has to contain a json object");
+    }
+    for (const auto& [Key, Value] : Json.items()) {
+        auto Identity = IdentityFromJson(Value);
+        if (!Identity) {
+            throw std::runtime_error("Invalid identity for a key in auth file '" + mPath + "'");
+        }
+        mIdentities.emplace_back(Key, std::move(Identity.value()));
+    }
+}
+
+TAuthResult TFileAuthProvider::Authenticate(const TAuthRequest& Request) {
+    for (const auto& [Key, Identity] : mIdentities) {
+        if (Key == Request.Key) {
+            return { Identity, "" };
+        }
+    }
+    return { std::nullopt, "you are not allowed on the server!" };
+}
+
+std::unique_ptr<IAuthProvider> MakeAuthProviderFromSettings() {
+    const auto Provider = Application::Settings.getAsString(Settings::Key::General_AuthProvider);
+    if (Provider == "file") {
+        return std::make_unique<TFileAuthProvider>(Application::Settings.getAsString(Settings::Key::General_AuthFile));
+    }
+    if (Provider != "backend") {
+        beammp_warnf("Unknown AuthProvider '{}', using 'backend'", Provider);
+    }
+    auto Host = Application::Settings.getAsString(Settings::Key::General_AuthBackend);
+    int Port = 443;
+    if (auto Colon = Host.rfind(':'); Colon != std::string::npos) {
+        Port = std::stoi(Host.substr(Colon + 1));
+        Host = Host.substr(0, Colon);
+    }
+    return std::make_unique<TBackendAuthProvider>(Host, Port, Application::Settings.getAsString(Settings::Key::General_AuthKey));
+}
+
+TEST_CASE("TAuthIdentity::FromJson") {
+    auto Identity = TAuthIdentity::FromJson(R"({"username":"Lion","roles":"USER","guest":false,"identifiers":["beammp:123","ip:1.2.3.4"]})");
+    REQUIRE(Identity.has_value());
+    CHECK(Identity->Username == "Lion");
+    CHECK(Identity->Roles == "USER");
+    CHECK(!Identity->Guest);
+    REQUIRE(Identity->Identifiers.size() == 2);
+    CHECK(Identity->Identifiers[0] == std::pair<std::string, std::string> { "beammp", "123" });
+
+    CHECK(!TAuthIdentity::FromJson(R"({"username":"Lion","roles":"USER","guest":false})"));
+    CHECK(!TAuthIdentity::FromJson(R"({"username":1,"roles":"USER","guest":false,"identifiers":[]})"));
+    CHECK(!TAuthIdentity::FromJson("not json"));
+}
+
+TEST_CASE("TFileAuthProvider") {
+    const auto Path = std::filesystem::temp_directory_path() / "beammp_auth_test.json";
+    {
+        std::ofstream File(Path);
+        File << R"({"key1":{"username":"Player1","roles":"USER","guest":false,"identifiers":["beammp:1"]}})";
+    }
+    TFileAuthProvider Provider(Path);
+    auto Result = Provider.Authenticate({ "key1", "127.0.0.1" });
+    REQUIRE(Result.Identity.has_value());
+    CHECK(Result.Identity->Username == "Player1");
+    CHECK(!Provider.Authenticate({ "key2", "127.0.0.1" }).Identity);
+
+    {
+        std::ofstream File(Path);
+        File << R"({"key1":{"username":"Player1"}})";
+    }
+    CHECK_THROWS(TFileAuthProvider(Path));
+    std::filesystem::remove(Path);
+    CHECK_THROWS(TFileAuthProvider(Path));
+}
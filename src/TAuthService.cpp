@@ -0,0 +1,255 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "TAuthService.h"
+
+#include "Common.h"
+
+#include <doctest/doctest.h>
+
+TAuthService::TAuthService(std::unique_ptr<IAuthProvider> Provider, size_t Workers, std::chrono::seconds CacheTTL, size_t MaxPending)
+    : mProvider(std::move(Provider))
+    , mCacheTTL(CacheTTL)
+    , mMaxPending(MaxPending) {
+    for (size_t i = 0; i < std::max<size_t>(1, Workers); ++i) {
+        mWorkers.emplace_back([this, i] {
+            RegisterThread("AuthWorker" + std::to_string(i));
+            WorkerMain();
+        });
+    }
+}
+
+TAuthService::~TAuthService() {
+    Shutdown();
+}
+
+std::shared_future<TAuthResult> TAuthService::Authenticate(const TAuthRequest& Request) {
+    auto Promise = std::make_shared<std::promise<TAuthResult>>();
+    auto Future = Promise->get_future().share();
+    Authenticate(Request, [Promise](const TAuthResult& Result) { Promise->set_value(Result); });
+    return Future;
+}
+
+void TAuthService::Authenticate(const TAuthRequest& Request, TCallback Done) {
+    // the key alone isn't enough, the backend checks it against the IP
+    auto CacheKey = Request.Key + '\0' + Request.ClientIp;
+    std::unique_lock Lock(mMutex);
+    auto Finish = [&](TAuthResult Result) {
+        Lock.unlock();
+        Done(Result);
+    };
+    if (mShutdown) {
+        return Finish({ std::nullopt, "Server shutting down", false });
+    }
+    if (!mProvider) {
+        return Finish({ std::nullopt, "Authentication is not available on this server.", false });
+    }
+    if (auto Cached = mCache.find(CacheKey); Cached != mCache.end()) {
+        if (Cached->second.Expiry > TClock::now()) {
+            mCacheHits.fetch_add(1, std::memory_order_relaxed);
+            return Finish(Cached->second.Result);
+        }
+        mCache.erase(Cached);
+    }
+    if (auto Pending = mInFlight.find(CacheKey); Pending != mInFlight.end()) {
+        Pending->second->Waiting.push_back(std::move(Done));
+        return;
+    }
+    if (mJobs.size() >= mMaxPending) {
+        beammp_warnf("Too many pending authentication requests ({}), rejecting a join", mJobs.size());
+        return Finish({ std::nullopt, "Server is busy, please try again in a moment.", false });
+    }
+    auto Job = std::make_unique<TJob>();
+    Job->Request = Request;
+    Job->CacheKey = CacheKey;
+    Job->Waiting.push_back(std::move(Done));
+    mInFlight.emplace(std::move(CacheKey), Job.get());
+    mJobs.push_back(std::move(Job));
+    mJobsChanged.notify_one();
+}
+
+void TAuthService::WorkerMain() {
+    while (true) {
+        std::unique_ptr<TJob> Job;
+        {
+            std::unique_lock Lock(mMutex);
+            mJobsChanged.wait(Lock, [this] { return mShutdown || !mJobs.empty(); });
+            if (mShutdown) {
+                return;
+            }
+            Job = std::move(mJobs.front());
+            mJobs.pop_front();
+        }
+        TAuthResult Result;
+        mProviderCalls.fetch_add(1, std::memory_order_relaxed);
+        try {
+            Result = mProvider->Authenticate(Job->Request);
+        } catch (const std::exception& e) {
+            beammp_errorf("Authentication provider '{}' failed: {}", mProvider->Name(), e.what());
+            Result = { std::nullopt, "Authentication failed, please try again later.", false };
+        }
+        std::vector<TCallback> Waiting;
+        {
+            std::unique_lock Lock(mMutex);
+            // nobody can join this job anymore once it's gone from here
+            if (auto Iter = mInFlight.find(Job->CacheKey); Iter != mInFlight.end() && Iter->second == Job.get()) {
+                mInFlight.erase(Iter);
+            }
+            Waiting = std::move(Job->Waiting);
+            if (Result.Identity && Result.Cacheable && mCacheTTL.count() > 0) {
+                const auto Now = TClock::now();
+                std::erase_if(mCache, [Now](const auto& Entry) { return Entry.second.Expiry <= Now; });
+                mCache[Job->CacheKey] = TCacheEntry { Result, Now + mCacheTTL };
+            }
+        }
+        for (auto& Done : Waiting) {
+            Done(Result);
+        }
+    }
+}
+
+void TAuthService::Shutdown() {
+    std::deque<std::unique_ptr<TJob>> Abandoned;
+    {
+        std::unique_lock Lock(mMutex);
+        if (mShutdown) {
+            return;
+        }
+        mShutdown = true;
+        Abandoned.swap(mJobs);
+        for (const auto& Job : Abandoned) {
+            mInFlight.erase(Job->CacheKey);
+        }
+    }
+    mJobsChanged.notify_all();
+    const TAuthResult ShuttingDown { std::nullopt, "Server shutting down", false };
+    for (auto& Job : Abandoned) {
+        for (auto& Done : Job->Waiting) {
+            Done(ShuttingDown);
+        }
+    }
+    for (auto& Worker : mWorkers) {
+        if (Worker.joinable()) {
+            Worker.join();
+        }
+    }
+}
+
+namespace {
+// accepts every key, optionally blocking until released
+class TMockAuthProvider : public IAuthProvider {
+public:
+    TAuthResult Authenticate(const TAuthRequest& Request) override {
+        const auto Now = ++Concurrent;
+        auto Max = MaxConcurrent.load();
+        while (Now > Max && !MaxConcurrent.compare_exchange_weak(Max, Now)) { }
+        {
+            std::unique_lock Lock(Mutex);
+            Released.wait(Lock, [this] { return !Blocking; });
+        }
+        --Concurrent;
+        ++Calls;
+        TAuthIdentity Identity;
+        Identity.Username = "Player-" + Request.Key;
+        return { Identity, "" };
+    }
+    [[nodiscard]] std::string Name() const override { return "mock"; }
+
+    void Release() {
+        {
+            std::unique_lock Lock(Mutex);
+            Blocking = false;
+        }
+        Released.notify_all();
+    }
+
+    std::mutex Mutex;
+    std::condition_variable Released;
+    bool Blocking { false };
+    std::atomic<int> Concurrent { 0 };
+    std::atomic<int> MaxConcurrent { 0 };
+    std::atomic<int> Calls { 0 };
+};
+}
+
+TEST_CASE("TAuthService cache") {
+    auto Owned = std::make_unique<TMockAuthProvider>();
+    auto& Provider = *Owned;
+    TAuthService Service(std::move(Owned), 2, std::chrono::seconds(60));
+    auto First = Service.Authenticate({ "a", "1.1.1.1" }).get();
+    REQUIRE(First.Identity.has_value());
+    CHECK(First.Identity->Username == "Player-a");
+    // reconnect, served from the cache
+    CHECK(Service.Authenticate({ "a", "1.1.1.1" }).get().Identity->Username == "Player-a");
+    CHECK(Provider.Calls == 1);
+    CHECK(Service.CacheHits() == 1);
+    // different IP, not cached
+    (void)Service.Authenticate({ "a", "2.2.2.2" }).get();
+    CHECK(Provider.Calls == 2);
+}
+
+TEST_CASE("TAuthService concurrency limit and deduplication") {
+    auto Owned = std::make_unique<TMockAuthProvider>();
+    auto& Provider = *Owned;
+    Provider.Blocking = true;
+    TAuthService Service(std::move(Owned), 2, std::chrono::seconds(0), 4);
+    std::vector<std::shared_future<TAuthResult>> Futures;
+    for (int i = 0; i < 4; ++i) {
+        Futures.push_back(Service.Authenticate({ std::to_string(i), "1.1.1.1" }));
+    }
+    // same as one in flight, shares its call
+    Futures.push_back(Service.Authenticate({ "0", "1.1.1.1" }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    Provider.Release();
+    for (auto& Future : Futures) {
+        CHECK(Future.get().Identity.has_value());
+    }
+    CHECK(Provider.MaxConcurrent <= 2);
+    CHECK(Provider.Calls == 4);
+}
+
+TEST_CASE("TAuthService callback") {
+    auto Owned = std::make_unique<TMockAuthProvider>();
+    auto& Provider = *Owned;
+    Provider.Blocking = true;
+    TAuthService Service(std::move(Owned), 1, std::chrono::seconds(60));
+    std::promise<std::string> First;
+    std::promise<std::string> Second;
+    // returns while the provider is still blocked
+    Service.Authenticate({ "a", "1.1.1.1" }, [&](const TAuthResult& Result) { First.set_value(Result.Identity->Username); });
+    Service.Authenticate({ "a", "1.1.1.1" }, [&](const TAuthResult& Result) { Second.set_value(Result.Identity->Username); });
+    Provider.Release();
+    CHECK(First.get_future().get() == "Player-a");
+    CHECK(Second.get_future().get() == "Player-a");
+    CHECK(Provider.Calls == 1);
+    // cached, called right away
+    bool Called = false;
+    Service.Authenticate({ "a", "1.1.1.1" }, [&](const TAuthResult& Result) { Called = Result.Identity.has_value(); });
+    CHECK(Called);
+}
+
+TEST_CASE("TAuthService without provider") {
+    TAuthService Service(nullptr, 1, std::chrono::seconds(60));
+    CHECK(!Service.Authenticate({ "a", "1.1.1.1" }).get().Identity);
+}
+
+TEST_CASE("TAuthService shutdown") {
+    TAuthService Service(std::make_unique<TMockAuthProvider>(), 1, std::chrono::seconds(60));
+    Service.Shutdown();
+    CHECK(!Service.Authenticate({ "a", "1.1.1.1" }).get().Identity);
+}
@@ -0,0 +1,183 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "TBandwidthScheduler.h"
+
+#include <algorithm>
+#include <doctest/doctest.h>
+#include <thread>
+#include <vector>
+
+TBandwidthScheduler::TTimeSource TBandwidthScheduler::RealTime() {
+    return {
+        [] { return TClock::now(); },
+        [](std::unique_lock<std::mutex>& Lock, std::condition_variable& Condition, TClock::duration Duration) {
+            Condition.wait_for(Lock, Duration);
+        },
+    };
+}
+
+TBandwidthScheduler::TBandwidthScheduler(uint64_t BytesPerSecond, TTimeSource Time)
+    : mTime(std::move(Time))
+    , mRate(BytesPerSecond)
+    // 100ms worth of data
+    , mCapacity(double(BytesPerSecond) / 10.0)
+    , mLastRefill(mTime.Now())
+    , mWindowStart(mLastRefill) {
+    mTokens = mCapacity;
+}
+
+void TBandwidthScheduler::Refill(TClock::time_point Now) {
+    const auto Elapsed = std::chrono::duration<double>(Now - mLastRefill).count();
+    mLastRefill = Now;
+    mTokens = std::min(mCapacity, mTokens + Elapsed * double(mRate));
+}
+
+bool TBandwidthScheduler::Acquire(uint64_t Bytes) {
+    const auto Start = mTime.Now();
+    std::unique_lock Lock(mMutex);
+    if (mShutdown) {
+        return false;
+    }
+    if (mRate > 0) {
+        const auto Ticket = mNextTicket++;
+        mWaiting.fetch_add(1, std::memory_order_relaxed);
+        // wait for our turn
+        mTurnChanged.wait(Lock, [&] { return mShutdown || mServing == Ticket; });
+        // then for enough tokens. Chunks larger than the bucket go into debt instead,
+        // which delays the next one accordingly.
+        const auto Needed = std::min(double(Bytes), mCapacity);
+        while (!mShutdown) {
+            Refill(mTime.Now());
+            if (mTokens >= Needed) {
+                break;
+            }
+            const auto Missing = std::chrono::duration<double>((Needed - mTokens) / double(mRate));
+            // rounded up, so that the tokens are there afterwards
+            mTime.WaitFor(Lock, mTurnChanged, std::chrono::ceil<TClock::duration>(Missing));
+        }
+        mWaiting.fetch_sub(1, std::memory_order_relaxed);
+        if (mShutdown) {
+            return false;
+        }
+        mTokens -= double(Bytes);
+        ++mServing;
+        mTurnChanged.notify_all();
+    }
+    const auto Now = mTime.Now();
+    mMsWaited.fetch_add(uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(Now - Start).count()), std::memory_order_relaxed);
+    mBytesGranted.fetch_add(Bytes, std::memory_order_relaxed);
+    if (Now - mWindowStart >= std::chrono::seconds(1)) {
+        mLastWindowRate = uint64_t(double(mWindowBytes) / std::chrono::duration<double>(Now - mWindowStart).count());
+        mWindowStart = Now;
+        mWindowBytes = 0;
+    }
+    mWindowBytes += Bytes;
+    return true;
+}
+
+uint64_t TBandwidthScheduler::CurrentRate() {
+    std::unique_lock Lock(mMutex);
+    const auto Now = mTime.Now();
+    if (Now - mWindowStart >= std::chrono::seconds(2)) {
+        // nothing was sent for a while
+        return 0;
+    }
+    return mLastWindowRate;
+}
+
+void TBandwidthScheduler::Shutdown() {
+    std::unique_lock Lock(mMutex);
+    mShutdown = true;
+    mTurnChanged.notify_all();
+}
+
+TEST_CASE("TBandwidthScheduler unlimited") {
+    TBandwidthScheduler Scheduler(0);
+    CHECK(!Scheduler.IsLimited());
+    CHECK(Scheduler.Acquire(1'000'000'000));
+    CHECK(Scheduler.BytesGranted() == 1'000'000'000);
+}
+
+TEST_CASE("TBandwidthScheduler rate") {
+    // time only passes while the scheduler waits
+    TBandwidthScheduler::TClock::time_point Now {};
+    const auto Start = Now;
+    TBandwidthScheduler::TTimeSource Fake {
+        [&] { return Now; },
+        [&](std::unique_lock<std::mutex>&, std::condition_variable&, TBandwidthScheduler::TClock::duration Duration) { Now += Duration; },
+    };
+    TBandwidthScheduler Scheduler(1'000'000, Fake);
+    // the initial burst of 100 KB doesn't wait
+    CHECK(Scheduler.Acquire(100'000));
+    CHECK(Now == Start);
+    // after that, 1 MB takes a second
+    for (int i = 0; i < 10; ++i) {
+        CHECK(Scheduler.Acquire(100'000));
+    }
+    CHECK(Now - Start >= std::chrono::milliseconds(999));
+    CHECK(Now - Start <= std::chrono::milliseconds(1001));
+    CHECK(Scheduler.BytesGranted() == 1'100'000);
+    // a chunk larger than the bucket is granted, and the next one waits for the debt
+    const auto BeforeLarge = Now;
+    CHECK(Scheduler.Acquire(300'000));
+    CHECK(Scheduler.Acquire(1));
+    CHECK(Now - BeforeLarge >= std::chrono::milliseconds(299));
+    CHECK(Now - BeforeLarge <= std::chrono::milliseconds(301));
+}
+
+TEST_CASE("TBandwidthScheduler serves in order") {
+    // time only passes when the test says so, the scheduler just checks again every millisecond
+    std::atomic<TBandwidthScheduler::TClock::rep> Ticks { 0 };
+    TBandwidthScheduler::TTimeSource Manual {
+        [&] { return TBandwidthScheduler::TClock::time_point(TBandwidthScheduler::TClock::duration(Ticks.load())); },
+        [](std::unique_lock<std::mutex>& Lock, std::condition_variable& Condition, TBandwidthScheduler::TClock::duration) {
+            Condition.wait_for(Lock, std::chrono::milliseconds(1));
+        },
+    };
+    auto Advance = [&](std::chrono::milliseconds Duration) {
+        Ticks += std::chrono::duration_cast<TBandwidthScheduler::TClock::duration>(Duration).count();
+    };
+    auto WaitUntil = [](auto Condition) {
+        while (!Condition()) {
+            std::this_thread::yield();
+        }
+    };
+    // 1000 B/s, so the bucket holds 100 bytes
+    TBandwidthScheduler Scheduler(1000, Manual);
+    CHECK(Scheduler.Acquire(100));
+    std::atomic<bool> FirstDone { false };
+    std::atomic<bool> SecondDone { false };
+    std::thread First([&] { FirstDone = Scheduler.Acquire(100); });
+    WaitUntil([&] { return Scheduler.Waiting() == 1; });
+    std::thread Second([&] { SecondDone = Scheduler.Acquire(100); });
+    WaitUntil([&] { return Scheduler.Waiting() == 2; });
+
+    // enough for one of them, which has to be the one that asked first
+    Advance(std::chrono::milliseconds(100));
+    WaitUntil([&] { return FirstDone.load(); });
+    CHECK(Scheduler.Waiting() == 1);
+    CHECK(!SecondDone);
+    Advance(std::chrono::milliseconds(100));
+    WaitUntil([&] { return SecondDone.load(); });
+    First.join();
+    Second.join();
+
+    Scheduler.Shutdown();
+    CHECK(!Scheduler.Acquire(1));
+}
@@ -0,0 +1,114 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "TBufferPool.h"
+
+#include <algorithm>
+#include <bit>
+#include <doctest/doctest.h>
+
+static size_t ClassIndexOf(size_t ClassSize) {
+    return size_t(std::countr_zero(ClassSize / TBufferPool::MinClassSize));
+}
+
+TBufferPool::TBufferPool(size_t MaxBufferSize, size_t MaxPooledBytes)
+    : mMaxBufferSize(ClassSize(MaxBufferSize))
+    , mMaxPooledBytes(MaxPooledBytes)
+    , mClasses(ClassIndexOf(mMaxBufferSize) + 1) {
+}
+
+size_t TBufferPool::ClassSize(size_t Capacity) {
+    return std::bit_ceil(std::max(Capacity, MinClassSize));
+}
+
+std::vector<uint8_t> TBufferPool::Acquire(size_t Capacity) {
+    const auto Size = ClassSize(Capacity);
+    std::vector<uint8_t> Buffer;
+    if (Size <= mMaxBufferSize) {
+        std::unique_lock Lock(mMutex);
+        auto& Class = mClasses[ClassIndexOf(Size)];
+        if (!Class.empty()) {
+            Buffer = std::move(Class.back());
+            Class.pop_back();
+            mPooledBytes -= Buffer.capacity();
+            mHits.fetch_add(1, std::memory_order_relaxed);
+            return Buffer;
+        }
+    }
+    mMisses.fetch_add(1, std::memory_order_relaxed);
+    // the whole class, so it can go back into the same class later
+    Buffer.reserve(Size <= mMaxBufferSize ? Size : Capacity);
+    return Buffer;
+}
+
+void TBufferPool::Release(std::vector<uint8_t>&& Buffer) {
+    const auto Capacity = Buffer.capacity();
+    if (Capacity < MinClassSize || Capacity > mMaxBufferSize) {
+        return;
+    }
+    // the largest class it can serve
+    const auto Size = std::bit_floor(Capacity);
+    Buffer.clear();
+    std::unique_lock Lock(mMutex);
+    if (mPooledBytes + Capacity > mMaxPooledBytes) {
+        return;
+    }
+    mPooledBytes += Capacity;
+    mClasses[ClassIndexOf(Size)].push_back(std::move(Buffer));
+}
+
+size_t TBufferPool::PooledBytes() const {
+    std::unique_lock Lock(mMutex);
+    return mPooledBytes;
+}
+
+TEST_CASE("TBufferPool") {
+    TBufferPool Pool(64 * 1024, 100 * 1024);
+    CHECK(TBufferPool::ClassSize(1) == TBufferPool::MinClassSize);
+    CHECK(TBufferPool::ClassSize(1025) == 2048);
+
+    auto Buffer = Pool.Acquire(3000);
+    CHECK(Buffer.empty());
+    CHECK(Buffer.capacity() >= 4096);
+    CHECK(Pool.Misses() == 1);
+    const auto* Data = Buffer.data();
+    Buffer.resize(3000);
+    Pool.Release(std::move(Buffer));
+    CHECK(Pool.PooledBytes() >= 4096);
+
+    // smaller requests may get the same buffer, larger ones may not
+    CHECK(Pool.Acquire(8000).data() != Data);
+    auto Again = Pool.Acquire(4096);
+    CHECK(Again.data() == Data);
+    CHECK(Again.empty());
+    CHECK(Pool.Hits() == 1);
+    CHECK(Pool.PooledBytes() == 0);
+
+    // too large to pool, and more than the pool may hold
+    Pool.Release(std::vector<uint8_t>(128 * 1024));
+    CHECK(Pool.PooledBytes() == 0);
+    for (int i = 0; i < 3; ++i) {
+        auto Large = Pool.Acquire(64 * 1024);
+        Large.resize(1);
+        Pool.Release(std::move(Large));
+    }
+    Pool.Release(std::vector<uint8_t>(64 * 1024));
+    Pool.Release(std::vector<uint8_t>(64 * 1024));
+    CHECK(Pool.PooledBytes() <= 100 * 1024);
+}
@@ -58,8 +58,70 @@ static constexpr std::string_view StrLogChat = "LogChat";
 static constexpr std::string_view EnvStrLogChat = "BEAMMP_LOG_CHAT";
 static constexpr std::string_view StrAllowGuests = "AllowGuests";
 static constexpr std::string_view EnvStrAllowGuests = "BEAMMP_ALLOW_GUESTS";
+static constexpr std::string_view StrAuthProvider = "AuthProvider";
+static constexpr std::string_view EnvStrAuthProvider = "BEAMMP_AUTH_PROVIDER";
+static constexpr std::string_view StrAuthBackend = "AuthBackend";
+static constexpr std::string_view EnvStrAuthBackend = "BEAMMP_AUTH_BACKEND";
+static constexpr std::string_view StrAuthFile = "AuthFile";
+static constexpr std::string_view EnvStrAuthFile = "BEAMMP_AUTH_FILE";
 static constexpr std::string_view StrPassword = "Password";
 
+// Network
+static constexpr std::string_view StrAsyncIO = "AsyncIO";
+static constexpr std::string_view EnvStrAsyncIO = "BEAMMP_ASYNC_IO";
+static constexpr std::string_view StrIoThreads = "IoThreads";
+static constexpr std::string_view EnvStrIoThreads = "BEAMMP_IO_THREADS";
+static constexpr std::string_view StrUDPThreads = "UDPThreads";
+static constexpr std::string_view EnvStrUDPThreads = "BEAMMP_UDP_THREADS";
+static constexpr std::string_view StrInterestManagement = "InterestManagement";
+static constexpr std::string_view EnvStrInterestManagement = "BEAMMP_INTEREST_MANAGEMENT";
+static constexpr std::string_view StrInterestNearRadius = "InterestNearRadius";
+static constexpr std::string_view EnvStrInterestNearRadius = "BEAMMP_INTEREST_NEAR_RADIUS";
+static constexpr std::string_view StrInterestFarRadius = "InterestFarRadius";
+static constexpr std::string_view EnvStrInterestFarRadius = "BEAMMP_INTEREST_FAR_RADIUS";
+static constexpr std::string_view StrInterestMidInterval = "InterestMidInterval";
+static constexpr std::string_view EnvStrInterestMidInterval = "BEAMMP_INTEREST_MID_INTERVAL";
+static constexpr std::string_view StrInterestFarInterval = "InterestFarInterval";
+static constexpr std::string_view EnvStrInterestFarInterval = "BEAMMP_INTEREST_FAR_INTERVAL";
+static constexpr std::string_view StrPositionTickRate = "PositionTickRate";
+static constexpr std::string_view EnvStrPositionTickRate = "BEAMMP_POSITION_TICK_RATE";
+static constexpr std::string_view StrPositionDeltas = "PositionDeltas";
+static constexpr std::string_view EnvStrPositionDeltas = "BEAMMP_POSITION_DELTAS";
+static constexpr std::string_view StrMaxQueuedPackets = "MaxQueuedPackets";
+static constexpr std::string_view EnvStrMaxQueuedPackets = "BEAMMP_MAX_QUEUED_PACKETS";
+static constexpr std::string_view StrMaxQueuedMB = "MaxQueuedMB";
+static constexpr std::string_view EnvStrMaxQueuedMB = "BEAMMP_MAX_QUEUED_MB";
+static constexpr std::string_view StrAuthWorkers = "AuthWorkers";
+static constexpr std::string_view EnvStrAuthWorkers = "BEAMMP_AUTH_WORKERS";
+static constexpr std::string_view StrAuthCacheSeconds = "AuthCacheSeconds";
+static constexpr std::string_view EnvStrAuthCacheSeconds = "BEAMMP_AUTH_CACHE_SECONDS";
+static constexpr std::string_view StrHandshakeWorkers = "HandshakeWorkers";
+static constexpr std::string_view EnvStrHandshakeWorkers = "BEAMMP_HANDSHAKE_WORKERS";
+static constexpr std::string_view StrMaxPendingHandshakes = "MaxPendingHandshakes";
+static constexpr std::string_view EnvStrMaxPendingHandshakes = "BEAMMP_MAX_PENDING_HANDSHAKES";
+static constexpr std::string_view StrHandshakeTimeout = "HandshakeTimeout";
+static constexpr std::string_view EnvStrHandshakeTimeout = "BEAMMP_HANDSHAKE_TIMEOUT";
+static constexpr std::string_view StrUplinkKBps = "UplinkKBps";
+static constexpr std::string_view EnvStrUplinkKBps = "BEAMMP_UPLINK_KBPS";
+static constexpr std::string_view StrGameplayReserveKBps = "GameplayReserveKBps";
+static constexpr std::string_view EnvStrGameplayReserveKBps = "BEAMMP_GAMEPLAY_RESERVE_KBPS";
+static constexpr std::string_view StrDecompressionBudgetKBps = "DecompressionBudgetKBps";
+static constexpr std::string_view EnvStrDecompressionBudgetKBps = "BEAMMP_DECOMPRESSION_BUDGET_KBPS";
+static constexpr std::string_view StrCompressionDictionary = "CompressionDictionary";
+static constexpr std::string_view EnvStrCompressionDictionary = "BEAMMP_COMPRESSION_DICTIONARY";
+static constexpr std::string_view StrReceiveQuotaMB = "ReceiveQuotaMB";
+static constexpr std::string_view EnvStrReceiveQuotaMB = "BEAMMP_RECEIVE_QUOTA_MB";
+
+// HTTP
+static constexpr std::string_view StrHTTPEnabled = "Enabled";
+static constexpr std::string_view EnvStrHTTPEnabled = "BEAMMP_HTTP_ENABLED";
+static constexpr std::string_view StrHTTPIp = "Ip";
+static constexpr std::string_view EnvStrHTTPIp = "BEAMMP_HTTP_IP";
+static constexpr std::string_view StrHTTPPort = "Port";
+static constexpr std::string_view EnvStrHTTPPort = "BEAMMP_HTTP_PORT";
+static constexpr std::string_view StrHTTPModMirror = "ModMirror";
+static constexpr std::string_view EnvStrHTTPModMirror = "BEAMMP_HTTP_MOD_MIRROR";
+
 // Misc
 static constexpr std::string_view StrSendErrors = "SendErrors";
 static constexpr std::string_view StrSendErrorsMessageEnabled = "SendErrorsShowMessage";
@@ -89,6 +151,7 @@ TEST_CASE("TConfig::TConfig") {
     const auto table = toml::parse(CfgFile);
     CHECK(table.at("General").is_table());
     CHECK(table.at("Misc").is_table());
+    CHECK(table.at("Network").is_table());
 
     fs::remove(CfgFile);
 }
@@ -136,6 +199,12 @@ void TConfig::FlushToFile() {
     data["General"][StrPrivate.data()] = Application::Settings.getAsBool(Settings::Key::General_Private);
     data["General"][StrAllowGuests.data()] = Application::Settings.getAsBool(Settings::Key::General_AllowGuests);
     SetComment(data["General"][StrAllowGuests.data()].comments(), " Whether to allow guests");
+    data["General"][StrAuthProvider.data()] = Application::Settings.getAsString(Settings::Key::General_AuthProvider);
+    SetComment(data["General"][StrAuthProvider.data()].comments(), " How players are authenticated: \"backend\" (BeamMP accounts) or \"file\" (keys listed in AuthFile, e.g. for LAN events)");
+    data["General"][StrAuthBackend.data()] = Application::Settings.getAsString(Settings::Key::General_AuthBackend);
+    SetComment(data["General"][StrAuthBackend.data()].comments(), " host:port of the authentication backend, only change this for testing");
+    data["General"][StrAuthFile.data()] = Application::Settings.getAsString(Settings::Key::General_AuthFile);
+    SetComment(data["General"][StrAuthFile.data()].comments(), " json file mapping keys to players, used if AuthProvider is \"file\"");
     data["General"][StrIp.data()] = Application::Settings.getAsString(Settings::Key::General_Ip);
     data["General"][StrPort.data()] = Application::Settings.getAsInt(Settings::Key::General_Port);
     data["General"][StrName.data()] = Application::Settings.getAsString(Settings::Key::General_Name);
@@ -148,6 +217,60 @@ void TConfig::FlushToFile() {
     data["General"][StrResourceFolder.data()] = Application::Settings.getAsString(Settings::Key::General_ResourceFolder);
     // data["General"][StrPassword.data()] = Application::Settings.Password;
     // SetComment(data["General"][StrPassword.data()].comments(), " Sets a password on this server, which restricts people from joining. To join, a player must enter this exact password. Leave empty ("") to disable the password.");
+    // Network
+    data["Network"][StrAsyncIO.data()] = Application::Settings.getAsBool(Settings::Key::Network_AsyncIO);
+    SetComment(data["Network"][StrAsyncIO.data()].comments(), " Handles all player TCP connections asynchronously on a fixed pool of IO threads instead of using two threads per player. Recommended for servers with many players.");
+    data["Network"][StrIoThreads.data()] = Application::Settings.getAsInt(Settings::Key::Network_IoThreads);
+    SetComment(data["Network"][StrIoThreads.data()].comments(), " Number of IO threads used when AsyncIO is enabled. 0 means one thread per CPU core.");
+    data["Network"][StrUDPThreads.data()] = Application::Settings.getAsInt(Settings::Key::Network_UDPThreads);
+    SetComment(data["Network"][StrUDPThreads.data()].comments(), " Number of threads (and sockets) receiving vehicle data over UDP. Values above 1 spread players over multiple CPU cores, this only has an effect on Linux.");
+    data["Network"][StrInterestManagement.data()] = Application::Settings.getAsBool(Settings::Key::Network_InterestManagement);
+    SetComment(data["Network"][StrInterestManagement.data()].comments(), " Only sends position updates of far away vehicles at a reduced rate (or not at all), which saves a lot of bandwidth on servers with many players spread over the map.");
+    data["Network"][StrInterestNearRadius.data()] = Application::Settings.getAsInt(Settings::Key::Network_InterestNearRadius);
+    SetComment(data["Network"][StrInterestNearRadius.data()].comments(), " Distance in meters within which players receive every position update of a vehicle. Only used if InterestManagement is enabled.");
+    data["Network"][StrInterestFarRadius.data()] = Application::Settings.getAsInt(Settings::Key::Network_InterestFarRadius);
+    SetComment(data["Network"][StrInterestFarRadius.data()].comments(), " Distance in meters within which players receive every InterestMidInterval-th position update of a vehicle.");
+    data["Network"][StrInterestMidInterval.data()] = Application::Settings.getAsInt(Settings::Key::Network_InterestMidInterval);
+    SetComment(data["Network"][StrInterestMidInterval.data()].comments(), " Players between InterestNearRadius and InterestFarRadius away receive every n-th position update.");
+    data["Network"][StrInterestFarInterval.data()] = Application::Settings.getAsInt(Settings::Key::Network_InterestFarInterval);
+    SetComment(data["Network"][StrInterestFarInterval.data()].comments(), " Players further than InterestFarRadius away receive every n-th position update. 0 means they receive none.");
+    data["Network"][StrPositionTickRate.data()] = Application::Settings.getAsInt(Settings::Key::Network_PositionTickRate);
+    SetComment(data["Network"][StrPositionTickRate.data()].comments(), " If above 0, vehicle positions are sent out this many times per second, and only the latest position of each vehicle is sent. Clients which support it get all positions of a tick batched into few datagrams. 0 sends every position as soon as it arrives.");
+    data["Network"][StrPositionDeltas.data()] = Application::Settings.getAsBool(Settings::Key::Network_PositionDeltas);
+    SetComment(data["Network"][StrPositionDeltas.data()].comments(), " Send vehicle positions as compact deltas to clients which support it. Other clients are not affected.");
+    data["Network"][StrMaxQueuedPackets.data()] = Application::Settings.getAsInt(Settings::Key::Network_MaxQueuedPackets);
+    SetComment(data["Network"][StrMaxQueuedPackets.data()].comments(), " Maximum number of packets waiting to be sent to a single player. Players who fall further behind are disconnected.");
+    data["Network"][StrMaxQueuedMB.data()] = Application::Settings.getAsInt(Settings::Key::Network_MaxQueuedMB);
+    SetComment(data["Network"][StrMaxQueuedMB.data()].comments(), " Maximum size (in MB) of the packets waiting to be sent to a single player. Players who fall further behind are disconnected.");
+    data["Network"][StrAuthWorkers.data()] = Application::Settings.getAsInt(Settings::Key::Network_AuthWorkers);
+    SetComment(data["Network"][StrAuthWorkers.data()].comments(), " Maximum number of players which are authenticated at the same time.");
+    data["Network"][StrAuthCacheSeconds.data()] = Application::Settings.getAsInt(Settings::Key::Network_AuthCacheSeconds);
+    SetComment(data["Network"][StrAuthCacheSeconds.data()].comments(), " How long (in seconds) a successful authentication is remembered, so reconnecting players don't need to be authenticated again. 0 disables this.");
+    data["Network"][StrHandshakeWorkers.data()] = Application::Settings.getAsInt(Settings::Key::Network_HandshakeWorkers);
+    SetComment(data["Network"][StrHandshakeWorkers.data()].comments(), " Number of threads which handle the handshakes of new connections (version check, authentication, download requests).");
+    data["Network"][StrMaxPendingHandshakes.data()] = Application::Settings.getAsInt(Settings::Key::Network_MaxPendingHandshakes);
+    SetComment(data["Network"][StrMaxPendingHandshakes.data()].comments(), " Maximum number of new connections which are waiting for or in a handshake. Further connections are closed right away.");
+    data["Network"][StrHandshakeTimeout.data()] = Application::Settings.getAsInt(Settings::Key::Network_HandshakeTimeout);
+    SetComment(data["Network"][StrHandshakeTimeout.data()].comments(), " Time (in seconds) a new connection has for each step of the handshake, before it is closed.");
+    data["Network"][StrUplinkKBps.data()] = Application::Settings.getAsInt(Settings::Key::Network_UplinkKBps);
+    SetComment(data["Network"][StrUplinkKBps.data()].comments(), " Upload bandwidth (in KB/s) the server may use. Mod downloads are limited to this minus GameplayReserveKBps, shared fairly between all downloading players. 0 means unlimited.");
+    data["Network"][StrGameplayReserveKBps.data()] = Application::Settings.getAsInt(Settings::Key::Network_GameplayReserveKBps);
+    SetComment(data["Network"][StrGameplayReserveKBps.data()].comments(), " Part of UplinkKBps (in KB/s) which mod downloads never use, so that players who are already playing aren't slowed down by joining players.");
+    data["Network"][StrDecompressionBudgetKBps.data()] = Application::Settings.getAsInt(Settings::Key::Network_DecompressionBudgetKBps);
+    SetComment(data["Network"][StrDecompressionBudgetKBps.data()].comments(), " How much decompressed data (KB/s) a client may send on average. A single packet may still be up to 30 MB. 0 = unlimited.");
+    data["Network"][StrCompressionDictionary.data()] = Application::Settings.getAsString(Settings::Key::Network_CompressionDictionary);
+    SetComment(data["Network"][StrCompressionDictionary.data()].comments(), " Path to a zlib dictionary for vehicle packets, made with BeamMP-Server-train-dictionary. It is only used for clients which have the same dictionary. Empty = none.");
+    data["Network"][StrReceiveQuotaMB.data()] = Application::Settings.getAsInt(Settings::Key::Network_ReceiveQuotaMB);
+    SetComment(data["Network"][StrReceiveQuotaMB.data()].comments(), " Largest packet (in MB) a client may send. Memory for a packet is only used as its data arrives.");
+    // HTTP
+    data["HTTP"][StrHTTPEnabled.data()] = Application::Settings.getAsBool(Settings::Key::HTTP_Enabled);
+    SetComment(data["HTTP"][StrHTTPEnabled.data()].comments(), " Enables the built-in HTTP server.");
+    data["HTTP"][StrHTTPIp.data()] = Application::Settings.getAsString(Settings::Key::HTTP_Ip);
+    SetComment(data["HTTP"][StrHTTPIp.data()].comments(), " IP address the HTTP server listens on.");
+    data["HTTP"][StrHTTPPort.data()] = Application::Settings.getAsInt(Settings::Key::HTTP_Port);
+    SetComment(data["HTTP"][StrHTTPPort.data()].comments(), " Port the HTTP server listens on.");
+    data["HTTP"][StrHTTPModMirror.data()] = Application::Settings.getAsBool(Settings::Key::HTTP_ModMirror);
+    SetComment(data["HTTP"][StrHTTPModMirror.data()].comments(), " Serves the client mods under /mods/<name>, with support for range requests and ETags, so they can be downloaded over HTTP (e.g. through a caching proxy). /mods lists them.");
     // Misc
     data["Misc"][StrHideUpdateMessages.data()] = Application::Settings.getAsBool(Settings::Key::Misc_ImScaredOfUpdates);
     SetComment(data["Misc"][StrHideUpdateMessages.data()].comments(), " Hides the periodic update message which notifies you of a new server version. You should really keep this on and always update as soon as possible. For more information visit https://wiki.beammp.com/en/home/server-maintenance#updating-the-server. An update message will always appear at startup regardless.");
@@ -263,6 +386,37 @@ void TConfig::ParseFromFile(std::string_view name) {
         TryReadValue(data, "General", StrAuthKey, EnvStrAuthKey, Settings::Key::General_AuthKey);
         TryReadValue(data, "General", StrLogChat, EnvStrLogChat, Settings::Key::General_LogChat);
         TryReadValue(data, "General", StrAllowGuests, EnvStrAllowGuests, Settings::Key::General_AllowGuests);
+        TryReadValue(data, "General", StrAuthProvider, EnvStrAuthProvider, Settings::Key::General_AuthProvider);
+        TryReadValue(data, "General", StrAuthBackend, EnvStrAuthBackend, Settings::Key::General_AuthBackend);
+        TryReadValue(data, "General", StrAuthFile, EnvStrAuthFile, Settings::Key::General_AuthFile);
+        // Network
+        TryReadValue(data, "Network", StrAsyncIO, EnvStrAsyncIO, Settings::Key::Network_AsyncIO);
+        TryReadValue(data, "Network", StrIoThreads, EnvStrIoThreads, Settings::Key::Network_IoThreads);
+        TryReadValue(data, "Network", StrUDPThreads, EnvStrUDPThreads, Settings::Key::Network_UDPThreads);
+        TryReadValue(data, "Network", StrInterestManagement, EnvStrInterestManagement, Settings::Key::Network_InterestManagement);
+        TryReadValue(data, "Network", StrInterestNearRadius, EnvStrInterestNearRadius, Settings::Key::Network_InterestNearRadius);
+        TryReadValue(data, "Network", StrInterestFarRadius, EnvStrInterestFarRadius, Settings::Key::Network_InterestFarRadius);
+        TryReadValue(data, "Network", StrInterestMidInterval, EnvStrInterestMidInterval, Settings::Key::Network_InterestMidInterval);
+        TryReadValue(data, "Network", StrInterestFarInterval, EnvStrInterestFarInterval, Settings::Key::Network_InterestFarInterval);
+        TryReadValue(data, "Network", StrPositionTickRate, EnvStrPositionTickRate, Settings::Key::Network_PositionTickRate);
+        TryReadValue(data, "Network", StrPositionDeltas, EnvStrPositionDeltas, Settings::Key::Network_PositionDeltas);
+        TryReadValue(data, "Network", StrMaxQueuedPackets, EnvStrMaxQueuedPackets, Settings::Key::Network_MaxQueuedPackets);
+        TryReadValue(data, "Network", StrMaxQueuedMB, EnvStrMaxQueuedMB, Settings::Key::Network_MaxQueuedMB);
+        TryReadValue(data, "Network", StrAuthWorkers, EnvStrAuthWorkers, Settings::Key::Network_AuthWorkers);
+        TryReadValue(data, "Network", StrAuthCacheSeconds, EnvStrAuthCacheSeconds, Settings::Key::Network_AuthCacheSeconds);
+        TryReadValue(data, "Network", StrHandshakeWorkers, EnvStrHandshakeWorkers, Settings::Key::Network_HandshakeWorkers);
+        TryReadValue(data, "Network", StrMaxPendingHandshakes, EnvStrMaxPendingHandshakes, Settings::Key::Network_MaxPendingHandshakes);
+        TryReadValue(data, "Network", StrHandshakeTimeout, EnvStrHandshakeTimeout, Settings::Key::Network_HandshakeTimeout);
+        TryReadValue(data, "Network", StrUplinkKBps, EnvStrUplinkKBps, Settings::Key::Network_UplinkKBps);
+        TryReadValue(data, "Network", StrGameplayReserveKBps, EnvStrGameplayReserveKBps, Settings::Key::Network_GameplayReserveKBps);
+        TryReadValue(data, "Network", StrDecompressionBudgetKBps, EnvStrDecompressionBudgetKBps, Settings::Key::Network_DecompressionBudgetKBps);
+        TryReadValue(data, "Network", StrCompressionDictionary, EnvStrCompressionDictionary, Settings::Key::Network_CompressionDictionary);
+        TryReadValue(data, "Network", StrReceiveQuotaMB, EnvStrReceiveQuotaMB, Settings::Key::Network_ReceiveQuotaMB);
+        // HTTP
+        TryReadValue(data, "HTTP", StrHTTPEnabled, EnvStrHTTPEnabled, Settings::Key::HTTP_Enabled);
+        TryReadValue(data, "HTTP", StrHTTPIp, EnvStrHTTPIp, Settings::Key::HTTP_Ip);
+        TryReadValue(data, "HTTP", StrHTTPPort, EnvStrHTTPPort, Settings::Key::HTTP_Port);
+        TryReadValue(data, "HTTP", StrHTTPModMirror, EnvStrHTTPModMirror, Settings::Key::HTTP_ModMirror);
         // Misc
         TryReadValue(data, "Misc", StrSendErrors, "", Settings::Key::Misc_SendErrors);
         TryReadValue(data, "Misc", StrHideUpdateMessages, "", Settings::Key::Misc_ImScaredOfUpdates);
@@ -314,6 +468,35 @@ void TConfig::PrintDebug() {
     beammp_debug(std::string(StrLogChat) + ": \"" + (Application::Settings.getAsBool(Settings::Key::General_LogChat) ? "true" : "false") + "\"");
     beammp_debug(std::string(StrResourceFolder) + ": \"" + Application::Settings.getAsString(Settings::Key::General_ResourceFolder) + "\"");
     beammp_debug(std::string(StrAllowGuests) + ": \"" + (Application::Settings.getAsBool(Settings::Key::General_AllowGuests) ? "true" : "false") + "\"");
+    beammp_debug(std::string(StrAuthProvider) + ": \"" + Application::Settings.getAsString(Settings::Key::General_AuthProvider) + "\"");
+    beammp_debug(std::string(StrAuthBackend) + ": \"" + Application::Settings.getAsString(Settings::Key::General_AuthBackend) + "\"");
+    beammp_debug(std::string(StrAuthFile) + ": \"" + Application::Settings.getAsString(Settings::Key::General_AuthFile) + "\"");
+    beammp_debug(std::string(StrAsyncIO) + ": " + std::string(Application::Settings.getAsBool(Settings::Key::Network_AsyncIO) ? "true" : "false"));
+    beammp_debug(std::string(StrIoThreads) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_IoThreads)));
+    beammp_debug(std::string(StrUDPThreads) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_UDPThreads)));
+    beammp_debug(std::string(StrInterestManagement) + ": " + std::string(Application::Settings.getAsBool(Settings::Key::Network_InterestManagement) ? "true" : "false"));
+    beammp_debug(std::string(StrInterestNearRadius) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_InterestNearRadius)));
+    beammp_debug(std::string(StrInterestFarRadius) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_InterestFarRadius)));
+    beammp_debug(std::string(StrInterestMidInterval) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_InterestMidInterval)));
+    beammp_debug(std::string(StrInterestFarInterval) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_InterestFarInterval)));
+    beammp_debug(std::string(StrPositionTickRate) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_PositionTickRate)));
+    beammp_debug(std::string(StrPositionDeltas) + ": " + std::string(Application::Settings.getAsBool(Settings::Key::Network_PositionDeltas) ? "true" : "false"));
+    beammp_debug(std::string(StrMaxQueuedPackets) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_MaxQueuedPackets)));
+    beammp_debug(std::string(StrMaxQueuedMB) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_MaxQueuedMB)));
+    beammp_debug(std::string(StrAuthWorkers) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_AuthWorkers)));
+    beammp_debug(std::string(StrAuthCacheSeconds) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_AuthCacheSeconds)));
+    beammp_debug(std::string(StrHandshakeWorkers) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_HandshakeWorkers)));
+    beammp_debug(std::string(StrMaxPendingHandshakes) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_MaxPendingHandshakes)));
+    beammp_debug(std::string(StrHandshakeTimeout) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_HandshakeTimeout)));
+    beammp_debug(std::string(StrUplinkKBps) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_UplinkKBps)));
+    beammp_debug(std::string(StrGameplayReserveKBps) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_GameplayReserveKBps)));
+    beammp_debug(std::string(StrDecompressionBudgetKBps) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_DecompressionBudgetKBps)));
+    beammp_debug(std::string(StrCompressionDictionary) + ": " + Application::Settings.getAsString(Settings::Key::Network_CompressionDictionary));
+    beammp_debug(std::string(StrReceiveQuotaMB) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::Network_ReceiveQuotaMB)));
+    beammp_debug(std::string(StrHTTPEnabled) + ": " + std::string(Application::Settings.getAsBool(Settings::Key::HTTP_Enabled) ? "true" : "false"));
+    beammp_debug(std::string(StrHTTPIp) + ": " + Application::Settings.getAsString(Settings::Key::HTTP_Ip));
+    beammp_debug(std::string(StrHTTPPort) + ": " + std::to_string(Application::Settings.getAsInt(Settings::Key::HTTP_Port)));
+    beammp_debug(std::string(StrHTTPModMirror) + ": " + std::string(Application::Settings.getAsBool(Settings::Key::HTTP_ModMirror) ? "true" : "false"));
     // special!
     beammp_debug("Key Length: " + std::to_string(Application::Settings.getAsString(Settings::Key::General_AuthKey).length()) + "");
 }
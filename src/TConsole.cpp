@@ -511,13 +511,17 @@ void TConsole::Command_List(const std::string&, const std::vector<std::string>&
         Application::Console().WriteRaw("No players online.");
     } else {
         std::stringstream ss;
-        ss << std::left << std::setw(25) << "Name" << std::setw(6) << "ID" << std::setw(6) << "Cars" << std::endl;
+        ss << std::left << std::setw(25) << "Name" << std::setw(6) << "ID" << std::setw(6) << "Cars"
+           << std::setw(10) << "Queued" << std::setw(12) << "Queued KB" << std::setw(10) << "Dropped" << std::endl;
         mLuaEngine->Server().ForEachClient([&](std::weak_ptr<TClient> Client) -> bool {
             if (!Client.expired()) {
                 auto locked = Client.lock();
                 ss << std::left << std::setw(25) << locked->GetName()
                    << std::setw(6) << locked->GetID()
-                   << std::setw(6) << locked->GetCarCount() << "\n";
+                   << std::setw(6) << locked->GetCarCount()
+                   << std::setw(10) << locked->MissedPacketQueueSize()
+                   << std::setw(12) << locked->MissedPacketQueueBytes() / 1024
+                   << std::setw(10) << locked->SupersededPackets() << "\n";
             }
             return true;
         });
@@ -538,6 +542,7 @@ void TConsole::Command_Status(const std::string&, const std::vector<std::string>
     size_t SyncedCount = 0;
     size_t SyncingCount = 0;
     size_t MissedPacketQueueSum = 0;
+    uint64_t SupersededSum = 0;
     int LargestSecondsSinceLastPing = 0;
     mLuaEngine->Server().ForEachClient([&](std::weak_ptr<TClient> Client) -> bool {
         if (!Client.expired()) {
@@ -548,6 +553,7 @@ void TConsole::Command_Status(const std::string&, const std::vector<std::string>
             SyncedCount += Locked->IsSynced() ? 1 : 0;
             SyncingCount += Locked->IsSyncing() ? 1 : 0;
             MissedPacketQueueSum += Locked->MissedPacketQueueSize();
+            SupersededSum += Locked->SupersededPackets();
             if (Locked->SecondsSinceLastPing() < LargestSecondsSinceLastPing) {
                 LargestSecondsSinceLastPing = Locked->SecondsSinceLastPing();
             }
@@ -600,6 +606,13 @@ void TConsole::Command_Status(const std::string&, const std::vector<std::string>
     SystemsShutdownList = SystemsShutdownList.substr(0, SystemsShutdownList.size() - 2);
 
     auto ElapsedTime = mLuaEngine->Server().UptimeTimer.GetElapsedTime();
+    const auto& NetStats = mLuaEngine->Network().Stats();
+    const auto FramesSent = NetStats.TCPFramesSent.load();
+    const auto Writes = NetStats.TCPWrites.load();
+    const auto FramesReceived = NetStats.TCPFramesReceived.load();
+    const auto Reads = NetStats.TCPReads.load();
+    const auto& Handshakes = mLuaEngine->Network().Handshakes();
+    auto& DownloadBandwidth = mLuaEngine->Network().DownloadBandwidth();
 
     Status << "BeamMP-Server Status:\n"
            << "\tTotal Players:             " << mLuaEngine->Server().ClientCount() << "\n"
@@ -609,6 +622,30 @@ void TConsole::Command_Status(const std::string&, const std::vector<std::string>
            << "\tGuests:                    " << GuestCount << "\n"
            << "\tCars:                      " << CarCount << "\n"
            << "\tUptime:                    " << ElapsedTime << "ms (~" << size_t(double(ElapsedTime) / 1000.0 / 60.0 / 60.0) << "h) \n"
+           << "\tNetwork:\n"
+           << "\t\tPending handshakes:          " << Handshakes.Pending() << " (" << Handshakes.Rejected() << " rejected, " << Handshakes.TimedOut() << " timed out)\n"
+           << "\t\tQueued packets:              " << MissedPacketQueueSum << "\n"
+           << "\t\tSuperseded queued packets:   " << SupersededSum << "\n"
+           << "\t\tTCP frames sent:             " << FramesSent << "\n"
+           << "\t\tTCP writes:                  " << Writes << " (" << (FramesSent - std::min(FramesSent, Writes)) << " saved by batching)\n"
+           << "\t\tTCP frames received:         " << FramesReceived << "\n"
+           << "\t\tTCP reads:                   " << Reads << " (" << (FramesReceived - std::min(FramesReceived, Reads)) << " saved by read-ahead)\n"
+           << "\t\tTCP bytes not copied:        " << NetStats.TCPCopyBytesSaved.load() << "\n"
+           << "\t\tRejected UDP packets:        " << NetStats.UDPRejected.load() << "\n"
+           << "\t\tTruncated UDP packets:       " << NetStats.UDPTruncated.load() << "\n"
+           << "\t\tFiltered position updates:   " << NetStats.InterestFiltered.load() << "\n"
+           << "\t\tPosition ticks:              " << NetStats.PositionTicks.load() << "\n"
+           << "\t\tSuperseded positions:        " << NetStats.PositionsSuperseded.load() << "\n"
+           << "\t\tDelta encoded positions:     " << NetStats.PositionDeltasSent.load() << " (" << NetStats.PositionDeltaBytesSaved.load() << " bytes saved)\n"
+           << "\t\tBatched positions:           " << NetStats.PositionDatagramsSaved.load() << " datagrams saved\n"
+           << "\t\tMod download bytes:          " << NetStats.DownloadBytes.load() << " (" << NetStats.DownloadBytesZeroCopy.load() << " zero-copy)\n"
+           << "\t\tResumed mod downloads:       " << NetStats.DownloadsResumed.load() << " (" << NetStats.DownloadBytesSkipped.load() << " bytes not sent again)\n"
+           << "\t\tMod download rate:           " << DownloadBandwidth.CurrentRate() / 1024 << " KB/s (limit: " << (DownloadBandwidth.IsLimited() ? std::to_string(DownloadBandwidth.Rate() / 1024) + " KB/s" : std::string("none")) << ")\n"
+           << "\t\tMod download queue:          " << DownloadBandwidth.Waiting() << " waiting (" << DownloadBandwidth.TimeWaited().count() << "ms waited in total)\n"
+           << "\t\tOpen mod files:              " << mLuaEngine->Network().ResourceManager().OpenModCount() << "\n"
+           << "\t\tBroadcasts:                  " << NetStats.Broadcasts.load() << " (" << NetStats.BroadcastCompressions.load() << " compressed)\n"
+           << "\t\tAllocations per broadcast:   " << (NetStats.Broadcasts.load() == 0 ? 0.0 : double(NetStats.BroadcastAllocations.load()) / double(NetStats.Broadcasts.load())) << "\n"
+           << "\t\tPacket buffer pool:          " << Compression::BufferPool().Hits() << " reused, " << Compression::BufferPool().Misses() << " allocated (" << Compression::BufferPool().PooledBytes() / 1024 << " KB pooled)\n"
            << "\tLua:\n"
            << "\t\tQueued results to check:     " << mLuaEngine->GetResultsToCheckSize() << "\n"
            << "\t\tStates:                      " << mLuaEngine->GetLuaStateCount() << "\n"
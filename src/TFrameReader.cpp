@@ -0,0 +1,171 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "TFrameReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <doctest/doctest.h>
+
+// an idle reader keeps at most this much memory
+static constexpr size_t IdleCapacity = 4 * TFrameReader::MinReadSize;
+
+TFrameReader::TFrameReader(TBufferPool& Pool, size_t Quota)
+    : mPool(Pool)
+    , mQuota(Quota) {
+}
+
+TFrameReader::~TFrameReader() {
+    mPool.Release(std::move(mBuffer));
+}
+
+std::span<uint8_t> TFrameReader::WritableSpace() {
+    size_t Wanted = Buffered() + MinReadSize;
+    if (Buffered() >= HeaderSize) {
+        int32_t Size {};
+        std::memcpy(&Size, mBuffer.data() + mBegin, sizeof(Size));
+        const size_t FrameSize = HeaderSize + size_t(std::max(0, Size));
+        // at most twice of what has arrived so far, so memory is only used for data which was sent
+        Wanted = std::max(Wanted, std::min(FrameSize, Buffered() * 2));
+    }
+    Reserve(std::min(Wanted, HeaderSize + mQuota));
+    return { mBuffer.data() + mEnd, mBuffer.size() - mEnd };
+}
+
+void TFrameReader::Commit(size_t Bytes) {
+    mEnd += std::min(Bytes, mBuffer.size() - mEnd);
+}
+
+TFrameReader::TStatus TFrameReader::Next(std::vector<uint8_t>& Packet) {
+    if (Buffered() < HeaderSize) {
+        return TStatus::NeedMore;
+    }
+    int32_t Size {};
+    std::memcpy(&Size, mBuffer.data() + mBegin, sizeof(Size));
+    if (Size < 0) {
+        return TStatus::NegativeSize;
+    }
+    if (size_t(Size) > mQuota) {
+        return TStatus::TooLarge;
+    }
+    if (Buffered() < HeaderSize + size_t(Size)) {
+        return TStatus::NeedMore;
+    }
+    const auto* Data = mBuffer.data() + mBegin + HeaderSize;
+    Packet = mPool.Acquire(size_t(Size));
+    Packet.assign(Data, Data + Size);
+    mBegin += HeaderSize + size_t(Size);
+    if (mBegin == mEnd) {
+        mBegin = 0;
+        mEnd = 0;
+        // don't hold on to the memory of a large packet
+        if (mBuffer.size() > IdleCapacity) {
+            mPool.Release(std::move(mBuffer));
+            mBuffer = {};
+        }
+    }
+    return TStatus::Packet;
+}
+
+void TFrameReader::Reserve(size_t Size) {
+    if (mBegin + Size <= mBuffer.size()) {
+        return;
+    }
+    if (Size <= mBuffer.size()) {
+        // enough space, but not after mBegin
+        std::memmove(mBuffer.data(), mBuffer.data() + mBegin, Buffered());
+    } else {
+        auto Larger = mPool.Acquire(Size);
+        Larger.resize(std::min(Larger.capacity(), std::max(Size, HeaderSize + mQuota)));
+        std::copy(mBuffer.begin() + ptrdiff_t(mBegin), mBuffer.begin() + ptrdiff_t(mEnd), Larger.begin());
+        mPool.Release(std::move(mBuffer));
+        mBuffer = std::move(Larger);
+    }
+    mEnd = Buffered();
+    mBegin = 0;
+}
+
+static void Feed(TFrameReader& Reader, std::span<const uint8_t> Data) {
+    while (!Data.empty()) {
+        auto Space = Reader.WritableSpace();
+        const auto N = std::min(Space.size(), Data.size());
+        std::memcpy(Space.data(), Data.data(), N);
+        Reader.Commit(N);
+        Data = Data.subspan(N);
+    }
+}
+
+static std::vector<uint8_t> Frame(std::string_view Payload, int32_t Size) {
+    std::vector<uint8_t> Result(sizeof(Size));
+    std::memcpy(Result.data(), &Size, sizeof(Size));
+    Result.insert(Result.end(), Payload.begin(), Payload.end());
+    return Result;
+}
+
+static std::vector<uint8_t> Frame(std::string_view Payload) {
+    return Frame(Payload, int32_t(Payload.size()));
+}
+
+TEST_CASE("TFrameReader") {
+    TBufferPool Pool(1024 * 1024, 1024 * 1024);
+    std::vector<uint8_t> Packet;
+
+    SUBCASE("several packets from one read") {
+        TFrameReader Reader(Pool, 100 * 1024);
+        CHECK(Reader.Next(Packet) == TFrameReader::TStatus::NeedMore);
+        auto Data = Frame("Zp:hello");
+        auto Second = Frame("p");
+        Data.insert(Data.end(), Second.begin(), Second.end());
+        Feed(Reader, Data);
+        REQUIRE(Reader.Next(Packet) == TFrameReader::TStatus::Packet);
+        CHECK(std::string(Packet.begin(), Packet.end()) == "Zp:hello");
+        REQUIRE(Reader.Next(Packet) == TFrameReader::TStatus::Packet);
+        CHECK(std::string(Packet.begin(), Packet.end()) == "p");
+        CHECK(Reader.Next(Packet) == TFrameReader::TStatus::NeedMore);
+        CHECK(Reader.Buffered() == 0);
+    }
+    SUBCASE("a packet split over several reads") {
+        TFrameReader Reader(Pool, 100 * 1024);
+        const std::string Payload(50 * 1024, 'x');
+        const auto Data = Frame(Payload);
+        for (size_t i = 0; i < Data.size(); i += 1000) {
+            CHECK(Reader.Next(Packet) == TFrameReader::TStatus::NeedMore);
+            Feed(Reader, std::span(Data).subspan(i, std::min<size_t>(1000, Data.size() - i)));
+        }
+        REQUIRE(Reader.Next(Packet) == TFrameReader::TStatus::Packet);
+        CHECK(Packet.size() == Payload.size());
+        // the large buffer went back to the pool
+        CHECK(Reader.Capacity() == 0);
+    }
+    SUBCASE("a large claim doesn't allocate") {
+        TFrameReader Reader(Pool, 100 * 1024);
+        Feed(Reader, Frame("abc", 90 * 1024));
+        CHECK(Reader.Next(Packet) == TFrameReader::TStatus::NeedMore);
+        CHECK(Reader.WritableSpace().size() < 64 * 1024);
+        CHECK(Reader.Capacity() < 64 * 1024);
+    }
+    SUBCASE("invalid sizes") {
+        TFrameReader Reader(Pool, 100 * 1024);
+        Feed(Reader, Frame("abc", -1));
+        CHECK(Reader.Next(Packet) == TFrameReader::TStatus::NegativeSize);
+        TFrameReader Other(Pool, 100 * 1024);
+        Feed(Other, Frame("abc", 100 * 1024 + 1));
+        CHECK(Other.Next(Packet) == TFrameReader::TStatus::TooLarge);
+    }
+}
@@ -0,0 +1,249 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "THandshakeExecutor.h"
+
+#include "Common.h"
+
+#include <doctest/doctest.h>
+#include <future>
+
+THandshakeExecutor::TDeadline::TDeadline(TDeadline&& Other) noexcept
+    : mExecutor(std::exchange(Other.mExecutor, nullptr))
+    , mKey(Other.mKey)
+    , mExpired(std::move(Other.mExpired)) {
+}
+
+THandshakeExecutor::TDeadline& THandshakeExecutor::TDeadline::operator=(TDeadline&& Other) noexcept {
+    if (this != &Other) {
+        Disarm();
+        mExecutor = std::exchange(Other.mExecutor, nullptr);
+        mKey = Other.mKey;
+        mExpired = std::move(Other.mExpired);
+    }
+    return *this;
+}
+
+THandshakeExecutor::TDeadline::~TDeadline() {
+    Disarm();
+}
+
+void THandshakeExecutor::TDeadline::Disarm() {
+    if (mExecutor) {
+        mExecutor->Disarm(mKey);
+        mExecutor = nullptr;
+    }
+}
+
+THandshakeExecutor::THandshakeExecutor(size_t Workers, size_t MaxPending)
+    : mMaxPending(std::max<size_t>(1, MaxPending)) {
+    for (size_t i = 0; i < std::max<size_t>(1, Workers); ++i) {
+        mWorkers.emplace_back([this, i] {
+            const auto Name = "Handshake" + std::to_string(i);
+            RegisterThread(Name);
+            WorkerMain(Name);
+        });
+    }
+    mWatchdog = std::thread([this] {
+        RegisterThread("HandshakeWatchdog");
+        WatchdogMain();
+    });
+}
+
+THandshakeExecutor::~THandshakeExecutor() {
+    Shutdown();
+}
+
+bool THandshakeExecutor::Submit(std::function<void()> Task) {
+    return Enqueue(std::move(Task), true);
+}
+
+bool THandshakeExecutor::Resume(std::function<void()> Task) {
+    return Enqueue(std::move(Task), false);
+}
+
+bool THandshakeExecutor::Enqueue(std::function<void()> Task, bool Limited) {
+    std::unique_lock Lock(mMutex);
+    if (mShutdown || (Limited && mPending.load() >= mMaxPending)) {
+        mRejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    mPending.fetch_add(1);
+    mTasks.push_back(std::move(Task));
+    mTasksChanged.notify_one();
+    return true;
+}
+
+THandshakeExecutor::TDeadline THandshakeExecutor::Arm(TClock::duration Timeout, std::function<void()> OnExpired) {
+    TDeadline Deadline;
+    Deadline.mExpired = std::make_shared<std::atomic<bool>>(false);
+    std::unique_lock Lock(mMutex);
+    if (mShutdown) {
+        // don't let the step start at all
+        Deadline.mExpired->store(true);
+        Lock.unlock();
+        OnExpired();
+        return Deadline;
+    }
+    Deadline.mKey = { TClock::now() + Timeout, mNextTimerId++ };
+    Deadline.mExecutor = this;
+    const bool IsEarliest = mTimers.empty() || Deadline.mKey < mTimers.begin()->first;
+    mTimers.emplace(Deadline.mKey, TTimer { std::move(OnExpired), Deadline.mExpired });
+    if (IsEarliest) {
+        mTimersChanged.notify_one();
+    }
+    return Deadline;
+}
+
+void THandshakeExecutor::Disarm(const TTimerKey& Key) {
+    // the watchdog runs callbacks with the lock held, so this also waits for a running one
+    std::unique_lock Lock(mMutex);
+    mTimers.erase(Key);
+}
+
+void THandshakeExecutor::WorkerMain(const std::string& Name) {
+    while (true) {
+        std::function<void()> Task;
+        {
+            std::unique_lock Lock(mMutex);
+            mTasksChanged.wait(Lock, [this] { return mShutdown || !mTasks.empty(); });
+            if (mShutdown) {
+                return;
+            }
+            Task = std::move(mTasks.front());
+            mTasks.pop_front();
+        }
+        try {
+            Task();
+        } catch (const std::exception& e) {
+            beammp_errorf("Exception during handshake: {}", e.what());
+        }
+        // tasks may rename the thread, e.g. when a client's session starts on it
+        RegisterThread(Name);
+        Task = nullptr;
+        mPending.fetch_sub(1);
+    }
+}
+
+void THandshakeExecutor::WatchdogMain() {
+    std::unique_lock Lock(mMutex);
+    while (!mShutdown) {
+        if (mTimers.empty()) {
+            mTimersChanged.wait(Lock);
+            continue;
+        }
+        const auto Next = mTimers.begin()->first.first;
+        if (TClock::now() < Next) {
+            mTimersChanged.wait_until(Lock, Next);
+            continue;
+        }
+        auto Timer = std::move(mTimers.begin()->second);
+        mTimers.erase(mTimers.begin());
+        Timer.Expired->store(true);
+        mTimedOut.fetch_add(1, std::memory_order_relaxed);
+        try {
+            Timer.OnExpired();
+        } catch (const std::exception& e) {
+            beammp_errorf("Exception in handshake deadline: {}", e.what());
+        }
+    }
+}
+
+void THandshakeExecutor::Shutdown() {
+    std::deque<std::function<void()>> Dropped;
+    {
+        std::unique_lock Lock(mMutex);
+        if (mShutdown) {
+            return;
+        }
+        mShutdown = true;
+        Dropped.swap(mTasks);
+        // cut every step short which is still running, so the workers can be joined quickly
+        for (auto& [Key, Timer] : mTimers) {
+            Timer.Expired->store(true);
+            Timer.OnExpired();
+        }
+        mTimers.clear();
+    }
+    mPending.fetch_sub(Dropped.size());
+    // destroying the tasks closes their connections
+    Dropped.clear();
+    mTasksChanged.notify_all();
+    mTimersChanged.notify_all();
+    for (auto& Worker : mWorkers) {
+        if (Worker.joinable()) {
+            Worker.join();
+        }
+    }
+    if (mWatchdog.joinable()) {
+        mWatchdog.join();
+    }
+}
+
+TEST_CASE("THandshakeExecutor limits pending handshakes") {
+    std::promise<void> Release;
+    auto Released = Release.get_future().share();
+    std::atomic<int> Ran { 0 };
+    // declared last, so its workers are joined before the above is destroyed
+    THandshakeExecutor Executor(1, 2);
+    auto Blocking = [&] {
+        Released.wait();
+        ++Ran;
+    };
+    CHECK(Executor.Submit(Blocking));
+    CHECK(Executor.Submit(Blocking));
+    // one running, one queued
+    CHECK(!Executor.Submit(Blocking));
+    CHECK(Executor.Rejected() == 1);
+    // the next step of an admitted handshake isn't turned away
+    CHECK(Executor.Resume(Blocking));
+    Release.set_value();
+    while (Executor.Pending() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(Ran == 3);
+    CHECK(Executor.Submit(Blocking));
+}
+
+TEST_CASE("THandshakeExecutor deadlines") {
+    THandshakeExecutor Executor(1, 1);
+    SUBCASE("expired") {
+        std::promise<void> Fired;
+        auto Deadline = Executor.Arm(std::chrono::milliseconds(10), [&] { Fired.set_value(); });
+        CHECK(Fired.get_future().wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+        CHECK(Deadline.Expired());
+        CHECK(Executor.TimedOut() == 1);
+    }
+    SUBCASE("disarmed in time") {
+        std::atomic<bool> Fired { false };
+        {
+            auto Deadline = Executor.Arm(std::chrono::milliseconds(50), [&] { Fired = true; });
+            CHECK(!Deadline.Expired());
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        CHECK(!Fired);
+    }
+    SUBCASE("shutdown cuts steps short") {
+        std::atomic<bool> Fired { false };
+        auto Deadline = Executor.Arm(std::chrono::hours(1), [&] { Fired = true; });
+        Executor.Shutdown();
+        CHECK(Fired);
+        CHECK(Deadline.Expired());
+        CHECK(!Executor.Submit([] { }));
+    }
+}
@@ -0,0 +1,266 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "TInterestManager.h"
+
+#include "Common.h"
+#include "Settings.h"
+
+#include <algorithm>
+#include <cmath>
+#include <doctest/doctest.h>
+
+static TInterestManager::TConfig ConfigFromSettings() {
+    TInterestManager::TConfig Config;
+    Config.NearRadius = double(std::max(1, Application::Settings.getAsInt(Settings::Key::Network_InterestNearRadius)));
+    Config.FarRadius = double(std::max(1, Application::Settings.getAsInt(Settings::Key::Network_InterestFarRadius)));
+    Config.MidInterval = std::max(1, Application::Settings.getAsInt(Settings::Key::Network_InterestMidInterval));
+    Config.FarInterval = std::max(0, Application::Settings.getAsInt(Settings::Key::Network_InterestFarInterval));
+    if (Config.FarRadius < Config.NearRadius) {
+        beammp_warnf("InterestFarRadius ({}) is smaller than InterestNearRadius ({}), using InterestNearRadius for both", Config.FarRadius, Config.NearRadius);
+        Config.FarRadius = Config.NearRadius;
+    }
+    return Config;
+}
+
+TInterestManager::TInterestManager()
+    : TInterestManager(ConfigFromSettings(), Application::Settings.getAsBool(Settings::Key::Network_InterestManagement)) {
+}
+
+TInterestManager::TInterestManager(const TConfig& Config, bool Enabled)
+    : mConfig(Config)
+    , mEnabled(Enabled)
+    // with this size, everything within the far radius is at most 3 cells away in each direction
+    , mCellSize(std::max(1.0, Config.FarRadius / 3.0)) {
+}
+
+uint64_t TInterestManager::CellOf(const TVec3& Position) const {
+    // clamped before the conversion, which is undefined outside of int32. The margin keeps
+    // the neighbours of the outermost cells in range, too.
+    constexpr double MaxCell = double(1 << 30);
+    const auto X = int32_t(std::clamp(std::floor(Position[0] / mCellSize), -MaxCell, MaxCell));
+    const auto Y = int32_t(std::clamp(std::floor(Position[1] / mCellSize), -MaxCell, MaxCell));
+    return (uint64_t(uint32_t(X)) << 32) | uint64_t(uint32_t(Y));
+}
+
+void TInterestManager::EraseFromCell(uint64_t Cell, uint64_t Key) {
+    auto Iter = mGrid.find(Cell);
+    if (Iter == mGrid.end()) {
+        return;
+    }
+    auto& Keys = Iter->second;
+    Keys.erase(std::remove(Keys.begin(), Keys.end(), Key), Keys.end());
+    if (Keys.empty()) {
+        mGrid.erase(Iter);
+    }
+}
+
+void TInterestManager::RemoveStale(TClock::time_point Now) {
+    for (auto Iter = mVehicles.begin(); Iter != mVehicles.end();) {
+        if (Now - Iter->second.LastSeen > mConfig.StaleAfter) {
+            EraseFromCell(Iter->second.Cell, Iter->first);
+            --mVehicleCounts[Iter->first >> 32];
+            Iter = mVehicles.erase(Iter);
+        } else {
+            ++Iter;
+        }
+    }
+}
+
+void TInterestManager::RemovePlayer(int PID) {
+    if (PID < 0 || size_t(PID) >= MaxPlayers) {
+        return;
+    }
+    std::unique_lock Lock(mMutex);
+    for (auto Iter = mVehicles.begin(); Iter != mVehicles.end();) {
+        if ((Iter->first >> 32) == uint64_t(PID)) {
+            EraseFromCell(Iter->second.Cell, Iter->first);
+            Iter = mVehicles.erase(Iter);
+        } else {
+            ++Iter;
+        }
+    }
+    mVehicleCounts[size_t(PID)] = 0;
+}
+
+void TInterestManager::RemoveVehicle(int PID, int VID) {
+    if (PID < 0 || size_t(PID) >= MaxPlayers || VID < 0) {
+        return;
+    }
+    const uint64_t Key = (uint64_t(PID) << 32) | uint64_t(uint32_t(VID));
+    std::unique_lock Lock(mMutex);
+    auto Iter = mVehicles.find(Key);
+    if (Iter == mVehicles.end()) {
+        return;
+    }
+    EraseFromCell(Iter->second.Cell, Key);
+    --mVehicleCounts[size_t(PID)];
+    mVehicles.erase(Iter);
+}
+
+TInterestManager::TRecipientSet TInterestManager::OnPosition(int PID, int VID, const TVec3& Position, TClock::time_point Now) {
+    TRecipientSet Result;
+    Result.set();
+    if (!mEnabled || PID < 0 || size_t(PID) >= MaxPlayers || VID < 0) {
+        return Result;
+    }
+    if (!std::all_of(Position.begin(), Position.end(), [](double Value) { return std::isfinite(Value); })) {
+        return Result;
+    }
+    const uint64_t Key = (uint64_t(PID) << 32) | uint64_t(uint32_t(VID));
+
+    std::unique_lock Lock(mMutex);
+    if (Now - mLastStaleCheck > std::chrono::seconds(1)) {
+        RemoveStale(Now);
+        mLastStaleCheck = Now;
+    }
+
+    auto [Iter, Inserted] = mVehicles.try_emplace(Key);
+    auto& Vehicle = Iter->second;
+    const auto NewCell = CellOf(Position);
+    if (Inserted) {
+        Vehicle.FirstSeen = Now;
+        ++mVehicleCounts[size_t(PID)];
+        mGrid[NewCell].push_back(Key);
+    } else if (Vehicle.Cell != NewCell) {
+        EraseFromCell(Vehicle.Cell, Key);
+        mGrid[NewCell].push_back(Key);
+    }
+    Vehicle.Cell = NewCell;
+    Vehicle.Position = Position;
+    Vehicle.LastSeen = Now;
+    const auto Sequence = Vehicle.Sequence++;
+
+    if (Now - Vehicle.FirstSeen < mConfig.SpawnGracePeriod) {
+        return Result;
+    }
+    const bool RelayFar = mConfig.FarInterval > 0 && Sequence % uint64_t(mConfig.FarInterval) == 0;
+    if (RelayFar) {
+        // goes to everyone anyways
+        return Result;
+    }
+    const bool RelayMid = Sequence % uint64_t(mConfig.MidInterval) == 0;
+
+    TRecipientSet HasVehicles;
+    for (size_t i = 0; i < MaxPlayers; ++i) {
+        HasVehicles[i] = mVehicleCounts[i] > 0;
+    }
+    TRecipientSet InRange;
+    const double NearSquared = mConfig.NearRadius * mConfig.NearRadius;
+    const double FarSquared = mConfig.FarRadius * mConfig.FarRadius;
+    const double MaxSquared = RelayMid ? FarSquared : NearSquared;
+    const auto CellX = int32_t(NewCell >> 32);
+    const auto CellY = int32_t(uint32_t(NewCell));
+    const auto Range = int32_t(std::ceil(std::sqrt(MaxSquared) / mCellSize));
+    for (int32_t X = CellX - Range; X <= CellX + Range; ++X) {
+        for (int32_t Y = CellY - Range; Y <= CellY + Range; ++Y) {
+            auto Cell = mGrid.find((uint64_t(uint32_t(X)) << 32) | uint64_t(uint32_t(Y)));
+            if (Cell == mGrid.end()) {
+                continue;
+            }
+            for (auto OtherKey : Cell->second) {
+                const auto& Other = mVehicles.at(OtherKey);
+                double DistanceSquared = 0;
+                for (size_t i = 0; i < 3; ++i) {
+                    const double Delta = Other.Position[i] - Position[i];
+                    DistanceSquared += Delta * Delta;
+                }
+                if (DistanceSquared <= MaxSquared) {
+                    InRange.set(size_t(OtherKey >> 32));
+                }
+            }
+        }
+    }
+    return ~HasVehicles | InRange;
+}
+
+TEST_CASE("TInterestManager tiers") {
+    TInterestManager::TConfig Config;
+    Config.NearRadius = 100;
+    Config.FarRadius = 500;
+    Config.MidInterval = 2;
+    Config.FarInterval = 0;
+    TInterestManager Manager(Config);
+    auto Now = TInterestManager::TClock::now();
+
+    // player 1 near the origin, player 2 at mid range, player 3 far away, player 4 has no vehicle
+    (void)Manager.OnPosition(1, 0, { 50, 0, 0 }, Now);
+    (void)Manager.OnPosition(2, 0, { 300, 0, 0 }, Now);
+    (void)Manager.OnPosition(3, 0, { 5000, 0, 0 }, Now);
+
+    SUBCASE("new vehicles are sent to everyone") {
+        auto Recipients = Manager.OnPosition(0, 0, { 0, 0, 0 }, Now);
+        CHECK(Recipients.all());
+    }
+    SUBCASE("decimation after the spawn grace period") {
+        Now += Config.SpawnGracePeriod;
+        // refresh the others, so they don't go stale
+        (void)Manager.OnPosition(1, 0, { 50, 0, 0 }, Now);
+        (void)Manager.OnPosition(2, 0, { 300, 0, 0 }, Now);
+        (void)Manager.OnPosition(3, 0, { 5000, 0, 0 }, Now);
+        (void)Manager.OnPosition(0, 0, { 0, 0, 0 }, Now - Config.SpawnGracePeriod);
+        // sequence 1: only near
+        auto Recipients = Manager.OnPosition(0, 0, { 0, 0, 0 }, Now);
+        CHECK(Recipients.test(1));
+        CHECK(!Recipients.test(2));
+        CHECK(!Recipients.test(3));
+        CHECK(Recipients.test(4));
+        // sequence 2: near and mid
+        Recipients = Manager.OnPosition(0, 0, { 0, 0, 0 }, Now);
+        CHECK(Recipients.test(1));
+        CHECK(Recipients.test(2));
+        CHECK(!Recipients.test(3));
+        CHECK(Recipients.test(4));
+    }
+    SUBCASE("removed players receive everything again") {
+        Manager.RemovePlayer(3);
+        Now += Config.SpawnGracePeriod;
+        (void)Manager.OnPosition(0, 0, { 0, 0, 0 }, Now - Config.SpawnGracePeriod);
+        auto Recipients = Manager.OnPosition(0, 0, { 0, 0, 0 }, Now);
+        CHECK(Recipients.test(3));
+    }
+    SUBCASE("deleted vehicles don't count as interest") {
+        Manager.RemoveVehicle(3, 0);
+        Manager.RemoveVehicle(3, 0);
+        Now += Config.SpawnGracePeriod;
+        (void)Manager.OnPosition(0, 0, { 0, 0, 0 }, Now - Config.SpawnGracePeriod);
+        auto Recipients = Manager.OnPosition(0, 0, { 0, 0, 0 }, Now);
+        CHECK(Recipients.test(3));
+    }
+}
+
+TEST_CASE("TInterestManager positions out of range") {
+    TInterestManager::TConfig Config;
+    Config.FarInterval = 0;
+    TInterestManager Manager(Config);
+    auto Now = TInterestManager::TClock::now();
+    (void)Manager.OnPosition(1, 0, { 1e300, -1e300, 0 }, Now - Config.SpawnGracePeriod);
+    (void)Manager.OnPosition(2, 0, { 1e300, -1e300, 0 }, Now - Config.SpawnGracePeriod);
+    (void)Manager.OnPosition(3, 0, { 0, 0, 0 }, Now);
+    // the outermost cell still works like any other
+    auto Recipients = Manager.OnPosition(1, 0, { 1e300, -1e300, 0 }, Now);
+    CHECK(Recipients.test(2));
+    CHECK(!Recipients.test(3));
+    CHECK(Manager.OnPosition(1, 0, { std::nan(""), 0, 0 }, Now).all());
+}
+
+TEST_CASE("TInterestManager disabled") {
+    TInterestManager Manager(TInterestManager::TConfig {}, false);
+    CHECK(!Manager.IsEnabled());
+    CHECK(Manager.OnPosition(0, 0, { 0, 0, 0 }).all());
+}
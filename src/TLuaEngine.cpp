@@ -592,6 +592,17 @@ sol::table TLuaEngine::StateThreadData::Lua_GetPlayers() {
     return Result;
 }
 
+sol::table TLuaEngine::StateThreadData::Lua_GetMods() {
+    sol::table Result = mStateView.create_table();
+    for (const auto& Mod : mEngine->Network().ResourceManager().Mods()) {
+        sol::table Entry = mStateView.create_table();
+        Entry["size"] = Mod.Size;
+        Entry["sha256"] = Mod.Hash;
+        Result[fs::path(Mod.Path).filename().string()] = Entry;
+    }
+    return Result;
+}
+
 int TLuaEngine::StateThreadData::Lua_GetPlayerIDByName(const std::string& Name) {
     int Id = -1;
     mEngine->mServer->ForEachClient([&Id, &Name](std::weak_ptr<TClient> Client) -> bool {
@@ -668,8 +679,28 @@ std::pair<sol::table, std::string> TLuaEngine::StateThreadData::Lua_GetPositionR
     std::pair<sol::table, std::string> Result;
     auto MaybeClient = GetClient(mEngine->Server(), PID);
     if (MaybeClient && !MaybeClient.value().expired()) {
-        auto Client = MaybeClient.value().lock();
-        std::string VehiclePos = Client->GetCarPositionRaw(VID);
+        auto& Positions = mEngine->Server().VehiclePositions();
+        if (auto Position = Positions.Get(PID, VID); Position.has_value()) {
+            // same layout as the decoded json, without going through json
+            auto Array = [&](const auto& Values) {
+                auto Table = mStateView.create_table();
+                for (auto Value : Values) {
+                    Table.add(Value);
+                }
+                return Table;
+            };
+            auto t = mStateView.create_table();
+            t["tim"] = Position->Time;
+            t["ping"] = Position->Ping;
+            t["pos"] = Array(Position->Pos);
+            t["rot"] = Array(Position->Rot);
+            t["vel"] = Array(Position->Vel);
+            t["rvel"] = Array(Position->RVel);
+            Result.first = t;
+            return Result;
+        }
+        // only positions in an unknown format are still json
+        std::string VehiclePos = Positions.GetJson(PID, VID);
 
         if (VehiclePos.empty()) {
             // return std::make_tuple(sol::lua_nil, sol::make_object(StateView, "Vehicle not found"));
@@ -857,6 +888,9 @@ TLuaEngine::StateThreadData::StateThreadData(const std::string& Name, TLuaStateI
     MPTable.set_function("GetPlayers", [&]() -> sol::table {
         return Lua_GetPlayers();
     });
+    MPTable.set_function("GetMods", [&]() -> sol::table {
+        return Lua_GetMods();
+    });
     MPTable.set_function("IsPlayerGuest", &LuaAPI::MP::IsPlayerGuest);
     MPTable.set_function("DropPlayer", &LuaAPI::MP::DropPlayer);
     MPTable.set_function("GetStateMemoryUsage", [&]() -> size_t {
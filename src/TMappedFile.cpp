@@ -0,0 +1,139 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "TMappedFile.h"
+
+#include "Environment.h"
+
+#include <cerrno>
+#include <cstring>
+#include <doctest/doctest.h>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#if defined(BEAMMP_LINUX) || defined(BEAMMP_APPLE) || defined(BEAMMP_FREEBSD)
+#define BEAMMP_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<const TMappedFile> TMappedFile::Open(const std::string& Path) {
+    // no make_shared, the constructor is private
+    std::shared_ptr<TMappedFile> File(new TMappedFile);
+    File->mPath = Path;
+    std::error_code ec;
+    File->mLastWriteTime = std::filesystem::last_write_time(Path, ec);
+#ifdef BEAMMP_HAS_MMAP
+    File->mFd = open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (File->mFd < 0) {
+        throw std::runtime_error("Failed to open " + Path + ": " + std::strerror(errno));
+    }
+    struct stat Stat {};
+    if (fstat(File->mFd, &Stat) != 0) {
+        throw std::runtime_error("Failed to stat " + Path + ": " + std::strerror(errno));
+    }
+    File->mSize = uint64_t(Stat.st_size);
+#ifndef BEAMMP_LINUX
+    // with sendfile(), nobody needs the mapping, and it would only cost address space
+    if (File->mSize > 0) {
+        void* Mapping = mmap(nullptr, size_t(File->mSize), PROT_READ, MAP_SHARED, File->mFd, 0);
+        // not fatal, readers fall back to the file descriptor
+        if (Mapping != MAP_FAILED) {
+            File->mData = static_cast<const uint8_t*>(Mapping);
+        }
+    }
+#endif
+#else
+    if (ec || !std::filesystem::is_regular_file(Path, ec)) {
+        throw std::runtime_error("Failed to open " + Path);
+    }
+    File->mSize = uint64_t(std::filesystem::file_size(Path));
+#endif
+    return File;
+}
+
+size_t TMappedFile::ReadAt(uint64_t Offset, uint8_t* Out, size_t Size) const {
+#ifdef BEAMMP_HAS_MMAP
+    size_t Read = 0;
+    while (mFd >= 0 && Read < Size) {
+        const auto Res = pread(mFd, Out + Read, Size - Read, off_t(Offset + Read));
+        if (Res < 0 && errno == EINTR) {
+            continue;
+        }
+        if (Res <= 0) {
+            break;
+        }
+        Read += size_t(Res);
+    }
+    return Read;
+#else
+    (void)Offset;
+    (void)Out;
+    (void)Size;
+    return 0;
+#endif
+}
+
+TMappedFile::~TMappedFile() {
+#ifdef BEAMMP_HAS_MMAP
+    if (mData) {
+        munmap(const_cast<uint8_t*>(mData), size_t(mSize));
+    }
+    if (mFd >= 0) {
+        close(mFd);
+    }
+#endif
+}
+
+TEST_CASE("TMappedFile") {
+    const auto Path = (std::filesystem::temp_directory_path() / "beammp_mapped_file_test.bin").string();
+    const std::string Content = "not really a zip";
+    {
+        std::ofstream File(Path, std::ios::binary);
+        File << Content;
+    }
+    auto Mapped = TMappedFile::Open(Path);
+    CHECK(Mapped->Size() == Content.size());
+    CHECK(Mapped->Path() == Path);
+    if (Mapped->Data()) {
+        CHECK(std::string(reinterpret_cast<const char*>(Mapped->Data()), Mapped->Size()) == Content);
+    }
+    if (Mapped->NativeHandle() >= 0) {
+        std::string Part(5, '\0');
+        CHECK(Mapped->ReadAt(4, reinterpret_cast<uint8_t*>(Part.data()), Part.size()) == Part.size());
+        CHECK(Part == "reall");
+        // stops at the end
+        CHECK(Mapped->ReadAt(Content.size() - 2, reinterpret_cast<uint8_t*>(Part.data()), Part.size()) == 2);
+    }
+    // replacing the file doesn't affect the existing mapping
+    std::filesystem::remove(Path);
+    {
+        std::ofstream File(Path, std::ios::binary);
+        File << "something else entirely";
+    }
+    CHECK(Mapped->Size() == Content.size());
+    if (Mapped->Data()) {
+        CHECK(std::string(reinterpret_cast<const char*>(Mapped->Data()), Mapped->Size()) == Content);
+    }
+    CHECK(TMappedFile::Open(Path)->Size() != Content.size());
+    std::filesystem::remove(Path);
+    CHECK_THROWS(TMappedFile::Open(Path));
+}
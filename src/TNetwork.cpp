@@ -19,39 +19,221 @@
 #include "TNetwork.h"
 #include "Client.h"
 #include "Common.h"
+#include "Compression.h"
+#include "FileTransfer.h"
 #include "LuaAPI.h"
 #include "TLuaEngine.h"
 #include "nlohmann/json.hpp"
 #include <CustomAssert.h>
 #include <Http.h>
 #include <array>
+#include <charconv>
 #include <boost/asio/ip/address.hpp>
 #include <boost/asio/ip/address_v4.hpp>
 #include <cstring>
+#include <fstream>
+#include <iterator>
 #include <zlib.h>
 
+#ifdef BEAMMP_LINUX
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
 typedef boost::asio::detail::socket_option::integer<SOL_SOCKET, SO_RCVTIMEO> rcv_timeout_option;
 
+// how many queued packets are taken out of a client's queue at once. Each packet needs
+// two buffers (header and data), so 32 packets fit into one writev() on all platforms
+// we support (asio passes at most 64 buffers per call).
+static constexpr size_t MaxOutboundBatch = 32;
+// threads which run OnDisconnect for async clients
+static constexpr size_t DisconnectThreads = 2;
+// how long shutdown waits for the clients' sockets to close before giving up on them
+static constexpr std::chrono::seconds IoDrainTimeout { 5 };
+
 std::vector<uint8_t> StringToVector(const std::string& Str) {
     return std::vector<uint8_t>(Str.data(), Str.data() + Str.size());
 }
 
-static void CompressProperly(std::vector<uint8_t>& Data) {
-    constexpr std::string_view ABG = "ABG:";
-    auto CombinedData = std::vector<uint8_t>(ABG.begin(), ABG.end());
-    auto CompData = Comp(Data);
-    CombinedData.resize(ABG.size() + CompData.size());
-    std::copy(CompData.begin(), CompData.end(), CombinedData.begin() + ABG.size());
-    Data = CombinedData;
+static std::vector<uint8_t> CompressWithHeader(const ICodec& Codec, std::span<const uint8_t> Data) {
+    return Compression::CompressPacket(Codec, Data);
+}
+
+// Packets which only carry the latest state of something, and which therefore don't have
+// to be sent if a newer one is queued anyways: vehicle edits (Oc) and positions (Zp). The
+// key is the packet type, player ID and vehicle ID, or 0 for all other packets, and for IDs
+// which don't fit into it (rather than letting two vehicles share a key).
+static uint32_t SupersedeKeyOf(const TSharedBuffer& Packet) {
+    const auto Str = Packet.AsStringView();
+    if (!Str.starts_with("Oc:") && !Str.starts_with("Zp:")) {
+        return 0;
+    }
+    int PID = -1;
+    int VID = -1;
+    const char* End = Str.data() + Str.size();
+    auto [DashPtr, DashError] = std::from_chars(Str.data() + 3, End, PID);
+    if (DashError != std::errc() || DashPtr == End || *DashPtr != '-') {
+        return 0;
+    }
+    auto [VIDEnd, VIDError] = std::from_chars(DashPtr + 1, End, VID);
+    if (VIDError != std::errc() || PID < 0 || PID > 0xff || VID < 0 || VID > 0xffff) {
+        return 0;
+    }
+    return (uint32_t(uint8_t(Str[1])) << 24) | (uint32_t(PID) << 16) | uint32_t(VID);
+}
+
+TEST_CASE("SupersedeKeyOf") {
+    CHECK(SupersedeKeyOf(TSharedBuffer::FromString("Oc:1-2:{}")) == SupersedeKeyOf(TSharedBuffer::FromString("Oc:1-2:{\"other\":1}")));
+    CHECK(SupersedeKeyOf(TSharedBuffer::FromString("Oc:1-2:{}")) != SupersedeKeyOf(TSharedBuffer::FromString("Oc:1-3:{}")));
+    CHECK(SupersedeKeyOf(TSharedBuffer::FromString("Oc:1-2:{}")) != SupersedeKeyOf(TSharedBuffer::FromString("Zp:1-2:{}")));
+    CHECK(SupersedeKeyOf(TSharedBuffer::FromString("Oc:1-2:{}")) != 0);
+    CHECK(SupersedeKeyOf(TSharedBuffer::FromString("Os:1-2:{}")) == 0);
+    CHECK(SupersedeKeyOf(TSharedBuffer::FromString("Oc:x")) == 0);
+    // would collide with 1-2
+    CHECK(SupersedeKeyOf(TSharedBuffer::FromString("Oc:257-2:{}")) == 0);
+    CHECK(SupersedeKeyOf(TSharedBuffer::FromString("Oc:1-65538:{}")) == 0);
+    CHECK(SupersedeKeyOf(TSharedBuffer::FromString("Oc:255-65535:{}")) != 0);
+    CHECK(SupersedeKeyOf(TSharedBuffer::FromString("C:hello")) == 0);
+}
+
+namespace {
+struct TFileRequest {
+    std::string Name;
+    uint64_t Offset { 0 };
+    std::optional<uint64_t> Length;
+};
+}
+
+// The body of an `f` packet: the file name, optionally followed by a NUL byte and a range
+// "<offset>" or "<offset>-<length>", to resume an interrupted download. No file name
+// contains a NUL byte, so older clients which never send a range are unaffected.
+static std::optional<TFileRequest> ParseFileRequest(std::string_view Body) {
+    TFileRequest Request;
+    const auto Separator = Body.find('\0');
+    Request.Name = std::string(Body.substr(0, Separator));
+    if (Separator == std::string_view::npos) {
+        return Request;
+    }
+    const char* Ptr = Body.data() + Separator + 1;
+    const char* End = Body.data() + Body.size();
+    auto [OffsetEnd, OffsetError] = std::from_chars(Ptr, End, Request.Offset);
+    if (OffsetError != std::errc() || OffsetEnd == Ptr) {
+        return std::nullopt;
+    }
+    if (OffsetEnd == End) {
+        return Request;
+    }
+    if (*OffsetEnd != '-') {
+        return std::nullopt;
+    }
+    uint64_t Length = 0;
+    auto [LengthEnd, LengthError] = std::from_chars(OffsetEnd + 1, End, Length);
+    if (LengthError != std::errc() || LengthEnd != End || LengthEnd == OffsetEnd + 1) {
+        return std::nullopt;
+    }
+    Request.Length = Length;
+    return Request;
+}
+
+TEST_CASE("ParseFileRequest") {
+    using namespace std::literals;
+    auto Plain = ParseFileRequest("Resources/Client/mod.zip");
+    REQUIRE(Plain.has_value());
+    CHECK(Plain->Name == "Resources/Client/mod.zip");
+    CHECK(Plain->Offset == 0);
+    CHECK(!Plain->Length.has_value());
+
+    auto FromOffset = ParseFileRequest("mod.zip\0"s "1000");
+    REQUIRE(FromOffset.has_value());
+    CHECK(FromOffset->Name == "mod.zip");
+    CHECK(FromOffset->Offset == 1000);
+    CHECK(!FromOffset->Length.has_value());
+
+    auto WithLength = ParseFileRequest("mod.zip\0"s "1000-24");
+    REQUIRE(WithLength.has_value());
+    CHECK(WithLength->Offset == 1000);
+    CHECK(WithLength->Length == 24);
+
+    CHECK(!ParseFileRequest("mod.zip\0"s).has_value());
+    CHECK(!ParseFileRequest("mod.zip\0"s "x").has_value());
+    CHECK(!ParseFileRequest("mod.zip\0"s "10-").has_value());
+    CHECK(!ParseFileRequest("mod.zip\0"s "10-5x").has_value());
+    CHECK(!ParseFileRequest("mod.zip\0"s "-5").has_value());
+}
+
+static void CompressProperly(const ICodec& Codec, std::vector<uint8_t>& Data) {
+    Data = CompressWithHeader(Codec, Data);
+}
+
+static uint64_t DownloadRateFromSettings() {
+    const auto Uplink = uint64_t(std::max(0, Application::Settings.getAsInt(Settings::Key::Network_UplinkKBps)));
+    const auto Reserve = uint64_t(std::max(0, Application::Settings.getAsInt(Settings::Key::Network_GameplayReserveKBps)));
+    if (Uplink == 0) {
+        return 0;
+    }
+    // downloads must never stall completely
+    const auto Minimum = std::max<uint64_t>(1, Uplink / 10);
+    if (Reserve + Minimum > Uplink) {
+        beammp_warnf("GameplayReserveKBps ({}) leaves (almost) nothing of UplinkKBps ({}) for mod downloads, limiting them to {} KB/s", Reserve, Uplink, Minimum);
+        return Minimum * 1024;
+    }
+    return (Uplink - Reserve) * 1024;
+}
+
+static void LoadCompressionDictionary(const std::string& Path) {
+    std::ifstream File(Path, std::ios::binary);
+    if (!File) {
+        beammp_errorf("Failed to open compression dictionary '{}'", Path);
+        return;
+    }
+    std::vector<uint8_t> Dictionary((std::istreambuf_iterator<char>(File)), std::istreambuf_iterator<char>());
+    try {
+        const auto& Codec = Compression::LoadDictionary(std::move(Dictionary));
+        beammp_infof("Loaded compression dictionary '{}' as '{}'", Path, Codec.Name());
+    } catch (const std::exception& e) {
+        beammp_errorf("Failed to load compression dictionary '{}': {}", Path, e.what());
+    }
 }
 
 TNetwork::TNetwork(TServer& Server, TPPSMonitor& PPSMonitor, TResourceManager& ResourceManager)
     : mServer(Server)
     , mPPSMonitor(PPSMonitor)
-    , mUDPSock(Server.IoCtx())
-    , mResourceManager(ResourceManager) {
+    , mResourceManager(ResourceManager)
+    , mAsyncIO(Application::Settings.getAsBool(Settings::Key::Network_AsyncIO))
+    , mPositionTickRate(std::max(0, Application::Settings.getAsInt(Settings::Key::Network_PositionTickRate)))
+    , mPositionDeltasEnabled(Application::Settings.getAsBool(Settings::Key::Network_PositionDeltas))
+    , mHandshakeTimeout(std::max(1, Application::Settings.getAsInt(Settings::Key::Network_HandshakeTimeout)))
+    , mDownloadBandwidth(DownloadRateFromSettings()) {
     Application::SetSubsystemStatus("TCPNetwork", Application::Status::Starting);
     Application::SetSubsystemStatus("UDPNetwork", Application::Status::Starting);
+    std::unique_ptr<IAuthProvider> AuthProvider;
+    try {
+        AuthProvider = MakeAuthProviderFromSettings();
+    } catch (const std::exception& e) {
+        beammp_errorf("Failed to set up authentication, nobody will be able to join: {}", e.what());
+    }
+    mAuth = std::make_unique<TAuthService>(std::move(AuthProvider),
+        size_t(std::max(1, Application::Settings.getAsInt(Settings::Key::Network_AuthWorkers))),
+        std::chrono::seconds(std::max(0, Application::Settings.getAsInt(Settings::Key::Network_AuthCacheSeconds))));
+    beammp_infof("Authenticating players with: {}", mAuth->ProviderName());
+    Application::RegisterShutdownHandler([&] {
+        mAuth->Shutdown();
+    });
+    mHandshakes = std::make_unique<THandshakeExecutor>(
+        size_t(std::max(1, Application::Settings.getAsInt(Settings::Key::Network_HandshakeWorkers))),
+        size_t(std::max(1, Application::Settings.getAsInt(Settings::Key::Network_MaxPendingHandshakes))));
+    Application::RegisterShutdownHandler([&] {
+        mHandshakes->Shutdown();
+    });
+    if (const auto DictionaryPath = Application::Settings.getAsString(Settings::Key::Network_CompressionDictionary); !DictionaryPath.empty()) {
+        LoadCompressionDictionary(DictionaryPath);
+    }
+    if (mDownloadBandwidth.IsLimited()) {
+        beammp_infof("Mod downloads are limited to {} KB/s in total", mDownloadBandwidth.Rate() / 1024);
+    }
+    Application::RegisterShutdownHandler([&] {
+        mDownloadBandwidth.Shutdown();
+    });
     Application::RegisterShutdownHandler([&] {
         beammp_debug("Kicking all players due to shutdown");
         Server.ForEachClient([&](std::weak_ptr<TClient> client) -> bool {
@@ -63,8 +245,10 @@ TNetwork::TNetwork(TServer& Server, TPPSMonitor& PPSMonitor, TResourceManager& R
     });
     Application::RegisterShutdownHandler([&] {
         Application::SetSubsystemStatus("UDPNetwork", Application::Status::ShuttingDown);
-        if (mUDPThread.joinable()) {
-            mUDPThread.detach();
+        for (auto& UDPThread : mUDPThreads) {
+            if (UDPThread.joinable()) {
+                UDPThread.detach();
+            }
         }
         Application::SetSubsystemStatus("UDPNetwork", Application::Status::Shutdown);
     });
@@ -75,12 +259,324 @@ TNetwork::TNetwork(TServer& Server, TPPSMonitor& PPSMonitor, TResourceManager& R
         }
         Application::SetSubsystemStatus("TCPNetwork", Application::Status::Shutdown);
     });
+    if (mAsyncIO) {
+        StartIoWorkers();
+    }
     mTCPThread = std::thread(&TNetwork::TCPServerMain, this);
-    mUDPThread = std::thread(&TNetwork::UDPServerMain, this);
+    auto UDPThreadCount = size_t(std::max(1, Application::Settings.getAsInt(Settings::Key::Network_UDPThreads)));
+#ifndef BEAMMP_LINUX
+    if (UDPThreadCount > 1) {
+        beammp_warn("Multiple UDP threads are only supported on Linux, using one");
+        UDPThreadCount = 1;
+    }
+#endif
+    for (size_t i = 0; i < UDPThreadCount; ++i) {
+        mUDPSockets.push_back(std::make_unique<ip::udp::socket>(Server.IoCtx()));
+    }
+    for (size_t i = 0; i < UDPThreadCount; ++i) {
+        mUDPThreads.emplace_back(&TNetwork::UDPServerMain, this, i);
+    }
+    if (mPositionTickRate > 0) {
+        Application::RegisterShutdownHandler([&] {
+            if (mPositionTickThread.joinable()) {
+                mPositionTickThread.join();
+            }
+        });
+        mPositionTickThread = std::thread(&TNetwork::PositionTickMain, this);
+    }
+}
+
+void TNetwork::PositionTickMain() {
+    RegisterThread("PositionTick");
+    beammp_infof("Sending vehicle positions {} times per second", mPositionTickRate);
+    const auto Interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(1)) / mPositionTickRate;
+    auto NextTick = std::chrono::steady_clock::now() + Interval;
+    std::vector<TPositionSnapshots::TSnapshot> Snapshots;
+    while (!Application::IsShuttingDown()) {
+        std::this_thread::sleep_until(NextTick);
+        NextTick += Interval;
+        const auto Now = std::chrono::steady_clock::now();
+        if (NextTick < Now) {
+            // we fell behind, don't try to catch up with a burst of ticks
+            NextTick = Now + Interval;
+        }
+        mStats.PositionTicks.fetch_add(1, std::memory_order_relaxed);
+        mPositionSnapshots.TakeAll(Snapshots);
+        SendPositionTick(Snapshots);
+        // don't keep the packets alive until the next tick
+        Snapshots.clear();
+    }
+}
+
+void TNetwork::SendPositionTick(const std::vector<TPositionSnapshots::TSnapshot>& Snapshots) {
+    struct TPending {
+        const TPositionSnapshots::TSnapshot* Snapshot;
+        std::optional<TInterestManager::TRecipientSet> Recipients;
+        // parsed at most once, for clients which support deltas
+        std::optional<std::optional<TPositionDeltaEncoder::TPosition>> Position;
+        // compressed at most once per codec
+        std::vector<std::pair<const ICodec*, TSharedBuffer>> Compressed;
+    };
+    std::vector<TPending> Pending;
+    Pending.reserve(Snapshots.size());
+    auto& InterestManager = mServer.InterestManager();
+    for (const auto& Snapshot : Snapshots) {
+        auto Sender = mServer.GetClientByID(Snapshot.PID);
+        if (!Sender || Sender->IsDisconnected()) {
+            continue;
+        }
+        if (compressBound(Snapshot.Packet.size()) > 1024) {
+            // too large for UDP, this goes out reliably like any other large packet
+            SendToAll(Sender.get(), Snapshot.Packet, false, false);
+            continue;
+        }
+        auto& Entry = Pending.emplace_back(TPending { &Snapshot, std::nullopt, std::nullopt, {} });
+        if (Snapshot.Position.has_value() && InterestManager.IsEnabled()) {
+            Entry.Recipients = InterestManager.OnPosition(Snapshot.PID, Snapshot.VID, Snapshot.Position.value());
+        }
+    }
+    if (Pending.empty()) {
+        return;
+    }
+    // what one client gets for one snapshot, the same as SendToAll would send
+    auto PayloadFor = [&](TPending& Entry, TClient& Client) -> TSharedBuffer {
+        const auto& Packet = Entry.Snapshot->Packet;
+        if (mPositionDeltasEnabled && Client.HasCapability(TClient::CapPositionDeltas)) {
+            if (!Entry.Position) {
+                Entry.Position = TPositionDeltaEncoder::Parse(Packet.AsStringView());
+            }
+            if (Entry.Position->has_value()) {
+                auto Delta = mPositionDeltas.Encode(Client.GetID(), Entry.Position->value());
+                mStats.PositionDeltasSent.fetch_add(1, std::memory_order_relaxed);
+                mStats.PositionDeltaBytesSaved.fetch_add(Packet.size() - std::min(Packet.size(), Delta.size()), std::memory_order_relaxed);
+                return Delta;
+            }
+        }
+        // same rule as in UDPSend
+        if (Packet.size() > 400) {
+            for (const auto& [Codec, Buffer] : Entry.Compressed) {
+                if (Codec == &Client.Codec()) {
+                    return Buffer;
+                }
+            }
+            Entry.Compressed.emplace_back(&Client.Codec(), TSharedBuffer(CompressWithHeader(Client.Codec(), { Packet.data(), Packet.size() })));
+            return Entry.Compressed.back().second;
+        }
+        return Packet;
+    };
+    std::vector<std::shared_ptr<TClient>> Recipients;
+    std::vector<TSharedBuffer> Payloads;
+    std::vector<TSharedBuffer> Packets;
+    mServer.ForEachClient([&](std::weak_ptr<TClient> ClientPtr) -> bool {
+        std::shared_ptr<TClient> Client;
+        {
+            ReadLock Lock(mServer.GetClientMutex());
+            Client = ClientPtr.lock();
+        }
+        if (!Client || !(Client->IsSynced() || Client->IsSyncing())) {
+            return true;
+        }
+        Packets.clear();
+        for (auto& Entry : Pending) {
+            if (Entry.Snapshot->PID == Client->GetID()) {
+                continue;
+            }
+            if (Entry.Recipients && (Client->GetID() < 0 || !Entry.Recipients->test(size_t(Client->GetID())))) {
+                mStats.InterestFiltered.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            Packets.push_back(PayloadFor(Entry, *Client));
+        }
+        if (Client->HasCapability(TClient::CapPositionBatches)) {
+            const auto Before = Payloads.size();
+            TPositionSnapshots::Batch(Packets, Payloads);
+            mStats.PositionDatagramsSaved.fetch_add(Packets.size() - (Payloads.size() - Before), std::memory_order_relaxed);
+        } else {
+            Payloads.insert(Payloads.end(), Packets.begin(), Packets.end());
+        }
+        Recipients.resize(Payloads.size(), Client);
+        return true;
+    });
+    if (!Payloads.empty()) {
+        // everything for everyone in this tick, with as few syscalls as possible
+        (void)UDPSendEach(Recipients, Payloads);
+    }
 }
 
-void TNetwork::UDPServerMain() {
-    RegisterThread("UDPServer");
+void TNetwork::QueuePosition(TClient& c, int VID, TSharedBuffer Packet, std::optional<TInterestManager::TVec3> Position) {
+    if (mPositionSnapshots.Store(c.GetID(), VID, std::move(Packet), Position)) {
+        mStats.PositionsSuperseded.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void TNetwork::ForgetVehicle(int PID, int VID) {
+    mPositionSnapshots.RemoveVehicle(PID, VID);
+    mPositionDeltas.ForgetVehicle(PID, VID);
+    mServer.VehiclePositions().RemoveVehicle(PID, VID);
+    mServer.InterestManager().RemoveVehicle(PID, VID);
+}
+
+void TNetwork::RequestPositionKeyframe(TClient& c, std::string_view Packet) {
+    if (!mPositionDeltasEnabled || !c.HasCapability(TClient::CapPositionDeltas)) {
+        return;
+    }
+    auto Request = TPositionDeltaEncoder::ParseKeyframeRequest(Packet);
+    if (!Request) {
+        beammp_debugf("Client '{}' ({}) sent an invalid keyframe request, ignoring", c.GetName(), c.GetID());
+        return;
+    }
+    mPositionDeltas.RequestKeyframe(c.GetID(), Request->first, Request->second);
+}
+
+void TNetwork::StartIoWorkers() {
+    auto ThreadCount = Application::Settings.getAsInt(Settings::Key::Network_IoThreads);
+    if (ThreadCount <= 0) {
+        ThreadCount = int(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    mDisconnectPool = std::make_unique<thread_pool>(DisconnectThreads);
+    // keeps run() from returning while there are no clients
+    mIoWorkGuard.emplace(make_work_guard(mServer.IoCtx()));
+    for (int i = 0; i < ThreadCount; ++i) {
+        mIoThreads.emplace_back([this, i] {
+            RegisterThread("IoWorker" + std::to_string(i));
+            while (!Application::IsShuttingDown()) {
+                try {
+                    mServer.IoCtx().run();
+                    break;
+                } catch (const std::exception& e) {
+                    beammp_errorf("Exception in IO worker: {}", e.what());
+                }
+            }
+        });
+    }
+    Application::RegisterShutdownHandler([&] {
+        // the clients close their sockets through their strands, which completes their
+        // pending reads and writes. Once that's done, run() returns on its own.
+        mServer.ForEachClient([](const std::weak_ptr<TClient>& Client) -> bool {
+            if (auto Locked = Client.lock(); Locked && !Locked->IsDisconnected()) {
+                Locked->Disconnect("Server shutdown");
+            }
+            return true;
+        });
+        mIoWorkGuard.reset();
+        const auto Deadline = std::chrono::steady_clock::now() + IoDrainTimeout;
+        while (!mServer.IoCtx().stopped() && std::chrono::steady_clock::now() < Deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (!mServer.IoCtx().stopped()) {
+            beammp_warnf("Network IO didn't finish within {} seconds, abandoning it", IoDrainTimeout.count());
+            mServer.IoCtx().stop();
+        }
+        for (auto& Thread : mIoThreads) {
+            if (Thread.joinable()) {
+                Thread.join();
+            }
+        }
+        // disconnects which haven't been handled yet don't matter anymore
+        mDisconnectPool->stop();
+        mDisconnectPool->join();
+    });
+    beammp_infof("Asynchronous networking enabled with {} IO thread(s)", ThreadCount);
+}
+
+#ifdef BEAMMP_LINUX
+// Receives up to `Size` datagrams with one recvmmsg() call. Each slot holds a buffer from
+// the packet buffer pool, which is handed out as is and replaced by another pooled one.
+struct TUDPRecvBatch {
+    static constexpr size_t Size = 64;
+    static constexpr size_t MaxDatagramSize = 1024;
+
+    TUDPRecvBatch() {
+        for (auto& Buffer : Buffers) {
+            Buffer = NewBuffer();
+        }
+    }
+
+    // blocks until at least one datagram is available. Returns the number of datagrams
+    // received, or -1 with errno set.
+    int Receive(int Fd) {
+        for (size_t i = 0; i < Size; ++i) {
+            // buffers are swapped out by Take()
+            Iovecs[i].iov_base = Buffers[i].data();
+            Iovecs[i].iov_len = Buffers[i].size();
+            Headers[i] = {};
+            Headers[i].msg_hdr.msg_iov = &Iovecs[i];
+            Headers[i].msg_hdr.msg_iovlen = 1;
+            Headers[i].msg_hdr.msg_name = &Addresses[i];
+            Headers[i].msg_hdr.msg_namelen = sizeof(Addresses[i]);
+        }
+        return recvmmsg(Fd, Headers.data(), Size, MSG_WAITFORONE, nullptr);
+    }
+
+    // the datagram didn't fit into the buffer, the rest of it is lost
+    [[nodiscard]] bool Truncated(size_t i) const {
+        return (Headers[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+    }
+
+    std::vector<uint8_t> Take(size_t i, ip::udp::endpoint& Endpoint) {
+        const auto Len = std::min<size_t>(Headers[i].msg_hdr.msg_namelen, Endpoint.capacity());
+        std::memcpy(Endpoint.data(), &Addresses[i], Len);
+        Endpoint.resize(Len);
+        auto Data = std::exchange(Buffers[i], NewBuffer());
+        Data.resize(Headers[i].msg_len);
+        return Data;
+    }
+
+    static std::vector<uint8_t> NewBuffer() {
+        auto Buffer = Compression::BufferPool().Acquire(MaxDatagramSize);
+        Buffer.resize(MaxDatagramSize);
+        return Buffer;
+    }
+
+    std::array<std::vector<uint8_t>, Size> Buffers {};
+    std::array<iovec, Size> Iovecs {};
+    std::array<sockaddr_storage, Size> Addresses {};
+    std::array<mmsghdr, Size> Headers {};
+};
+
+TEST_CASE("TUDPRecvBatch") {
+    io_context Io;
+    ip::udp::socket Receiver(Io, ip::udp::endpoint(ip::make_address("127.0.0.1"), 0));
+    ip::udp::socket Sender(Io, ip::udp::endpoint(ip::make_address("127.0.0.1"), 0));
+    const std::vector<std::string> Datagrams { "1:Zp:hello", "2:Zp:world", std::string(TUDPRecvBatch::MaxDatagramSize + 1, 'x'), "3:Vi" };
+    for (const auto& Datagram : Datagrams) {
+        Sender.send_to(buffer(Datagram), Receiver.local_endpoint());
+    }
+    TUDPRecvBatch Batch;
+    size_t Received = 0;
+    while (Received < Datagrams.size()) {
+        int Count = Batch.Receive(Receiver.native_handle());
+        REQUIRE(Count > 0);
+        for (int i = 0; i < Count; ++i) {
+            const auto& Expected = Datagrams.at(Received);
+            CHECK(Batch.Truncated(size_t(i)) == (Expected.size() > TUDPRecvBatch::MaxDatagramSize));
+            ip::udp::endpoint From;
+            const auto* Slot = Batch.Buffers[size_t(i)].data();
+            auto Data = Batch.Take(size_t(i), From);
+            // handed out without copying
+            CHECK(Data.data() == Slot);
+            CHECK(Batch.Buffers[size_t(i)].size() == TUDPRecvBatch::MaxDatagramSize);
+            if (Expected.size() <= TUDPRecvBatch::MaxDatagramSize) {
+                CHECK(std::string(Data.begin(), Data.end()) == Expected);
+            }
+            CHECK(From == Sender.local_endpoint());
+            ++Received;
+        }
+    }
+}
+#endif
+
+// set in each UDP thread, so that replies from there go out through the thread's own socket
+static thread_local ip::udp::socket* tUDPSocket = nullptr;
+
+ip::udp::socket& TNetwork::UDPSocket() {
+    return tUDPSocket ? *tUDPSocket : *mUDPSockets.front();
+}
+
+void TNetwork::UDPServerMain(size_t Shard) {
+    RegisterThread(Shard == 0 ? std::string("UDPServer") : "UDPServer" + std::to_string(Shard));
+    auto& Socket = *mUDPSockets.at(Shard);
+    tUDPSocket = &Socket;
 
     boost::system::error_code ec;
 
@@ -91,55 +587,122 @@ void TNetwork::UDPServerMain() {
     }
 
     ip::udp::endpoint UdpListenEndpoint(add, Application::Settings.getAsInt(Settings::Key::General_Port));
-    mUDPSock.open(UdpListenEndpoint.protocol(), ec);
+    Socket.open(UdpListenEndpoint.protocol(), ec);
     if (ec) {
         beammp_error("open() failed: " + ec.message());
         std::this_thread::sleep_for(std::chrono::seconds(5));
         Application::GracefullyShutdown();
     }
-    mUDPSock.bind(UdpListenEndpoint, ec);
+#ifdef BEAMMP_LINUX
+    if (mUDPSockets.size() > 1) {
+        // the kernel distributes incoming datagrams over all sockets by hashing the
+        // source address, so all packets of a client always arrive at the same thread.
+        Socket.set_option(detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true), ec);
+        if (ec) {
+            beammp_errorf("Failed to enable SO_REUSEPORT on UDP socket {}: {}", Shard, ec.message());
+        }
+    }
+#endif
+    Socket.bind(UdpListenEndpoint, ec);
     if (ec) {
         beammp_error("bind() failed: " + ec.message());
         std::this_thread::sleep_for(std::chrono::seconds(5));
         Application::GracefullyShutdown();
     }
-    Application::SetSubsystemStatus("UDPNetwork", Application::Status::Good);
-    beammp_info(("Vehicle data network online on ") + Application::Settings.getAsString(Settings::Key::General_Ip)
-        + " on port " + std::to_string(Application::Settings.getAsInt(Settings::Key::General_Port)) + (" with a Max of ")
-        + std::to_string(Application::Settings.getAsInt(Settings::Key::General_MaxPlayers)) + (" Clients"));
+    if (Shard == 0) {
+        Application::SetSubsystemStatus("UDPNetwork", Application::Status::Good);
+        beammp_info(("Vehicle data network online on ") + Application::Settings.getAsString(Settings::Key::General_Ip)
+            + " on port " + std::to_string(Application::Settings.getAsInt(Settings::Key::General_Port)) + (" with a Max of ")
+            + std::to_string(Application::Settings.getAsInt(Settings::Key::General_MaxPlayers)) + (" Clients"));
+        if (mUDPSockets.size() > 1) {
+            beammp_infof("Vehicle data is received on {} threads", mUDPSockets.size());
+        }
+    }
+#ifdef BEAMMP_LINUX
+    TUDPRecvBatch Batch;
+    bool UseBatch = true;
+#endif
     while (!Application::IsShuttingDown()) {
         try {
-            ip::udp::endpoint client {};
-            std::vector<uint8_t> Data = UDPRcvFromClient(client); // Receives any data from Socket
-            auto Pos = std::find(Data.begin(), Data.end(), ':');
-            if (Data.empty() || Pos > Data.begin() + 2)
-                continue;
-            uint8_t ID = uint8_t(Data.at(0)) - 1;
-            mServer.ForEachClient([&](std::weak_ptr<TClient> ClientPtr) -> bool {
-                std::shared_ptr<TClient> Client;
-                {
-                    ReadLock Lock(mServer.GetClientMutex());
-                    if (!ClientPtr.expired()) {
-                        Client = ClientPtr.lock();
-                    } else
-                        return true;
+#ifdef BEAMMP_LINUX
+            if (UseBatch) {
+                int Count = Batch.Receive(Socket.native_handle());
+                if (Count < 0) {
+                    if (errno == ENOSYS) {
+                        beammp_debug("recvmmsg() is not supported, falling back to one datagram per receive");
+                        UseBatch = false;
+                    } else if (errno != EINTR) {
+                        beammp_errorf("UDP recvmmsg() failed: {}", std::strerror(errno));
+                    }
+                    continue;
                 }
-
-                if (Client->GetID() == ID) {
-                    Client->SetUDPAddr(client);
-                    Client->SetIsConnected(true);
-                    Data.erase(Data.begin(), Data.begin() + 2);
-                    mServer.GlobalParser(ClientPtr, std::move(Data), mPPSMonitor, *this);
+                for (int i = 0; i < Count; ++i) {
+                    // one bad datagram must not cost the others in this batch
+                    try {
+                        if (Batch.Truncated(size_t(i))) {
+                            mStats.UDPTruncated.fetch_add(1, std::memory_order_relaxed);
+                            continue;
+                        }
+                        ip::udp::endpoint ClientEndpoint {};
+                        auto Data = Batch.Take(size_t(i), ClientEndpoint);
+                        HandleUDPDatagram(ClientEndpoint, std::move(Data));
+                    } catch (const std::exception& e) {
+                        beammp_error(("fatal: ") + std::string(e.what()));
+                    }
                 }
-
-                return true;
-            });
+                continue;
+            }
+#endif
+            ip::udp::endpoint client {};
+            std::vector<uint8_t> Data = UDPRcvFromClient(Socket, client); // Receives any data from Socket
+            HandleUDPDatagram(client, std::move(Data));
         } catch (const std::exception& e) {
             beammp_error(("fatal: ") + std::string(e.what()));
         }
     }
 }
 
+void TNetwork::HandleUDPDatagram(const ip::udp::endpoint& ClientEndpoint, std::vector<uint8_t>&& Data) {
+    auto Pos = std::find(Data.begin(), Data.end(), ':');
+    if (Data.empty() || Pos > Data.begin() + 2)
+        return;
+    const int ID = int(uint8_t(Data.at(0))) - 1;
+    auto Client = mServer.GetClientByUDPEndpoint(ClientEndpoint);
+    if (Client) {
+        if (Client->GetID() != ID) {
+            // known endpoint, but claims to be someone else
+            mStats.UDPRejected.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    } else {
+        Client = mServer.GetClientByID(ID);
+        if (!Client || Client->IsDisconnected()) {
+            mStats.UDPRejected.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        // first datagram from this endpoint. We only accept it if it comes from the same
+        // address as the client's TCP connection, so nobody can hijack another player's ID.
+        const auto& TCPAddress = Client->GetTCPAddress();
+        if (TCPAddress.is_unspecified() || TCPAddress != ClientEndpoint.address()) {
+            beammp_debugf("Rejected UDP packet for client {} from unexpected address {}", ID, ClientEndpoint.address().to_string());
+            mStats.UDPRejected.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        mServer.BindUDPEndpoint(Client, ClientEndpoint);
+    }
+    Data.erase(Data.begin(), Data.begin() + 2);
+    try {
+        Data = Compression::DecompressPacket(std::move(Data), &Client->DecompressionBudget(), &Client->Codec());
+    } catch (const std::exception& e) {
+        // same as on TCP, otherwise broken packets could be sent endlessly
+        beammp_warnf("Client {} ({}) sent a UDP packet which failed to decompress: {}", Client->GetName(), Client->GetID(), e.what());
+        ClientKick(*Client, "Invalid packet");
+        return;
+    }
+    mServer.GlobalParser(Client, std::move(Data), mPPSMonitor, *this);
+    Compression::BufferPool().Release(std::move(Data));
+}
+
 void TNetwork::TCPServerMain() {
     RegisterThread("TCPServer");
 
@@ -192,9 +755,12 @@ void TNetwork::TCPServerMain() {
                 }else
                     beammp_errorf("failed to accept: {}", ec.message());
             } else {
-                TConnection Conn { std::move(ClientSocket), ClientEp };
-                std::thread ID(&TNetwork::Identify, this, std::move(Conn));
-                ID.detach(); // TODO: Add to a queue and attempt to join periodically
+                // std::function needs to be copyable
+                auto Conn = std::make_shared<TConnection>(TConnection { std::move(ClientSocket), ClientEp });
+                if (!mHandshakes->Submit([this, Conn] { Identify(std::move(*Conn)); })) {
+                    beammp_debugf("Too many pending handshakes, closing connection from {}", ClientEp.address().to_string());
+                    Conn->Socket.close(ec);
+                }
             }
 
         } catch (const std::exception& e) {
@@ -208,21 +774,30 @@ void TNetwork::TCPServerMain() {
 #include "Json.h"
 namespace json = rapidjson;
 
+THandshakeExecutor::TDeadline TNetwork::HandshakeDeadline(ip::tcp::socket& Socket) {
+    return mHandshakes->Arm(mHandshakeTimeout, [&Socket] {
+        // wakes up the blocked read, which then fails
+        boost::system::error_code ec;
+        Socket.shutdown(socket_base::shutdown_both, ec);
+    });
+}
+
 void TNetwork::Identify(TConnection&& RawConnection) {
-    RegisterThreadAuto();
     char Code;
 
     boost::system::error_code ec;
-    read(RawConnection.Socket, buffer(&Code, 1), ec);
+    {
+        auto Deadline = HandshakeDeadline(RawConnection.Socket);
+        read(RawConnection.Socket, buffer(&Code, 1), ec);
+    }
     if (ec) {
         // TODO: is this right?!
         RawConnection.Socket.shutdown(socket_base::shutdown_both, ec);
         return;
     }
-    std::shared_ptr<TClient> Client { nullptr };
     try {
         if (Code == 'C') {
-            Client = Authentication(std::move(RawConnection));
+            Authentication(std::move(RawConnection));
         } else if (Code == 'D') {
             HandleDownload(std::move(RawConnection));
         } else if (Code == 'P') {
@@ -249,7 +824,10 @@ void TNetwork::Identify(TConnection&& RawConnection) {
 void TNetwork::HandleDownload(TConnection&& Conn) {
     char D;
     boost::system::error_code ec;
-    read(Conn.Socket, buffer(&D, 1), ec);
+    {
+        auto Deadline = HandshakeDeadline(Conn.Socket);
+        read(Conn.Socket, buffer(&D, 1), ec);
+    }
     if (ec) {
         Conn.Socket.shutdown(socket_base::shutdown_both, ec);
         // ignore ec
@@ -277,14 +855,23 @@ std::string HashPassword(const std::string& str) {
     return ret.str();
 }
 
-std::shared_ptr<TClient> TNetwork::Authentication(TConnection&& RawConnection) {
+void TNetwork::Authentication(TConnection&& RawConnection) {
     auto Client = CreateClient(std::move(RawConnection.Socket));
     Client->SetIdentifier("ip", RawConnection.SockAddr.address().to_string());
     beammp_tracef("This thread is ip {}", RawConnection.SockAddr.address().to_string());
 
     beammp_info("Identifying new ClientConnection...");
 
-    auto Data = TCPRcv(*Client);
+    std::vector<uint8_t> Data;
+    {
+        auto Deadline = HandshakeDeadline(Client->GetTCPSock());
+        Data = TCPRcv(*Client);
+        if (Deadline.Expired()) {
+            beammp_debugf("Client from {} didn't send its version in time", RawConnection.SockAddr.address().to_string());
+            Client->Disconnect("Handshake timed out");
+            return;
+        }
+    }
 
     constexpr std::string_view VC = "VC";
     if (Data.size() > 3 && std::equal(Data.begin(), Data.begin() + VC.size(), VC.begin(), VC.end())) {
@@ -294,72 +881,71 @@ std::shared_ptr<TClient> TNetwork::Authentication(TConnection&& RawConnection) {
             beammp_errorf("Client tried to connect with version '{}', but only versions '{}.x.x' is allowed",
                 ClientVersion.AsString(), Application::ClientMajorVersion());
             ClientKick(*Client, "Outdated Version!");
-            return nullptr;
+            return;
         }
     } else {
         ClientKick(*Client, fmt::format("Invalid version header: '{}' ({})", std::string(reinterpret_cast<const char*>(Data.data()), Data.size()), Data.size()));
-        return nullptr;
+        return;
     }
 
     if (!TCPSend(*Client, StringToVector("A"))) { // changed to A for Accepted version
         // TODO: handle
     }
 
-    Data = TCPRcv(*Client);
+    {
+        auto Deadline = HandshakeDeadline(Client->GetTCPSock());
+        Data = TCPRcv(*Client);
+        if (Deadline.Expired()) {
+            beammp_debugf("Client from {} didn't send its key in time", RawConnection.SockAddr.address().to_string());
+            Client->Disconnect("Handshake timed out");
+            return;
+        }
+    }
 
     if (Data.size() > 50) {
         ClientKick(*Client, "Invalid Key (too long)!");
-        return nullptr;
+        return;
     }
 
     std::string Key(reinterpret_cast<const char*>(Data.data()), Data.size());
-    std::string AuthKey = Application::Settings.getAsString(Settings::Key::General_AuthKey);
     std::string ClientIp = Client->GetIdentifiers().at("ip");
 
-    nlohmann::json AuthReq {};
-    std::string AuthResStr {};
-    try {
-        AuthReq = nlohmann::json {
-            { "key", Key },
-            { "auth_key", AuthKey },
-            { "client_ip", ClientIp }
-        };
-
-        auto Target = "/pkToUser";
-
-        unsigned int ResponseCode = 0;
-        AuthResStr = Http::POST(Application::GetBackendUrlForAuth(), 443, Target, AuthReq.dump(), "application/json", &ResponseCode);
-
-    } catch (const std::exception& e) {
-        beammp_debugf("Invalid json sent by client, kicking: {}", e.what());
-        ClientKick(*Client, "Invalid Key (invalid UTF8 string)!");
-        return nullptr;
-    }
-
-    try {
-        nlohmann::json AuthRes = nlohmann::json::parse(AuthResStr);
-
-        if (AuthRes["username"].is_string() && AuthRes["roles"].is_string()
-            && AuthRes["guest"].is_boolean() && AuthRes["identifiers"].is_array()) {
-
-            Client->SetName(AuthRes["username"]);
-            Client->SetRoles(AuthRes["roles"]);
-            Client->SetIsGuest(AuthRes["guest"]);
-            for (const auto& ID : AuthRes["identifiers"]) {
-                auto Raw = std::string(ID);
-                auto SepIndex = Raw.find(':');
-                Client->SetIdentifier(Raw.substr(0, SepIndex), Raw.substr(SepIndex + 1));
+    // the request runs on the auth workers, and this worker is free for other handshakes
+    // until the answer is posted back. Whichever comes first, the answer or the deadline, wins.
+    auto Answered = std::make_shared<std::atomic<bool>>(false);
+    auto Deadline = std::make_shared<THandshakeExecutor::TDeadline>(mHandshakes->Arm(mHandshakeTimeout,
+        [Answered, Weak = std::weak_ptr<TClient>(Client), ClientIp] {
+            if (Answered->exchange(true)) {
+                return;
             }
-        } else {
-            beammp_error("Invalid authentication data received from authentication backend");
-            ClientKick(*Client, "Invalid authentication data!");
-            return nullptr;
+            beammp_warnf("Authentication of a client from {} timed out", ClientIp);
+            if (auto Locked = Weak.lock()) {
+                boost::system::error_code ec;
+                Locked->GetTCPSock().shutdown(socket_base::shutdown_both, ec);
+            }
+        }));
+    mAuth->Authenticate({ Key, ClientIp }, [this, Client, Answered, Deadline](const TAuthResult& AuthResult) {
+        // waits for an expiring deadline, so the socket isn't used by both
+        Deadline->Disarm();
+        if (Answered->exchange(true)) {
+            return;
         }
-    } catch (const std::exception& e) {
-        beammp_errorf("Client sent invalid key. Error was: {}", e.what());
-        // TODO: we should really clarify that this was a backend response or parsing error
-        ClientKick(*Client, "Invalid key! Please restart your game.");
-        return nullptr;
+        if (!mHandshakes->Resume([this, Client, AuthResult] { FinishAuthentication(Client, AuthResult); })) {
+            Client->Disconnect("Server shutting down");
+        }
+    });
+}
+
+void TNetwork::FinishAuthentication(const std::shared_ptr<TClient>& Client, const TAuthResult& AuthResult) {
+    if (!AuthResult.Identity) {
+        ClientKick(*Client, AuthResult.Error);
+        return;
+    }
+    Client->SetName(AuthResult.Identity->Username);
+    Client->SetRoles(AuthResult.Identity->Roles);
+    Client->SetIsGuest(AuthResult.Identity->Guest);
+    for (const auto& [IDKey, IDValue] : AuthResult.Identity->Identifiers) {
+        Client->SetIdentifier(IDKey, IDValue);
     }
 
     beammp_debug("Name -> " + Client->GetName() + ", Guest -> " + std::to_string(Client->IsGuest()) + ", Roles -> " + Client->GetRoles());
@@ -403,21 +989,26 @@ std::shared_ptr<TClient> TNetwork::Authentication(TConnection&& RawConnection) {
 
     if (NotAllowed) {
         ClientKick(*Client, "you are not allowed on the server!");
-        return {};
+        return;
     } else if (NotAllowedWithReason) {
         ClientKick(*Client, Reason);
-        return {};
+        return;
     }
 
     if (mServer.ClientCount() < size_t(Application::Settings.getAsInt(Settings::Key::General_MaxPlayers))) {
         beammp_info("Identification success");
         mServer.InsertClient(Client);
-        TCPClient(Client);
+        if (mAsyncIO) {
+            // returns right away, the IO threads take over
+            TCPClient(Client);
+        } else {
+            // the blocking session would hold on to the handshake worker for as long as the player is connected
+            std::thread Session(&TNetwork::TCPClient, this, std::weak_ptr<TClient>(Client));
+            Session.detach();
+        }
     } else {
         ClientKick(*Client, "Server full!");
     }
-
-    return Client;
 }
 
 std::shared_ptr<TClient> TNetwork::CreateClient(ip::tcp::socket&& TCPSock) {
@@ -426,19 +1017,36 @@ std::shared_ptr<TClient> TNetwork::CreateClient(ip::tcp::socket&& TCPSock) {
 }
 
 bool TNetwork::TCPSend(TClient& c, const std::vector<uint8_t>& Data, bool IsSync) {
+    if (c.IsAsync() || (!IsSync && c.IsSyncing())) {
+        // the data has to outlive this call
+        return TCPSend(c, TSharedBuffer(Data), IsSync);
+    }
+    return TCPWriteFrame(c, Data.data(), Data.size());
+}
+
+bool TNetwork::TCPSend(TClient& c, const TSharedBuffer& Data, bool IsSync) {
     if (!IsSync) {
         if (c.IsSyncing()) {
             if (!Data.empty()) {
                 if (Data.at(0) == 'O' || Data.at(0) == 'A' || Data.at(0) == 'C' || Data.at(0) == 'E') {
-                    c.EnqueuePacket(Data);
+                    c.EnqueuePacket(Data, SupersedeKeyOf(Data));
                 }
             }
             return true;
         }
     }
 
-    auto& Sock = c.GetTCPSock();
+    if (c.IsAsync()) {
+        if (c.IsDisconnected()) {
+            return false;
+        }
+        AsyncWrite(c.shared_from_this(), Data);
+        return true;
+    }
+    return TCPWriteFrame(c, Data.data(), Data.size());
+}
 
+bool TNetwork::TCPWriteFrame(TClient& c, const uint8_t* Data, size_t DataSize) {
     /*
      * our TCP protocol sends a header of 4 bytes, followed by the data.
      *
@@ -447,73 +1055,112 @@ bool TNetwork::TCPSend(TClient& c, const std::vector<uint8_t>& Data, bool IsSync
      *    size    data
      */
 
-    const auto Size = int32_t(Data.size());
-    std::vector<uint8_t> ToSend;
-    ToSend.resize(Data.size() + sizeof(Size));
-    std::memcpy(ToSend.data(), &Size, sizeof(Size));
-    std::memcpy(ToSend.data() + sizeof(Size), Data.data(), Data.size());
+    const auto Size = int32_t(DataSize);
+    auto& Sock = c.GetTCPSock();
+    // header and data are written with one vectored write, without copying them together
+    const std::array<const_buffer, 2> Buffers { buffer(&Size, sizeof(Size)), buffer(Data, DataSize) };
     boost::system::error_code ec;
-    write(Sock, buffer(ToSend), ec);
+    write(Sock, Buffers, ec);
     if (ec) {
         beammp_debugf("write(): {}", ec.message());
         c.Disconnect("write() failed");
         return false;
     }
+    mStats.TCPFramesSent.fetch_add(1, std::memory_order_relaxed);
+    mStats.TCPWrites.fetch_add(1, std::memory_order_relaxed);
+    mStats.TCPCopyBytesSaved.fetch_add(DataSize + sizeof(Size), std::memory_order_relaxed);
     c.UpdatePingTime();
     return true;
 }
 
-std::vector<uint8_t> TNetwork::TCPRcv(TClient& c) {
-    if (c.IsDisconnected()) {
-        beammp_error("Client disconnected, cancelling TCPRcv");
-        return {};
+bool TNetwork::TCPSendBatch(TClient& c, const std::vector<TSharedBuffer>& Packets) {
+    if (Packets.empty()) {
+        return true;
+    }
+    if (c.IsAsync()) {
+        for (const auto& Packet : Packets) {
+            if (!TCPSend(c, Packet, true)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    // same framing as TCPSend, but all frames go out in a single write
+    std::vector<int32_t> Headers;
+    Headers.reserve(Packets.size());
+    std::vector<const_buffer> Buffers;
+    Buffers.reserve(Packets.size() * 2);
+    size_t TotalSize = 0;
+    for (const auto& Packet : Packets) {
+        Headers.push_back(int32_t(Packet.size()));
+        Buffers.push_back(buffer(&Headers.back(), sizeof(int32_t)));
+        Buffers.push_back(buffer(Packet.data(), Packet.size()));
+        TotalSize += sizeof(int32_t) + Packet.size();
     }
-
-    int32_t Header {};
-    auto& Sock = c.GetTCPSock();
-
     boost::system::error_code ec;
-    std::array<uint8_t, sizeof(Header)> HeaderData;
-    read(Sock, buffer(HeaderData), ec);
+    write(c.GetTCPSock(), Buffers, ec);
     if (ec) {
-        // TODO: handle this case (read failed)
-        beammp_debugf("TCPRcv: Reading header failed: {}", ec.message());
-        return {};
+        beammp_debugf("write(): {}", ec.message());
+        c.Disconnect("write() failed");
+        return false;
     }
-    Header = *reinterpret_cast<int32_t*>(HeaderData.data());
+    mStats.TCPFramesSent.fetch_add(Packets.size(), std::memory_order_relaxed);
+    mStats.TCPWrites.fetch_add(1, std::memory_order_relaxed);
+    mStats.TCPCopyBytesSaved.fetch_add(TotalSize, std::memory_order_relaxed);
+    c.UpdatePingTime();
+    return true;
+}
 
-    if (Header < 0) {
+bool TNetwork::CheckFrame(TClient& c, TFrameReader::TStatus Status) {
+    switch (Status) {
+    case TFrameReader::TStatus::NegativeSize:
         ClientKick(c, "Invalid packet - header negative");
         beammp_errorf("Client {} send negative TCP header, ignoring packet", c.GetID());
+        return false;
+    case TFrameReader::TStatus::TooLarge:
+        ClientKick(c, "Header size limit exceeded");
+        beammp_warnf("Client {} ({}) sent a header of more than {} MB (Network.ReceiveQuotaMB) - assuming malicious intent and disconnecting the client.",
+            c.GetName(), c.GetID(), c.FrameReader().Quota() / MB);
+        return false;
+    default:
+        return true;
+    }
+}
+
+std::vector<uint8_t> TNetwork::TCPRcv(TClient& c) {
+    if (c.IsDisconnected()) {
+        beammp_error("Client disconnected, cancelling TCPRcv");
         return {};
     }
 
+    auto& Sock = c.GetTCPSock();
+    auto& Reader = c.FrameReader();
     std::vector<uint8_t> Data;
-    // TODO: This is arbitrary, this needs to be handled another way
-    if (Header < int32_t(100 * MB)) {
-        Data.resize(Header);
-    } else {
-        ClientKick(c, "Header size limit exceeded");
-        beammp_warn("Client " + c.GetName() + " (" + std::to_string(c.GetID()) + ") sent header of >100MB - assuming malicious intent and disconnecting the client.");
-        return {};
+    TFrameReader::TStatus Status;
+    // usually, the packet was already read together with the previous one(s)
+    while ((Status = Reader.Next(Data)) == TFrameReader::TStatus::NeedMore) {
+        boost::system::error_code ec;
+        const auto Space = Reader.WritableSpace();
+        const auto N = Sock.read_some(buffer(Space.data(), Space.size()), ec);
+        if (ec) {
+            // TODO: handle this case (read failed)
+            beammp_debugf("TCPRcv: Reading failed: {}", ec.message());
+            return {};
+        }
+        Reader.Commit(N);
+        mStats.TCPReads.fetch_add(1, std::memory_order_relaxed);
     }
-    auto N = read(Sock, buffer(Data), ec);
-    if (ec) {
-        // TODO: handle this case properly
-        beammp_debugf("TCPRcv: Reading data failed: {}", ec.message());
+    if (!CheckFrame(c, Status)) {
         return {};
     }
+    mStats.TCPFramesReceived.fetch_add(1, std::memory_order_relaxed);
 
-    if (N != Header) {
-        beammp_errorf("Expected to read {} bytes, instead got {}", Header, N);
-    }
-
-    constexpr std::string_view ABG = "ABG:";
-    if (Data.size() >= ABG.size() && std::equal(Data.begin(), Data.begin() + ABG.size(), ABG.begin(), ABG.end())) {
-        Data.erase(Data.begin(), Data.begin() + ABG.size());
-        return DeComp(Data);
-    } else {
-        return Data;
+    try {
+        return Compression::DecompressPacket(std::move(Data), &c.DecompressionBudget(), &c.Codec());
+    } catch (const std::exception& e) {
+        beammp_warnf("Client {} ({}) sent a packet which failed to decompress: {}", c.GetName(), c.GetID(), e.what());
+        ClientKick(c, "Invalid packet");
+        return {};
     }
 }
 
@@ -527,36 +1174,25 @@ void TNetwork::ClientKick(TClient& c, const std::string& R) {
 
 void TNetwork::Looper(const std::weak_ptr<TClient>& c) {
     RegisterThreadAuto();
+    std::vector<TSharedBuffer> Batch;
     while (!c.expired()) {
         auto Client = c.lock();
+        // read before checking the state, so that a notify in between isn't missed
+        auto Seen = Client->OutboundSignal();
         if (Client->IsDisconnected()) {
             beammp_debug("client is disconnected, breaking client loop");
             break;
         }
-        if (!Client->IsSyncing() && Client->IsSynced() && Client->MissedPacketQueueSize() != 0) {
-            // debug("sending " + std::to_string(Client->MissedPacketQueueSize()) + " queued packets");
-            while (Client->MissedPacketQueueSize() > 0) {
-                std::vector<uint8_t> QData {};
-                { // locked context
-                    std::unique_lock lock(Client->MissedPacketQueueMutex());
-                    if (Client->MissedPacketQueueSize() <= 0) {
-                        break;
-                    }
-                    QData = Client->MissedPacketQueue().front();
-                    Client->MissedPacketQueue().pop();
-                } // end locked context
-                // beammp_debug("sending a missed packet: " + QData);
-                if (!TCPSend(*Client, QData, true)) {
-                    Client->Disconnect("Failed to TCPSend while clearing the missed packet queue");
-                    std::unique_lock lock(Client->MissedPacketQueueMutex());
-                    while (!Client->MissedPacketQueue().empty()) {
-                        Client->MissedPacketQueue().pop();
-                    }
-                    break;
-                }
+        if (!Client->IsSyncing() && Client->IsSynced() && !Client->MissedPacketQueue().Empty()) {
+            Batch.clear();
+            Client->DrainMissedPackets(Batch, MaxOutboundBatch);
+            if (!TCPSendBatch(*Client, Batch)) {
+                Client->Disconnect("Failed to TCPSend while clearing the missed packet queue");
+                Client->MissedPacketQueue().Clear();
             }
         } else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            // sleeps until something is enqueued, the sync state changes or the client disconnects
+            Client->WaitForOutbound(Seen);
         }
     }
 }
@@ -570,6 +1206,21 @@ void TNetwork::TCPClient(const std::weak_ptr<TClient>& c) {
     OnConnect(c);
     RegisterThread("(" + std::to_string(c.lock()->GetID()) + ") \"" + c.lock()->GetName() + "\"");
 
+    if (mAsyncIO) {
+        // from here on, the client is driven entirely by the IO thread pool,
+        // and this thread is no longer needed.
+        if (c.expired()) {
+            return;
+        }
+        auto Client = c.lock();
+        if (Client->IsDisconnected()) {
+            OnDisconnect(c);
+            return;
+        }
+        StartAsyncClient(Client);
+        return;
+    }
+
     std::thread QueueSync(&TNetwork::Looper, this, c);
 
     while (true) {
@@ -588,6 +1239,8 @@ void TNetwork::TCPClient(const std::weak_ptr<TClient>& c) {
             break;
         }
         mServer.GlobalParser(c, std::move(res), mPPSMonitor, *this);
+        // whatever the parser didn't take over
+        Compression::BufferPool().Release(std::move(res));
     }
 
     if (QueueSync.joinable())
@@ -601,6 +1254,162 @@ void TNetwork::TCPClient(const std::weak_ptr<TClient>& c) {
     }
 }
 
+void TNetwork::StartAsyncClient(const std::shared_ptr<TClient>& c) {
+    std::weak_ptr<TClient> Weak = c;
+    c->MakeAsync([this, Weak] {
+        if (auto Client = Weak.lock()) {
+            post(Client->AsyncState().Strand, [this, Client] {
+                AsyncFlushMissedPackets(Client);
+            });
+        }
+    });
+    post(c->AsyncState().Strand, [this, c] {
+        AsyncFlushMissedPackets(c);
+        AsyncRead(c);
+    });
+}
+
+void TNetwork::AsyncRead(const std::shared_ptr<TClient>& c) {
+    auto& Reader = c->FrameReader();
+    while (true) {
+        std::vector<uint8_t> Data;
+        const auto Status = Reader.Next(Data);
+        if (Status == TFrameReader::TStatus::NeedMore) {
+            break;
+        }
+        if (!CheckFrame(*c, Status)) {
+            AsyncFinish(c, "Invalid header");
+            return;
+        }
+        mStats.TCPFramesReceived.fetch_add(1, std::memory_order_relaxed);
+        if (Data.empty()) {
+            // an empty packet is treated like a failed read, same as TCPClient does
+            AsyncFinish(c, "TCPRcv empty");
+            return;
+        }
+        try {
+            Data = Compression::DecompressPacket(std::move(Data), &c->DecompressionBudget(), &c->Codec());
+            mServer.GlobalParser(c, std::move(Data), mPPSMonitor, *this);
+            Compression::BufferPool().Release(std::move(Data));
+        } catch (const std::exception& e) {
+            beammp_errorf("Failed to handle packet from client {}: {}", c->GetID(), e.what());
+            AsyncFinish(c, "Packet handling failed");
+            return;
+        }
+        if (c->IsDisconnected()) {
+            AsyncFinish(c, "Client disconnected");
+            return;
+        }
+    }
+    const auto Space = Reader.WritableSpace();
+    c->GetTCPSock().async_read_some(buffer(Space.data(), Space.size()),
+        bind_executor(c->AsyncState().Strand, [this, c](const boost::system::error_code& ec, size_t N) {
+            if (ec) {
+                beammp_debugf("TCP read failed: {}", ec.message());
+                AsyncFinish(c, "TCP read failed");
+                return;
+            }
+            c->FrameReader().Commit(N);
+            mStats.TCPReads.fetch_add(1, std::memory_order_relaxed);
+            AsyncRead(c);
+        }));
+}
+
+void TNetwork::AsyncWrite(const std::shared_ptr<TClient>& c, const TSharedBuffer& Data) {
+    TAsyncClientState::TFrame Frame { {}, Data };
+    const auto Size = int32_t(Data.size());
+    std::memcpy(Frame.Header.data(), &Size, sizeof(Size));
+    // dispatch runs inline if we're already in the strand, which keeps the packet order
+    // intact for packets sent from within packet handlers.
+    dispatch(c->AsyncState().Strand, [this, c, Frame = std::move(Frame)]() mutable {
+        auto& State = c->AsyncState();
+        if (State.Finished || !c->GetTCPSock().is_open()) {
+            return;
+        }
+        State.WriteQueue.push_back(std::move(Frame));
+        if (!State.Writing) {
+            AsyncWriteNext(c);
+        }
+    });
+}
+
+void TNetwork::AsyncWriteNext(const std::shared_ptr<TClient>& c) {
+    auto& State = c->AsyncState();
+    State.InFlight.clear();
+    if (State.WriteQueue.empty()) {
+        State.Writing = false;
+        if (State.CloseAfterWrite) {
+            c->CloseSockets();
+        }
+        return;
+    }
+    State.Writing = true;
+    // everything that queued up while the last write was in progress goes out in one write
+    std::vector<const_buffer> Buffers;
+    size_t TotalSize = 0;
+    while (!State.WriteQueue.empty() && State.InFlight.size() < MaxOutboundBatch) {
+        State.InFlight.push_back(std::move(State.WriteQueue.front()));
+        State.WriteQueue.pop_front();
+        const auto& Frame = State.InFlight.back();
+        Buffers.push_back(buffer(Frame.Header));
+        Buffers.push_back(buffer(Frame.Data.data(), Frame.Data.size()));
+        TotalSize += Frame.Header.size() + Frame.Data.size();
+    }
+    mStats.TCPFramesSent.fetch_add(State.InFlight.size(), std::memory_order_relaxed);
+    mStats.TCPWrites.fetch_add(1, std::memory_order_relaxed);
+    mStats.TCPCopyBytesSaved.fetch_add(TotalSize, std::memory_order_relaxed);
+    async_write(c->GetTCPSock(), Buffers,
+        bind_executor(State.Strand, [this, c](const boost::system::error_code& ec, size_t) {
+            auto& State = c->AsyncState();
+            if (ec) {
+                beammp_debugf("async write(): {}", ec.message());
+                State.WriteQueue.clear();
+                State.InFlight.clear();
+                State.Writing = false;
+                c->CloseSockets();
+                return;
+            }
+            c->UpdatePingTime();
+            AsyncWriteNext(c);
+        }));
+}
+
+void TNetwork::AsyncFlushMissedPackets(const std::shared_ptr<TClient>& c) {
+    if (c->IsSyncing() || !c->IsSynced() || c->IsDisconnected()) {
+        return;
+    }
+    std::vector<TSharedBuffer> Batch;
+    while (c->DrainMissedPackets(Batch, MaxOutboundBatch) > 0) {
+        (void)TCPSendBatch(*c, Batch);
+        Batch.clear();
+    }
+}
+
+void TNetwork::AsyncFinish(const std::shared_ptr<TClient>& c, std::string_view Reason) {
+    auto& State = c->AsyncState();
+    if (State.Finished) {
+        return;
+    }
+    State.Finished = true;
+    if (!c->IsDisconnected()) {
+        c->Disconnect(Reason);
+    }
+    // OnDisconnect triggers lua events and broadcasts, which we don't want to do in
+    // the strand, as that would block other work on this client (and this IO thread).
+    // A few threads are shared by all disconnects, so a wave of them can't start a wave of threads.
+    std::weak_ptr<TClient> Weak = c;
+    post(*mDisconnectPool, [this, Weak] {
+        static thread_local bool Registered = false;
+        if (!Registered) {
+            RegisterThread("DisconnectHandler");
+            Registered = true;
+        }
+        if (!Weak.expired()) {
+            OnDisconnect(Weak);
+        }
+    });
+}
+
 void TNetwork::UpdatePlayer(TClient& Client) {
     std::string Packet = ("Ss") + std::to_string(mServer.ClientCount()) + "/" + std::to_string(Application::Settings.getAsInt(Settings::Key::General_MaxPlayers)) + ":";
     mServer.ForEachClient([&](const std::weak_ptr<TClient>& ClientPtr) -> bool {
@@ -643,35 +1452,20 @@ void TNetwork::OnDisconnect(const std::weak_ptr<TClient>& ClientPtr) {
     auto Futures = LuaAPI::MP::Engine->TriggerEvent("onPlayerDisconnect", "", c.GetID());
     LuaAPI::MP::Engine->WaitForAll(Futures);
     c.Disconnect("Already Disconnected (OnDisconnect)");
+    mPositionSnapshots.RemovePlayer(c.GetID());
+    mPositionDeltas.ForgetPlayer(c.GetID());
+    mServer.VehiclePositions().RemovePlayer(c.GetID());
     mServer.RemoveClient(ClientPtr);
 }
 
-int TNetwork::OpenID() {
-    std::unique_lock OpenIDLock(mOpenIDMutex);
-    int ID = 0;
-    bool found;
-    do {
-        found = true;
-        mServer.ForEachClient([&](const std::weak_ptr<TClient>& ClientPtr) -> bool {
-            ReadLock Lock(mServer.GetClientMutex());
-            if (!ClientPtr.expired()) {
-                auto c = ClientPtr.lock();
-                if (c->GetID() == ID) {
-                    found = false;
-                    ID++;
-                }
-            }
-            return true;
-        });
-    } while (!found);
-    return ID;
-}
-
 void TNetwork::OnConnect(const std::weak_ptr<TClient>& c) {
     beammp_assert(!c.expired());
     beammp_info("Client connected");
     auto LockedClient = c.lock();
-    LockedClient->SetID(OpenID());
+    if (mServer.AssignClientID(LockedClient) < 0) {
+        ClientKick(*LockedClient, "Server full!");
+        return;
+    }
     beammp_info("Assigned ID " + std::to_string(LockedClient->GetID()) + " to " + LockedClient->GetName());
     LuaAPI::MP::Engine->ReportErrors(LuaAPI::MP::Engine->TriggerEvent("onPlayerConnecting", "", LockedClient->GetID()));
     SyncResources(*LockedClient);
@@ -706,9 +1500,18 @@ void TNetwork::Parse(TClient& c, const std::vector<uint8_t>& Packet) {
     if (Packet.size() > 1)
         SubCode = Packet.at(1);
     switch (Code) {
-    case 'f':
-        SendFile(c, std::string(reinterpret_cast<const char*>(Packet.data() + 1), Packet.size() - 1));
+    case 'f': {
+        auto Request = ParseFileRequest(std::string_view(reinterpret_cast<const char*>(Packet.data() + 1), Packet.size() - 1));
+        if (!Request) {
+            beammp_warnf("Client {} sent an invalid file request", c.GetID());
+            if (!TCPSend(c, StringToVector("CO"))) {
+                c.Disconnect("Failed to send the file request error");
+            }
+            return;
+        }
+        SendFile(c, Request->Name, Request->Offset, Request->Length);
         return;
+    }
     case 'S':
         if (SubCode == 'R') {
             beammp_debug("Sending Mod Info");
@@ -716,7 +1519,15 @@ void TNetwork::Parse(TClient& c, const std::vector<uint8_t>& Packet) {
             if (ToSend.empty())
                 ToSend = "-";
             if (!TCPSend(c, StringToVector(ToSend))) {
-                // TODO: error
+                c.Disconnect("Failed to send the mod list");
+            }
+        } else if (SubCode == 'H') {
+            // SHA-256 of each mod, in the same order as the list above, for validating cached mods
+            std::string ToSend = mResourceManager.FileHashes();
+            if (ToSend.empty())
+                ToSend = "-";
+            if (!TCPSend(c, StringToVector(ToSend))) {
+                c.Disconnect("Failed to send the mod hashes");
             }
         }
         return;
@@ -725,12 +1536,12 @@ void TNetwork::Parse(TClient& c, const std::vector<uint8_t>& Packet) {
     }
 }
 
-void TNetwork::SendFile(TClient& c, const std::string& UnsafeName) {
+void TNetwork::SendFile(TClient& c, const std::string& UnsafeName, uint64_t Offset, std::optional<uint64_t> Length) {
     beammp_info(c.GetName() + " requesting : " + UnsafeName.substr(UnsafeName.find_last_of('/')));
 
     if (!fs::path(UnsafeName).has_filename()) {
         if (!TCPSend(c, StringToVector("CO"))) {
-            // TODO: handle
+            c.Disconnect("Failed to send the file request error");
         }
         beammp_warn("File " + UnsafeName + " is not a file!");
         return;
@@ -740,14 +1551,39 @@ void TNetwork::SendFile(TClient& c, const std::string& UnsafeName) {
 
     if (!std::filesystem::exists(FileName)) {
         if (!TCPSend(c, StringToVector("CO"))) {
-            // TODO: handle
+            c.Disconnect("Failed to send the file request error");
         }
         beammp_warn("File " + UnsafeName + " could not be accessed!");
         return;
     }
 
+    std::shared_ptr<const TMappedFile> File;
+    try {
+        File = mResourceManager.OpenMod(FileName);
+    } catch (const std::exception& e) {
+        beammp_errorf("Failed to open mod for download: {}", e.what());
+        if (!TCPSend(c, StringToVector("CO"))) {
+            c.Disconnect("Failed to send the file request error");
+        }
+        return;
+    }
+    if (Offset > File->Size() || (Length && *Length > File->Size() - Offset)) {
+        beammp_warnf("Client {} requested bytes {}+{} of {}, which only has {} bytes", c.GetID(), Offset, Length.value_or(0), UnsafeName, File->Size());
+        if (!TCPSend(c, StringToVector("CO"))) {
+            c.Disconnect("Failed to send the file request error");
+        }
+        return;
+    }
+    const uint64_t End = Length ? Offset + *Length : File->Size();
+    if (Offset > 0 || End < File->Size()) {
+        beammp_debugf("Client {} resumes the download of {} at byte {}", c.GetID(), UnsafeName, Offset);
+        mStats.DownloadsResumed.fetch_add(1, std::memory_order_relaxed);
+        mStats.DownloadBytesSkipped.fetch_add(File->Size() - (End - Offset), std::memory_order_relaxed);
+    }
+
     if (!TCPSend(c, StringToVector("AG"))) {
-        // TODO: handle
+        c.Disconnect("Failed to accept the file request");
+        return;
     }
 
     /// Wait for connections
@@ -764,16 +1600,17 @@ void TNetwork::SendFile(TClient& c, const std::string& UnsafeName) {
         return;
     }
 
-    size_t Size = size_t(std::filesystem::file_size(FileName)), MSize = Size / 2;
+    // the requested range is split in half, one for each socket
+    const uint64_t Middle = Offset + (End - Offset) / 2;
 
     std::thread SplitThreads[2] {
         std::thread([&] {
             RegisterThread("SplitLoad_0");
-            SplitLoad(c, 0, MSize, false, FileName);
+            SplitLoad(c, Offset, Middle, false, *File);
         }),
         std::thread([&] {
             RegisterThread("SplitLoad_1");
-            SplitLoad(c, MSize, Size, true, FileName);
+            SplitLoad(c, Middle, End, true, *File);
         })
     };
 
@@ -832,41 +1669,29 @@ const uint8_t* /* end ptr */ TNetwork::SendSplit(TClient& c, ip::tcp::socket& So
     }
 }
 
-void TNetwork::SplitLoad(TClient& c, size_t Sent, size_t Size, bool D, const std::string& Name) {
-    std::ifstream f(Name.c_str(), std::ios::binary);
-    uint32_t Split = 125 * MB;
-    std::vector<uint8_t> Data;
-    if (Size > Split)
-        Data.resize(Split);
-    else
-        Data.resize(Size);
-    ip::tcp::socket* TCPSock { nullptr };
-    if (D)
-        TCPSock = &c.GetDownSock();
-    else
-        TCPSock = &c.GetTCPSock();
-    while (!c.IsDisconnected() && Sent < Size) {
-        size_t Diff = Size - Sent;
-        if (Diff > Split) {
-            f.seekg(Sent, std::ios_base::beg);
-            f.read(reinterpret_cast<char*>(Data.data()), Split);
-            if (!TCPSendRaw(c, *TCPSock, Data.data(), Split)) {
-                if (!c.IsDisconnected())
-                    c.Disconnect("TCPSendRaw failed in mod download (1)");
-                break;
-            }
-            Sent += Split;
-        } else {
-            f.seekg(Sent, std::ios_base::beg);
-            f.read(reinterpret_cast<char*>(Data.data()), Diff);
-            if (!TCPSendRaw(c, *TCPSock, Data.data(), int32_t(Diff))) {
-                if (!c.IsDisconnected())
-                    c.Disconnect("TCPSendRaw failed in mod download (2)");
-                break;
-            }
-            Sent += Diff;
+void TNetwork::SplitLoad(TClient& c, size_t Sent, size_t Size, bool D, const TMappedFile& File) {
+    if (c.IsDisconnected() || Sent >= Size) {
+        return;
+    }
+    auto& Socket = D ? c.GetDownSock() : c.GetTCPSock();
+    // streams from the shared file, so memory use doesn't depend on the size of the mod
+    FileTransfer::TThrottle Throttle;
+    if (mDownloadBandwidth.IsLimited()) {
+        Throttle = [&](uint64_t Bytes) {
+            return !c.IsDisconnected() && mDownloadBandwidth.Acquire(Bytes);
+        };
+    }
+    auto Result = FileTransfer::SendRange(Socket, File, Sent, Size - Sent, Throttle, [&c] { return !c.IsDisconnected(); });
+    mStats.DownloadBytes.fetch_add(Result.ZeroCopyBytes + Result.CopiedBytes, std::memory_order_relaxed);
+    mStats.DownloadBytesZeroCopy.fetch_add(Result.ZeroCopyBytes, std::memory_order_relaxed);
+    if (!Result.Ok) {
+        beammp_errorf("Failed to send '{}' to client {}: {}", File.Path(), c.GetID(), Result.Error);
+        if (!c.IsDisconnected()) {
+            c.Disconnect(D ? "Mod download failed (download socket)" : "Mod download failed (TCP socket)");
         }
+        return;
     }
+    c.UpdatePingTime();
 }
 
 bool TNetwork::TCPSendRaw(TClient& C, ip::tcp::socket& socket, const uint8_t* Data, size_t Size) {
@@ -882,16 +1707,17 @@ bool TNetwork::TCPSendRaw(TClient& C, ip::tcp::socket& socket, const uint8_t* Da
 
 bool TNetwork::SendLarge(TClient& c, std::vector<uint8_t> Data, bool isSync) {
     if (Data.size() > 400) {
-        CompressProperly(Data);
+        CompressProperly(c.Codec(), Data);
     }
     return TCPSend(c, Data, isSync);
 }
 
-bool TNetwork::Respond(TClient& c, const std::vector<uint8_t>& MSG, bool Rel, bool isSync) {
+bool TNetwork::Respond(TClient& c, const TSharedBuffer& MSG, bool Rel, bool isSync) {
     char C = MSG.at(0);
     if (Rel || C == 'W' || C == 'Y' || C == 'V' || C == 'E' || compressBound(MSG.size()) > 1024) {
-        if (C == 'O' || C == 'T' || MSG.size() > 1000) {
-            return SendLarge(c, MSG, isSync);
+        if ((C == 'O' || C == 'T' || MSG.size() > 1000) && MSG.size() > 400) {
+            // same as SendLarge
+            return TCPSend(c, TSharedBuffer(CompressWithHeader(c.Codec(), { MSG.data(), MSG.size() })), isSync);
         } else {
             return TCPSend(c, MSG, isSync);
         }
@@ -951,15 +1777,46 @@ bool TNetwork::SyncClient(const std::weak_ptr<TClient>& c) {
         return res;
     }
     LockedClient->SetIsSynced(true);
+    LockedClient->NotifyOutbound();
     beammp_info(LockedClient->GetName() + (" is now synced!"));
     return true;
 }
 
-void TNetwork::SendToAll(TClient* c, const std::vector<uint8_t>& Data, bool Self, bool Rel) {
+void TNetwork::SendToAll(TClient* c, const TSharedBuffer& Data, bool Self, bool Rel, const TInterestManager::TRecipientSet* Recipients) {
     if (!Self)
         beammp_assert(c);
     char C = Data.at(0);
     bool ret = true;
+    const auto AllocationsBefore = TSharedBuffer::ThreadAllocationCount();
+    mStats.Broadcasts.fetch_add(1, std::memory_order_relaxed);
+    // compressed at most once per codec, the first time a recipient needs it, and then shared
+    std::vector<std::pair<const ICodec*, TSharedBuffer>> CompressedData;
+    auto Compressed = [&](const ICodec& Codec) -> const TSharedBuffer& {
+        for (const auto& [UsedCodec, Buffer] : CompressedData) {
+            if (UsedCodec == &Codec) {
+                return Buffer;
+            }
+        }
+        if (CompressedData.empty()) {
+            // references handed out earlier must stay valid
+            CompressedData.reserve(Compression::Codecs().size());
+        }
+        CompressedData.emplace_back(&Codec, TSharedBuffer(CompressWithHeader(Codec, { Data.data(), Data.size() })));
+        mStats.BroadcastCompressions.fetch_add(1, std::memory_order_relaxed);
+        return CompressedData.back().second;
+    };
+    std::optional<uint32_t> SupersedeKeyCache;
+    auto SupersedeKey = [&] {
+        if (!SupersedeKeyCache) {
+            SupersedeKeyCache = SupersedeKeyOf(Data);
+        }
+        return *SupersedeKeyCache;
+    };
+    std::vector<std::shared_ptr<TClient>> UDPRecipients;
+    // position updates for clients which support deltas, parsed at most once
+    std::optional<std::optional<TPositionDeltaEncoder::TPosition>> Position;
+    std::vector<std::shared_ptr<TClient>> DeltaRecipients;
+    std::vector<TSharedBuffer> Deltas;
     mServer.ForEachClient([&](std::weak_ptr<TClient> ClientPtr) -> bool {
         std::shared_ptr<TClient> Client;
         try {
@@ -970,36 +1827,73 @@ void TNetwork::SendToAll(TClient* c, const std::vector<uint8_t>& Data, bool Self
             beammp_warn("Client expired, shouldn't happen - if a client disconnected recently, you can ignore this");
             return true;
         }
+        if (!Client) {
+            return true;
+        }
+        if (Recipients && (Client->GetID() < 0 || !Recipients->test(size_t(Client->GetID())))) {
+            mStats.InterestFiltered.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
         if (Self || Client.get() != c) {
             if (Client->IsSynced() || Client->IsSyncing()) {
                 if (Rel || C == 'W' || C == 'Y' || C == 'V' || C == 'E' || compressBound(Data.size()) > 1024) {
                     if (C == 'O' || C == 'T' || Data.size() > 1000) {
                         if (Data.size() > 400) {
-                            auto CompressedData = Data;
-                            CompressProperly(CompressedData);
-                            Client->EnqueuePacket(CompressedData);
+                            Client->EnqueuePacket(Compressed(Client->Codec()), SupersedeKey());
                         } else {
-                            Client->EnqueuePacket(Data);
+                            Client->EnqueuePacket(Data, SupersedeKey());
                         }
                         // ret = SendLarge(*Client, Data);
                     } else {
-                        Client->EnqueuePacket(Data);
+                        Client->EnqueuePacket(Data, SupersedeKey());
                         // ret = TCPSend(*Client, Data);
                     }
+                } else if (C == 'Z' && mPositionDeltasEnabled && Client->HasCapability(TClient::CapPositionDeltas)) {
+                    if (!Position) {
+                        Position = TPositionDeltaEncoder::Parse(Data.AsStringView());
+                    }
+                    if (Position->has_value()) {
+                        Deltas.push_back(mPositionDeltas.Encode(Client->GetID(), Position->value()));
+                        DeltaRecipients.push_back(std::move(Client));
+                    } else {
+                        UDPRecipients.push_back(std::move(Client));
+                    }
                 } else {
-                    ret = UDPSend(*Client, Data);
+                    UDPRecipients.push_back(std::move(Client));
                 }
             }
         }
         return true;
     });
+    if (!UDPRecipients.empty()) {
+        // same rule as in UDPSend
+        if (Data.size() > 400) {
+            std::vector<TSharedBuffer> Payloads;
+            Payloads.reserve(UDPRecipients.size());
+            for (const auto& Recipient : UDPRecipients) {
+                Payloads.push_back(Compressed(Recipient->Codec()));
+            }
+            ret = UDPSendEach(UDPRecipients, Payloads);
+        } else {
+            ret = UDPSendToMany(UDPRecipients, Data);
+        }
+    }
+    if (!DeltaRecipients.empty()) {
+        for (const auto& Delta : Deltas) {
+            mStats.PositionDeltaBytesSaved.fetch_add(Data.size() - std::min(Data.size(), Delta.size()), std::memory_order_relaxed);
+        }
+        mStats.PositionDeltasSent.fetch_add(Deltas.size(), std::memory_order_relaxed);
+        ret = UDPSendEach(DeltaRecipients, Deltas) && ret;
+    }
+    // the buffer holding `Data` itself, plus everything allocated for this broadcast
+    mStats.BroadcastAllocations.fetch_add(1 + TSharedBuffer::ThreadAllocationCount() - AllocationsBefore, std::memory_order_relaxed);
     if (!ret) {
         // TODO: handle
     }
     return;
 }
 
-bool TNetwork::UDPSend(TClient& Client, std::vector<uint8_t> Data) {
+bool TNetwork::UDPSend(TClient& Client, const TSharedBuffer& Data) {
     if (!Client.IsConnected() || Client.IsDisconnected()) {
         // this can happen if we try to send a packet to a client that is either
         // 1. not yet fully connected, or
@@ -1007,12 +1901,17 @@ bool TNetwork::UDPSend(TClient& Client, std::vector<uint8_t> Data) {
         // this is fine can can be ignored :^)
         return true;
     }
-    const auto Addr = Client.GetUDPAddr();
     if (Data.size() > 400) {
-        CompressProperly(Data);
+        auto Compressed = CompressWithHeader(Client.Codec(), { Data.data(), Data.size() });
+        return UDPSendRaw(Client, Compressed.data(), Compressed.size());
     }
+    return UDPSendRaw(Client, Data.data(), Data.size());
+}
+
+bool TNetwork::UDPSendRaw(TClient& Client, const uint8_t* Data, size_t Size) {
+    const auto Addr = Client.GetUDPAddr();
     boost::system::error_code ec;
-    mUDPSock.send_to(buffer(Data), Addr, 0, ec);
+    UDPSocket().send_to(buffer(Data, Size), Addr, 0, ec);
     if (ec) {
         beammp_debugf("UDP sendto() failed: {}", ec.message());
         if (!Client.IsDisconnected())
@@ -1022,10 +1921,83 @@ bool TNetwork::UDPSend(TClient& Client, std::vector<uint8_t> Data) {
     return true;
 }
 
-std::vector<uint8_t> TNetwork::UDPRcvFromClient(ip::udp::endpoint& ClientEndpoint) {
+bool TNetwork::UDPSendToMany(const std::vector<std::shared_ptr<TClient>>& Clients, const TSharedBuffer& Data) {
+    return UDPSendEach(Clients, { Data });
+}
+
+bool TNetwork::UDPSendEach(const std::vector<std::shared_ptr<TClient>>& Clients, const std::vector<TSharedBuffer>& Payloads) {
+    beammp_assert(Payloads.size() == 1 || Payloads.size() == Clients.size());
+    auto PayloadOf = [&](size_t i) -> const TSharedBuffer& {
+        return Payloads.size() == 1 ? Payloads.front() : Payloads[i];
+    };
+#ifdef BEAMMP_LINUX
+    if (mSendmmsgSupported && Clients.size() > 1) {
+        std::vector<ip::udp::endpoint> Endpoints;
+        std::vector<TClient*> Recipients;
+        std::vector<iovec> Iovecs;
+        Endpoints.reserve(Clients.size());
+        Recipients.reserve(Clients.size());
+        Iovecs.reserve(Clients.size());
+        for (size_t i = 0; i < Clients.size(); ++i) {
+            const auto& Client = Clients[i];
+            // same as in UDPSend
+            if (Client->IsConnected() && !Client->IsDisconnected()) {
+                Endpoints.push_back(Client->GetUDPAddr());
+                Recipients.push_back(Client.get());
+                // a shared payload is only referenced, never copied
+                Iovecs.push_back(iovec { const_cast<uint8_t*>(PayloadOf(i).data()), PayloadOf(i).size() });
+            }
+        }
+        std::vector<mmsghdr> Messages(Endpoints.size());
+        for (size_t i = 0; i < Endpoints.size(); ++i) {
+            Messages[i].msg_hdr.msg_iov = &Iovecs[i];
+            Messages[i].msg_hdr.msg_iovlen = 1;
+            Messages[i].msg_hdr.msg_name = Endpoints[i].data();
+            Messages[i].msg_hdr.msg_namelen = socklen_t(Endpoints[i].size());
+        }
+        bool Ok = true;
+        size_t Offset = 0;
+        while (Offset < Messages.size()) {
+            int Sent = sendmmsg(UDPSocket().native_handle(), Messages.data() + Offset, unsigned(Messages.size() - Offset), 0);
+            if (Sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                } else if (errno == ENOSYS) {
+                    beammp_debug("sendmmsg() is not supported, falling back to one send per recipient");
+                    mSendmmsgSupported = false;
+                    for (; Offset < Messages.size(); ++Offset) {
+                        Ok = UDPSendRaw(*Recipients[Offset], static_cast<const uint8_t*>(Iovecs[Offset].iov_base), Iovecs[Offset].iov_len) && Ok;
+                    }
+                    break;
+                }
+                // the first message of the remaining ones failed, the rest may still be fine
+                beammp_debugf("UDP sendmmsg() failed: {}", std::strerror(errno));
+                if (!Recipients[Offset]->IsDisconnected())
+                    Recipients[Offset]->Disconnect("UDP send failed");
+                Ok = false;
+                ++Offset;
+            } else {
+                Offset += size_t(Sent);
+            }
+        }
+        return Ok;
+    }
+#endif
+    bool Ok = true;
+    for (size_t i = 0; i < Clients.size(); ++i) {
+        const auto& Client = Clients[i];
+        // same as in UDPSend
+        if (Client->IsConnected() && !Client->IsDisconnected()) {
+            Ok = UDPSendRaw(*Client, PayloadOf(i).data(), PayloadOf(i).size()) && Ok;
+        }
+    }
+    return Ok;
+}
+
+std::vector<uint8_t> TNetwork::UDPRcvFromClient(ip::udp::socket& Socket, ip::udp::endpoint& ClientEndpoint) {
     std::array<char, 1024> Ret {};
     boost::system::error_code ec;
-    const auto Rcv = mUDPSock.receive_from(mutable_buffer(Ret.data(), Ret.size()), ClientEndpoint, 0, ec);
+    const auto Rcv = Socket.receive_from(mutable_buffer(Ret.data(), Ret.size()), ClientEndpoint, 0, ec);
     if (ec) {
         beammp_errorf("UDP recvfrom() failed: {}", ec.message());
         return {};
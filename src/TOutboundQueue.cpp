@@ -0,0 +1,273 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "TOutboundQueue.h"
+
+#include <doctest/doctest.h>
+#include <thread>
+
+static size_t NextPowerOfTwo(size_t N) {
+    size_t Result = 1;
+    while (Result < N) {
+        Result <<= 1;
+    }
+    return Result;
+}
+
+TOutboundQueue::TOutboundQueue(size_t MaxPackets)
+    : mSlots(new Slot[NextPowerOfTwo(MaxPackets)])
+    , mMask(NextPowerOfTwo(MaxPackets) - 1) {
+    for (size_t i = 0; i <= mMask; ++i) {
+        mSlots[i].Sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool TOutboundQueue::Push(TSharedBuffer Packet, uint64_t Tag) {
+    // bounded queue as described by Dmitry Vyukov: a slot is free for the producer
+    // at position `Pos` if its sequence is `Pos`, and ready for the consumer if it's `Pos + 1`.
+    size_t Pos = mPushPos.load(std::memory_order_relaxed);
+    Slot* Target = nullptr;
+    while (true) {
+        Target = &mSlots[Pos & mMask];
+        const size_t Sequence = Target->Sequence.load(std::memory_order_acquire);
+        const auto Diff = intptr_t(Sequence) - intptr_t(Pos);
+        if (Diff == 0) {
+            if (mPushPos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (Diff < 0) {
+            // the consumer hasn't freed this slot yet, so we're full
+            return false;
+        } else {
+            Pos = mPushPos.load(std::memory_order_relaxed);
+        }
+    }
+    mBytes.fetch_add(Packet.size(), std::memory_order_relaxed);
+    mSize.fetch_add(1, std::memory_order_relaxed);
+    Target->Packet = std::move(Packet);
+    Target->Tag = Tag;
+    Target->Sequence.store(Pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool TOutboundQueue::Pop(TSharedBuffer& Out, uint64_t* Tag) {
+    Slot& Source = mSlots[mPopPos & mMask];
+    if (Source.Sequence.load(std::memory_order_acquire) != mPopPos + 1) {
+        // either empty, or the producer of this slot hasn't finished yet, in which
+        // case we'll get woken up again anyways.
+        return false;
+    }
+    Out = std::move(Source.Packet);
+    Source.Packet = {};
+    if (Tag) {
+        *Tag = Source.Tag;
+    }
+    Source.Sequence.store(mPopPos + mMask + 1, std::memory_order_release);
+    ++mPopPos;
+    mBytes.fetch_sub(Out.size(), std::memory_order_relaxed);
+    mSize.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+size_t TOutboundQueue::DrainInto(std::vector<TSharedBuffer>& Out, size_t Max) {
+    size_t Count = 0;
+    TSharedBuffer Packet;
+    while (Count < Max && Pop(Packet)) {
+        Out.push_back(std::move(Packet));
+        ++Count;
+    }
+    return Count;
+}
+
+void TOutboundQueue::Clear() {
+    TSharedBuffer Discard;
+    while (Pop(Discard)) { }
+}
+
+bool TSupersedeFilter::Push(TOutboundQueue& Queue, TSharedBuffer Packet, uint32_t Key) {
+    // pushing under the lock keeps the packets of a key in the order of their versions, and
+    // the version is only remembered once the packet is actually queued
+    std::unique_lock Lock(mMutex);
+    const auto Version = ++mNextVersion;
+    if (!Queue.Push(std::move(Packet), (uint64_t(Key) << 32) | Version)) {
+        return false;
+    }
+    mVersions[Key] = Version;
+    return true;
+}
+
+bool TSupersedeFilter::ShouldSend(uint64_t Tag) {
+    if (Tag == 0) {
+        return true;
+    }
+    const auto Key = uint32_t(Tag >> 32);
+    const auto Version = uint32_t(Tag);
+    std::unique_lock Lock(mMutex);
+    auto Iter = mVersions.find(Key);
+    if (Iter != mVersions.end() && Iter->second != Version) {
+        // a newer one is still in the queue
+        mSuperseded.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (Iter != mVersions.end()) {
+        mVersions.erase(Iter);
+    }
+    return true;
+}
+
+static TSharedBuffer MakePacket(std::vector<uint8_t> Data) {
+    return TSharedBuffer(std::move(Data));
+}
+
+TEST_CASE("TOutboundQueue keeps order and bound") {
+    TOutboundQueue Queue(3);
+    CHECK(Queue.MaxPackets() == 4);
+    CHECK(Queue.Empty());
+    CHECK(Queue.Push(MakePacket({ 1 })));
+    CHECK(Queue.Push(MakePacket({ 2, 2 })));
+    CHECK(Queue.Push(MakePacket({ 3, 3, 3 })));
+    CHECK(Queue.Push(MakePacket({ 4 })));
+    CHECK(!Queue.Push(MakePacket({ 5 })));
+    CHECK(Queue.Size() == 4);
+    CHECK(Queue.Bytes() == 7);
+
+    TSharedBuffer Packet;
+    CHECK(Queue.Pop(Packet));
+    CHECK(Packet.ToVector() == std::vector<uint8_t> { 1 });
+    // there's room again, and wrapping around works
+    CHECK(Queue.Push(MakePacket({ 5 })));
+
+    std::vector<TSharedBuffer> Batch;
+    CHECK(Queue.DrainInto(Batch, 10) == 4);
+    CHECK(Batch.at(0).ToVector() == std::vector<uint8_t> { 2, 2 });
+    CHECK(Batch.at(1).ToVector() == std::vector<uint8_t> { 3, 3, 3 });
+    CHECK(Batch.at(3).ToVector() == std::vector<uint8_t> { 5 });
+    CHECK(Queue.Empty());
+    CHECK(Queue.Bytes() == 0);
+    CHECK(!Queue.Pop(Packet));
+
+    uint64_t Tag = 0;
+    CHECK(Queue.Push(MakePacket({ 6 }), 42));
+    CHECK(Queue.Push(MakePacket({ 7 })));
+    CHECK(Queue.Pop(Packet, &Tag));
+    CHECK(Tag == 42);
+    CHECK(Queue.Pop(Packet, &Tag));
+    CHECK(Tag == 0);
+}
+
+TEST_CASE("TOutboundQueue multiple producers") {
+    constexpr size_t Producers = 4;
+    constexpr size_t PerProducer = 1000;
+    TOutboundQueue Queue(Producers * PerProducer);
+    std::vector<std::thread> Threads;
+    for (size_t i = 0; i < Producers; ++i) {
+        Threads.emplace_back([&Queue, i] {
+            for (size_t k = 0; k < PerProducer; ++k) {
+                CHECK(Queue.Push(MakePacket({ uint8_t(i), uint8_t(k % 256) })));
+            }
+        });
+    }
+    size_t Received = 0;
+    std::vector<size_t> CountPerProducer(Producers, 0);
+    TSharedBuffer Packet;
+    while (Received < Producers * PerProducer) {
+        if (Queue.Pop(Packet)) {
+            auto From = Packet.at(0);
+            // packets of a single producer must arrive in order
+            CHECK(Packet.at(1) == uint8_t(CountPerProducer.at(From) % 256));
+            ++CountPerProducer.at(From);
+            ++Received;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    for (auto& Thread : Threads) {
+        Thread.join();
+    }
+    CHECK(Queue.Empty());
+}
+
+TEST_CASE("TSupersedeFilter") {
+    SUBCASE("only the latest packet of a key is sent") {
+        TOutboundQueue Queue(8);
+        TSupersedeFilter Filter;
+        CHECK(Filter.Push(Queue, MakePacket({ 1 }), 7));
+        CHECK(Queue.Push(MakePacket({ 2 })));
+        CHECK(Filter.Push(Queue, MakePacket({ 3 }), 7));
+        CHECK(Filter.Push(Queue, MakePacket({ 4 }), 8));
+        std::vector<uint8_t> Sent;
+        TSharedBuffer Packet;
+        uint64_t Tag = 0;
+        while (Queue.Pop(Packet, &Tag)) {
+            if (Filter.ShouldSend(Tag)) {
+                Sent.push_back(Packet.at(0));
+            }
+        }
+        CHECK(Sent == std::vector<uint8_t> { 2, 3, 4 });
+        CHECK(Filter.Superseded() == 1);
+    }
+    SUBCASE("a packet which didn't fit doesn't supersede anything") {
+        TOutboundQueue Queue(2);
+        TSupersedeFilter Filter;
+        CHECK(Filter.Push(Queue, MakePacket({ 1 }), 7));
+        CHECK(Queue.Push(MakePacket({ 2 })));
+        CHECK(!Filter.Push(Queue, MakePacket({ 3 }), 7));
+        TSharedBuffer Packet;
+        uint64_t Tag = 0;
+        CHECK(Queue.Pop(Packet, &Tag));
+        CHECK(Filter.ShouldSend(Tag));
+    }
+    SUBCASE("concurrent producers never get an older packet sent after a newer one") {
+        constexpr size_t Producers = 4;
+        constexpr size_t PerProducer = 1000;
+        constexpr uint32_t Keys = 3;
+        TOutboundQueue Queue(Producers * PerProducer);
+        TSupersedeFilter Filter;
+        std::vector<std::thread> Threads;
+        for (size_t i = 0; i < Producers; ++i) {
+            Threads.emplace_back([&Queue, &Filter] {
+                for (size_t k = 0; k < PerProducer; ++k) {
+                    CHECK(Filter.Push(Queue, MakePacket({ 0 }), uint32_t(k % Keys) + 1));
+                }
+            });
+        }
+        std::vector<uint32_t> LastSent(Keys + 1, 0);
+        size_t Popped = 0;
+        TSharedBuffer Packet;
+        uint64_t Tag = 0;
+        while (Popped < Producers * PerProducer) {
+            if (!Queue.Pop(Packet, &Tag)) {
+                std::this_thread::yield();
+                continue;
+            }
+            ++Popped;
+            if (Filter.ShouldSend(Tag)) {
+                const auto Key = uint32_t(Tag >> 32);
+                CHECK(uint32_t(Tag) > LastSent.at(Key));
+                LastSent.at(Key) = uint32_t(Tag);
+            }
+        }
+        for (auto& Thread : Threads) {
+            Thread.join();
+        }
+        // the last packet of every key was sent
+        for (uint32_t Key = 1; Key <= Keys; ++Key) {
+            CHECK(LastSent.at(Key) > 0);
+        }
+    }
+}
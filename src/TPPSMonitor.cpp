@@ -79,12 +79,12 @@ void TPPSMonitor::operator()() {
             ClientToKick->Disconnect("Timeout");
         }
         TimedOutClients.clear();
-        if (C == 0 || mInternalPPS == 0) {
+        const int InternalPPS = mInternalPPS.exchange(0);
+        if (C == 0 || InternalPPS == 0) {
             Application::SetPPS("-");
         } else {
-            int R = (mInternalPPS / C) / V;
+            int R = (InternalPPS / C) / V;
             Application::SetPPS(std::to_string(R));
         }
-        mInternalPPS = 0;
     }
 }
@@ -0,0 +1,310 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "TPositionDeltaEncoder.h"
+
+#include <charconv>
+#include <cmath>
+#include <doctest/doctest.h>
+#include <vector>
+
+namespace {
+
+uint64_t VehicleKey(int PID, int VID) {
+    return (uint64_t(uint16_t(PID)) << 32) | uint64_t(uint32_t(VID));
+}
+
+void WriteVarint(std::vector<uint8_t>& Out, int64_t Value) {
+    auto ZigZag = (uint64_t(Value) << 1) ^ uint64_t(Value >> 63);
+    while (ZigZag >= 0x80) {
+        Out.push_back(uint8_t(ZigZag | 0x80));
+        ZigZag >>= 7;
+    }
+    Out.push_back(uint8_t(ZigZag));
+}
+
+bool ReadVarint(std::string_view& In, int64_t& Value) {
+    uint64_t ZigZag = 0;
+    for (unsigned Shift = 0; Shift < 64; Shift += 7) {
+        if (In.empty()) {
+            return false;
+        }
+        const auto Byte = uint8_t(In.front());
+        In.remove_prefix(1);
+        ZigZag |= uint64_t(Byte & 0x7f) << Shift;
+        if ((Byte & 0x80) == 0) {
+            Value = int64_t(ZigZag >> 1) ^ -int64_t(ZigZag & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// "PID-VID:" after the packet code
+bool ParsePidVid(std::string_view& In, int& PID, int& VID) {
+    auto [DashPtr, DashError] = std::from_chars(In.data(), In.data() + In.size(), PID);
+    if (DashError != std::errc() || DashPtr == In.data() + In.size() || *DashPtr != '-') {
+        return false;
+    }
+    In.remove_prefix(size_t(DashPtr - In.data()) + 1);
+    auto [ColonPtr, ColonError] = std::from_chars(In.data(), In.data() + In.size(), VID);
+    if (ColonError != std::errc() || ColonPtr == In.data() + In.size() || *ColonPtr != ':') {
+        return false;
+    }
+    In.remove_prefix(size_t(ColonPtr - In.data()) + 1);
+    return PID >= 0 && VID >= 0;
+}
+
+// all values of a position, in the order of TPositionDeltaEncoder::TState
+std::array<double*, TPositionDeltaEncoder::ValueCount> ValuesOf(TVehiclePosition& Position) {
+    auto& P = Position;
+    return { &P.Time, &P.Ping, &P.Pos[0], &P.Pos[1], &P.Pos[2], &P.Rot[0], &P.Rot[1], &P.Rot[2], &P.Rot[3],
+        &P.Vel[0], &P.Vel[1], &P.Vel[2], &P.RVel[0], &P.RVel[1], &P.RVel[2] };
+}
+
+}
+
+std::optional<TPositionDeltaEncoder::TPosition> TPositionDeltaEncoder::Parse(std::string_view Packet) {
+    TPosition Result;
+    if (Packet.substr(0, 3) != "Zp:") {
+        return std::nullopt;
+    }
+    Packet.remove_prefix(3);
+    if (!ParsePidVid(Packet, Result.PID, Result.VID)) {
+        return std::nullopt;
+    }
+    auto Position = TVehiclePosition::Parse(Packet);
+    if (!Position) {
+        return std::nullopt;
+    }
+    const auto Values = ValuesOf(Position.value());
+    for (size_t i = 0; i < ValueCount; ++i) {
+        const double Scaled = *Values[i] * Scales[i];
+        // keeps the deltas and the conversion back to double exact
+        if (std::abs(Scaled) > double(int64_t(1) << 52)) {
+            return std::nullopt;
+        }
+        Result.State[i] = std::llround(Scaled);
+    }
+    return Result;
+}
+
+TSharedBuffer TPositionDeltaEncoder::Encode(int RecipientPID, const TPosition& Position) {
+    std::vector<uint8_t> Out;
+    Out.reserve(16 + ValueCount * 4);
+    const auto Header = "Zd:" + std::to_string(Position.PID) + "-" + std::to_string(Position.VID) + ":";
+    Out.insert(Out.end(), Header.begin(), Header.end());
+
+    std::unique_lock Lock(mMutex);
+    auto [Iter, Inserted] = mKeyframes.try_emplace((uint64_t(uint16_t(RecipientPID)) << 48) | VehicleKey(Position.PID, Position.VID));
+    auto& Keyframe = Iter->second;
+    if (Inserted || Keyframe.DeltasSinceKey >= KeyframeInterval) {
+        if (!Inserted) {
+            ++Keyframe.KeyID;
+        }
+        Keyframe.State = Position.State;
+        Keyframe.DeltasSinceKey = 0;
+        Out.push_back(1);
+        Out.push_back(Keyframe.KeyID);
+        for (auto Value : Position.State) {
+            WriteVarint(Out, Value);
+        }
+    } else {
+        ++Keyframe.DeltasSinceKey;
+        Out.push_back(0);
+        Out.push_back(Keyframe.KeyID);
+        uint16_t Mask = 0;
+        for (size_t i = 0; i < ValueCount; ++i) {
+            if (Position.State[i] != Keyframe.State[i]) {
+                Mask |= uint16_t(1u << i);
+            }
+        }
+        Out.push_back(uint8_t(Mask & 0xff));
+        Out.push_back(uint8_t(Mask >> 8));
+        for (size_t i = 0; i < ValueCount; ++i) {
+            if (Mask & (1u << i)) {
+                WriteVarint(Out, Position.State[i] - Keyframe.State[i]);
+            }
+        }
+    }
+    return TSharedBuffer(std::move(Out));
+}
+
+void TPositionDeltaEncoder::RequestKeyframe(int RecipientPID, int PID, int VID) {
+    std::unique_lock Lock(mMutex);
+    auto Iter = mKeyframes.find((uint64_t(uint16_t(RecipientPID)) << 48) | VehicleKey(PID, VID));
+    if (Iter != mKeyframes.end()) {
+        Iter->second.DeltasSinceKey = KeyframeInterval;
+    }
+}
+
+std::optional<std::pair<int, int>> TPositionDeltaEncoder::ParseKeyframeRequest(std::string_view Packet) {
+    if (Packet.substr(0, 3) != "Xk:") {
+        return std::nullopt;
+    }
+    Packet.remove_prefix(3);
+    // ParsePidVid expects the ':' after the IDs
+    std::string WithSeparator(Packet);
+    WithSeparator += ':';
+    std::string_view Rest = WithSeparator;
+    int PID = -1;
+    int VID = -1;
+    if (!ParsePidVid(Rest, PID, VID) || !Rest.empty()) {
+        return std::nullopt;
+    }
+    return std::make_pair(PID, VID);
+}
+
+void TPositionDeltaEncoder::ForgetVehicle(int PID, int VID) {
+    const auto Key = VehicleKey(PID, VID);
+    std::unique_lock Lock(mMutex);
+    std::erase_if(mKeyframes, [Key](const auto& Pair) { return (Pair.first & 0xffff'ffff'ffff) == Key; });
+}
+
+void TPositionDeltaEncoder::ForgetPlayer(int PID) {
+    const auto ID = uint64_t(uint16_t(PID));
+    std::unique_lock Lock(mMutex);
+    std::erase_if(mKeyframes, [ID](const auto& Pair) {
+        return (Pair.first >> 48) == ID || ((Pair.first >> 32) & 0xffff) == ID;
+    });
+}
+
+std::optional<std::string> TPositionDeltaDecoder::Decode(std::string_view Packet) {
+    if (Packet.substr(0, 3) != "Zd:") {
+        return std::nullopt;
+    }
+    Packet.remove_prefix(3);
+    int PID = -1;
+    int VID = -1;
+    if (!ParsePidVid(Packet, PID, VID) || Packet.size() < 2) {
+        return std::nullopt;
+    }
+    const bool IsKeyframe = Packet[0] & 1;
+    const auto KeyID = uint8_t(Packet[1]);
+    Packet.remove_prefix(2);
+    TPositionDeltaEncoder::TState State {};
+    if (IsKeyframe) {
+        for (auto& Value : State) {
+            if (!ReadVarint(Packet, Value)) {
+                return std::nullopt;
+            }
+        }
+        mKeyframes[VehicleKey(PID, VID)] = TKeyframe { State, KeyID };
+    } else {
+        auto Iter = mKeyframes.find(VehicleKey(PID, VID));
+        if (Iter == mKeyframes.end() || Iter->second.KeyID != KeyID || Packet.size() < 2) {
+            return std::nullopt;
+        }
+        State = Iter->second.State;
+        const auto Mask = uint16_t(uint8_t(Packet[0]) | (uint8_t(Packet[1]) << 8));
+        Packet.remove_prefix(2);
+        for (size_t i = 0; i < TPositionDeltaEncoder::ValueCount; ++i) {
+            int64_t Delta = 0;
+            if (Mask & (1u << i)) {
+                if (!ReadVarint(Packet, Delta)) {
+                    return std::nullopt;
+                }
+                State[i] += Delta;
+            }
+        }
+    }
+    if (!Packet.empty()) {
+        return std::nullopt;
+    }
+    TVehiclePosition Position;
+    const auto Values = ValuesOf(Position);
+    for (size_t i = 0; i < TPositionDeltaEncoder::ValueCount; ++i) {
+        *Values[i] = double(State[i]) / TPositionDeltaEncoder::Scales[i];
+    }
+    return "Zp:" + std::to_string(PID) + "-" + std::to_string(VID) + ":" + Position.ToJson();
+}
+
+TEST_CASE("TPositionDeltaEncoder::Parse") {
+    const std::string Json = R"({"tim":10.428000331623,"vel":[-2.4171722121385e-05,-9.7184734153252e-06,-7.6420763232237e-06],"rot":[-0.0001296154171915,0.0031575385950029,0.98994906610295,0.14138903660382],"rvel":[5.3640324636461e-05,-9.9824529946024e-05,5.1664064641372e-05],"pos":[-0.27281248907838,-0.20515357944633,0.49695488960431],"ping":0.032999999821186})";
+    auto Parsed = TPositionDeltaEncoder::Parse("Zp:3-7:" + Json);
+    REQUIRE(Parsed.has_value());
+    CHECK(Parsed->PID == 3);
+    CHECK(Parsed->VID == 7);
+    CHECK(Parsed->State[0] == 10428); // tim
+    CHECK(Parsed->State[1] == 33); // ping
+    CHECK(Parsed->State[2] == -273); // pos x
+    CHECK(Parsed->State[7] == 9899); // rot z
+
+    // anything we can't reproduce must be sent as-is
+    CHECK(!TPositionDeltaEncoder::Parse(R"(Zp:3-7:{"tim":1,"ping":1,"pos":[1,2,3]})"));
+    CHECK(!TPositionDeltaEncoder::Parse("Zp:3-7:" + Json.substr(0, Json.size() - 1) + R"(,"extra":1})"));
+    CHECK(!TPositionDeltaEncoder::Parse("Zp:3-7:" + Json + " "));
+    CHECK(!TPositionDeltaEncoder::Parse("Zp:3:" + Json));
+}
+
+TEST_CASE("TPositionDeltaEncoder round trip") {
+    TPositionDeltaEncoder Encoder;
+    TPositionDeltaDecoder Decoder;
+    TPositionDeltaEncoder::TPosition Position { 1, 2, { 1000, 30, -704250, 12500, 103125, 0, 0, 9899, 1414, 5000, -20, 3, 0, 0, 1 } };
+
+    auto Key = Encoder.Encode(0, Position);
+    CHECK(Key.size() < 64);
+    auto Decoded = Decoder.Decode(Key.AsStringView());
+    REQUIRE(Decoded.has_value());
+    auto Reparsed = TPositionDeltaEncoder::Parse(Decoded.value());
+    REQUIRE(Reparsed.has_value());
+    CHECK(Reparsed->State == Position.State);
+
+    // only time and x position change
+    Position.State[0] += 16;
+    Position.State[2] += 83;
+    auto Delta = Encoder.Encode(0, Position);
+    CHECK(Delta.size() < Key.size());
+    Decoded = Decoder.Decode(Delta.AsStringView());
+    REQUIRE(Decoded.has_value());
+    CHECK(TPositionDeltaEncoder::Parse(Decoded.value())->State == Position.State);
+
+    // another recipient starts with its own keyframe
+    TPositionDeltaDecoder OtherDecoder;
+    CHECK(OtherDecoder.Decode(Encoder.Encode(1, Position).AsStringView()).has_value());
+
+    // deltas against an unknown keyframe can't be decoded
+    TPositionDeltaDecoder LateDecoder;
+    CHECK(!LateDecoder.Decode(Encoder.Encode(0, Position).AsStringView()));
+
+    // but a new keyframe comes after at most KeyframeInterval deltas
+    size_t Decodable = 0;
+    for (uint32_t i = 0; i < TPositionDeltaEncoder::KeyframeInterval; ++i) {
+        Decodable += LateDecoder.Decode(Encoder.Encode(0, Position).AsStringView()).has_value();
+    }
+    CHECK(Decodable > 0);
+    CHECK(LateDecoder.Decode(Encoder.Encode(0, Position).AsStringView()).has_value());
+
+    // a client which lost the keyframe asks for a new one, and can decode again right away
+    TPositionDeltaDecoder LostDecoder;
+    (void)Encoder.Encode(2, Position);
+    CHECK(!LostDecoder.Decode(Encoder.Encode(2, Position).AsStringView()));
+    const auto Request = TPositionDeltaEncoder::ParseKeyframeRequest("Xk:1-2");
+    REQUIRE(Request.has_value());
+    Encoder.RequestKeyframe(2, Request->first, Request->second);
+    CHECK(LostDecoder.Decode(Encoder.Encode(2, Position).AsStringView()).has_value());
+    CHECK(LostDecoder.Decode(Encoder.Encode(2, Position).AsStringView()).has_value());
+    CHECK(!TPositionDeltaEncoder::ParseKeyframeRequest("Xk:1-"));
+    CHECK(!TPositionDeltaEncoder::ParseKeyframeRequest("Xk:1-2:3"));
+    CHECK(!TPositionDeltaEncoder::ParseKeyframeRequest("Xc:1-2"));
+
+    // forgetting the vehicle starts over with a keyframe
+    Encoder.ForgetVehicle(1, 2);
+    TPositionDeltaDecoder FreshDecoder;
+    CHECK(FreshDecoder.Decode(Encoder.Encode(0, Position).AsStringView()).has_value());
+}
@@ -0,0 +1,202 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "TPositionSnapshots.h"
+
+#include <algorithm>
+#include <doctest/doctest.h>
+
+bool TPositionSnapshots::Store(int PID, int VID, TSharedBuffer Packet, std::optional<TInterestManager::TVec3> Position) {
+    std::unique_lock Lock(mMutex);
+    auto [Iter, Inserted] = mIndex.try_emplace(KeyOf(PID, VID), mPending.size());
+    if (Inserted) {
+        mPending.push_back(TSnapshot { PID, VID, std::move(Packet), Position });
+        return false;
+    }
+    auto& Snapshot = mPending[Iter->second];
+    Snapshot.Packet = std::move(Packet);
+    Snapshot.Position = Position;
+    return true;
+}
+
+void TPositionSnapshots::TakeAll(std::vector<TSnapshot>& Out) {
+    Out.clear();
+    std::unique_lock Lock(mMutex);
+    // hand over the filled vector and keep the (empty) one from the last tick, so both
+    // keep their capacity
+    std::swap(Out, mPending);
+    mIndex.clear();
+}
+
+void TPositionSnapshots::RemoveVehicle(int PID, int VID) {
+    std::unique_lock Lock(mMutex);
+    auto Iter = mIndex.find(KeyOf(PID, VID));
+    if (Iter == mIndex.end()) {
+        return;
+    }
+    mPending.erase(mPending.begin() + std::ptrdiff_t(Iter->second));
+    RebuildIndex();
+}
+
+void TPositionSnapshots::RemovePlayer(int PID) {
+    std::unique_lock Lock(mMutex);
+    const auto OldSize = mPending.size();
+    std::erase_if(mPending, [PID](const TSnapshot& Snapshot) { return Snapshot.PID == PID; });
+    if (mPending.size() != OldSize) {
+        RebuildIndex();
+    }
+}
+
+void TPositionSnapshots::RebuildIndex() {
+    mIndex.clear();
+    for (size_t i = 0; i < mPending.size(); ++i) {
+        mIndex.emplace(KeyOf(mPending[i].PID, mPending[i].VID), i);
+    }
+}
+
+void TPositionSnapshots::Batch(std::span<const TSharedBuffer> Packets, std::vector<TSharedBuffer>& Out, size_t MaxSize) {
+    std::vector<uint8_t> Current;
+    const TSharedBuffer* First = nullptr;
+    size_t Count = 0;
+    auto Flush = [&] {
+        if (Count == 1) {
+            // not worth the overhead
+            Out.push_back(*First);
+        } else if (Count > 1) {
+            Out.emplace_back(std::move(Current));
+        }
+        Current.clear();
+        Count = 0;
+    };
+    for (const auto& Packet : Packets) {
+        const size_t EntrySize = sizeof(uint16_t) + Packet.size();
+        if (BatchPrefix.size() + EntrySize > MaxSize) {
+            Out.push_back(Packet);
+            continue;
+        }
+        if (Count > 0 && Current.size() + EntrySize > MaxSize) {
+            Flush();
+        }
+        if (Count == 0) {
+            Current.assign(BatchPrefix.begin(), BatchPrefix.end());
+            First = &Packet;
+        }
+        Current.push_back(uint8_t(Packet.size()));
+        Current.push_back(uint8_t(Packet.size() >> 8));
+        Current.insert(Current.end(), Packet.begin(), Packet.end());
+        ++Count;
+    }
+    Flush();
+}
+
+std::optional<std::vector<std::string_view>> TPositionSnapshots::Unbatch(std::string_view Datagram) {
+    if (!Datagram.starts_with(BatchPrefix)) {
+        return std::nullopt;
+    }
+    Datagram.remove_prefix(BatchPrefix.size());
+    std::vector<std::string_view> Packets;
+    while (!Datagram.empty()) {
+        if (Datagram.size() < sizeof(uint16_t)) {
+            return std::nullopt;
+        }
+        const size_t Size = size_t(uint8_t(Datagram[0])) | (size_t(uint8_t(Datagram[1])) << 8);
+        Datagram.remove_prefix(sizeof(uint16_t));
+        if (Size == 0 || Size > Datagram.size()) {
+            return std::nullopt;
+        }
+        Packets.push_back(Datagram.substr(0, Size));
+        Datagram.remove_prefix(Size);
+    }
+    return Packets;
+}
+
+TEST_CASE("TPositionSnapshots") {
+    TPositionSnapshots Snapshots;
+    CHECK(!Snapshots.Store(0, 0, TSharedBuffer::FromString("Zp:0-0:1"), std::nullopt));
+    CHECK(!Snapshots.Store(0, 1, TSharedBuffer::FromString("Zp:0-1:1"), std::nullopt));
+    CHECK(!Snapshots.Store(1, 0, TSharedBuffer::FromString("Zp:1-0:1"), std::nullopt));
+    // latest wins
+    CHECK(Snapshots.Store(0, 0, TSharedBuffer::FromString("Zp:0-0:2"), TInterestManager::TVec3 { 1, 2, 3 }));
+
+    std::vector<TPositionSnapshots::TSnapshot> Taken;
+    Snapshots.TakeAll(Taken);
+    REQUIRE(Taken.size() == 3);
+    CHECK(Taken[0].Packet.AsStringView() == "Zp:0-0:2");
+    CHECK(Taken[0].Position.has_value());
+    CHECK(Taken[1].Packet.AsStringView() == "Zp:0-1:1");
+
+    // nothing is sent twice
+    Snapshots.TakeAll(Taken);
+    CHECK(Taken.empty());
+
+    (void)Snapshots.Store(0, 0, TSharedBuffer::FromString("Zp:0-0:3"), std::nullopt);
+    (void)Snapshots.Store(0, 1, TSharedBuffer::FromString("Zp:0-1:3"), std::nullopt);
+    (void)Snapshots.Store(1, 0, TSharedBuffer::FromString("Zp:1-0:3"), std::nullopt);
+    (void)Snapshots.Store(1, 1, TSharedBuffer::FromString("Zp:1-1:3"), std::nullopt);
+    Snapshots.RemoveVehicle(0, 1);
+    Snapshots.RemovePlayer(1);
+    // the index must still be correct after removals
+    CHECK(Snapshots.Store(0, 0, TSharedBuffer::FromString("Zp:0-0:4"), std::nullopt));
+    Snapshots.TakeAll(Taken);
+    REQUIRE(Taken.size() == 1);
+    CHECK(Taken[0].Packet.AsStringView() == "Zp:0-0:4");
+}
+
+TEST_CASE("TPositionSnapshots batches") {
+    std::vector<TSharedBuffer> Packets;
+    for (int i = 0; i < 10; ++i) {
+        Packets.push_back(TSharedBuffer::FromString("Zp:0-" + std::to_string(i) + ":" + std::string(90, 'x')));
+    }
+    // a packet which is too large for any batch
+    Packets.insert(Packets.begin() + 5, TSharedBuffer::FromString(std::string(300, 'y')));
+
+    std::vector<TSharedBuffer> Datagrams;
+    TPositionSnapshots::Batch(Packets, Datagrams, 300);
+    std::vector<std::string> Received;
+    for (const auto& Datagram : Datagrams) {
+        CHECK(Datagram.size() <= 300);
+        auto Unbatched = TPositionSnapshots::Unbatch(Datagram.AsStringView());
+        if (Unbatched.has_value()) {
+            CHECK(Unbatched->size() > 1);
+            Received.insert(Received.end(), Unbatched->begin(), Unbatched->end());
+        } else {
+            Received.emplace_back(Datagram.AsStringView());
+        }
+    }
+    // 3 packets fit into one batch, the big one doesn't fit at all
+    CHECK(Datagrams.size() == 5);
+    REQUIRE(Received.size() == Packets.size());
+    // nothing is reordered, except around the big one
+    std::vector<std::string> Expected;
+    for (const auto& Packet : Packets) {
+        if (Packet.size() < 300) {
+            Expected.emplace_back(Packet.AsStringView());
+        }
+    }
+    std::erase_if(Received, [](const std::string& Packet) { return Packet.size() >= 300; });
+    CHECK(Received == Expected);
+
+    // a single packet isn't batched
+    Datagrams.clear();
+    TPositionSnapshots::Batch(std::span(Packets).first(1), Datagrams);
+    REQUIRE(Datagrams.size() == 1);
+    CHECK(Datagrams[0].data() == Packets[0].data());
+
+    CHECK(!TPositionSnapshots::Unbatch("Zp:0-0:{}").has_value());
+    CHECK(!TPositionSnapshots::Unbatch(std::string_view("Zb:\x05\x00" "abc", 8)).has_value());
+}
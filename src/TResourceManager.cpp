@@ -18,8 +18,17 @@
 
 #include "TResourceManager.h"
 
+#include "TScopedTimer.h"
+
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <doctest/doctest.h>
 #include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <openssl/evp.h>
+#include <thread>
 
 namespace fs = std::filesystem;
 
@@ -33,22 +42,232 @@ TResourceManager::TResourceManager() {
         if (auto pos = File.find(".zip"); pos != std::string::npos) {
             if (File.length() - pos == 4) {
                 std::replace(File.begin(), File.end(), '\\', '/');
-                mFileList += File + ';';
-                if (auto i = File.find_last_of('/'); i != std::string::npos) {
-                    ++i;
-                    File = File.substr(i, pos - i);
-                }
-                mTrimmedList += "/" + fs::path(File).filename().string() + ';';
-                mFileSizes += std::to_string(size_t(fs::file_size(entry.path()))) + ';';
-                mMaxModSize += size_t(fs::file_size(entry.path()));
-                mModsLoaded++;
+                TModInfo Mod;
+                Mod.Path = File;
+                Mod.Size = uint64_t(entry.file_size());
+                Mod.LastWrite = int64_t(entry.last_write_time().time_since_epoch().count());
+                mMods.push_back(std::move(Mod));
             }
         }
     }
 
+    // only files which changed since the last start need to be hashed again
+    const auto IndexPath = Application::Settings.getAsString(Settings::Key::General_ResourceFolder) + "/ModIndex.json";
+    const auto Index = ReadIndex(IndexPath);
+    std::vector<TModInfo*> ToHash;
+    for (auto& Mod : mMods) {
+        auto Indexed = Index.find(Mod.Path);
+        if (Indexed != Index.end() && Indexed->second.Size == Mod.Size && Indexed->second.LastWrite == Mod.LastWrite) {
+            Mod.Hash = Indexed->second.Hash;
+        } else {
+            ToHash.push_back(&Mod);
+        }
+    }
+    if (!ToHash.empty()) {
+        TScopedTimer Timer([Count = ToHash.size()](size_t Ms) {
+            beammp_infof("Hashed {} new or changed mod(s) in {}ms", Count, Ms);
+        });
+        HashMods(ToHash);
+    }
+    // mods which couldn't be hashed are still offered, without a hash
+    if (!ToHash.empty() || Index.size() != mMods.size()) {
+        try {
+            WriteIndex(IndexPath, mMods);
+        } catch (const std::exception& e) {
+            beammp_warnf("Failed to write the mod index, all mods will be hashed again on the next start: {}", e.what());
+        }
+    }
+
+    for (const auto& Mod : mMods) {
+        std::string File = Mod.Path;
+        mFileList += File + ';';
+        auto pos = File.find(".zip");
+        if (auto i = File.find_last_of('/'); i != std::string::npos) {
+            ++i;
+            File = File.substr(i, pos - i);
+        }
+        mTrimmedList += "/" + fs::path(File).filename().string() + ';';
+        mFileSizes += std::to_string(Mod.Size) + ';';
+        mFileHashes += Mod.Hash + ';';
+        mMaxModSize += size_t(Mod.Size);
+        mModsLoaded++;
+    }
+
     if (mModsLoaded) {
         beammp_info("Loaded " + std::to_string(mModsLoaded) + " Mods");
     }
 
     Application::SetSubsystemStatus("ResourceManager", Application::Status::Good);
 }
+
+void TResourceManager::HashMods(std::vector<TModInfo*>& ToHash) {
+    std::atomic<size_t> Next { 0 };
+    auto Worker = [&] {
+        for (size_t i = Next++; i < ToHash.size(); i = Next++) {
+            try {
+                ToHash[i]->Hash = HashFile(ToHash[i]->Path);
+            } catch (const std::exception& e) {
+                beammp_errorf("Failed to hash mod: {}", e.what());
+            }
+        }
+    };
+    const auto ThreadCount = std::min<size_t>(ToHash.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> Threads;
+    for (size_t i = 1; i < ThreadCount; ++i) {
+        Threads.emplace_back(Worker);
+    }
+    Worker();
+    for (auto& Thread : Threads) {
+        Thread.join();
+    }
+}
+
+std::string TResourceManager::HashFile(const std::string& Path) {
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> Context(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+    if (!Context || EVP_DigestInit_ex(Context.get(), EVP_sha256(), nullptr) != 1) {
+        throw std::runtime_error("Failed to set up SHA-256");
+    }
+    auto File = TMappedFile::Open(Path);
+    if (File->Data()) {
+        EVP_DigestUpdate(Context.get(), File->Data(), size_t(File->Size()));
+    } else {
+        std::ifstream Stream(Path, std::ios::binary);
+        std::vector<char> Buffer(1024 * 1024);
+        while (Stream) {
+            Stream.read(Buffer.data(), std::streamsize(Buffer.size()));
+            EVP_DigestUpdate(Context.get(), Buffer.data(), size_t(Stream.gcount()));
+        }
+        if (!Stream.eof()) {
+            throw std::runtime_error("Failed to read " + Path);
+        }
+    }
+    std::array<unsigned char, EVP_MAX_MD_SIZE> Digest {};
+    unsigned int DigestSize = 0;
+    EVP_DigestFinal_ex(Context.get(), Digest.data(), &DigestSize);
+    std::string Hex;
+    Hex.reserve(DigestSize * 2);
+    for (unsigned int i = 0; i < DigestSize; ++i) {
+        Hex += fmt::format("{:02x}", Digest[i]);
+    }
+    return Hex;
+}
+
+TResourceManager::TModIndex TResourceManager::ReadIndex(const std::string& IndexPath) {
+    TModIndex Index;
+    std::ifstream File(IndexPath);
+    if (!File) {
+        return Index;
+    }
+    auto Json = nlohmann::json::parse(File, nullptr, false);
+    if (Json.is_discarded() || !Json.is_object() || !Json.contains("mods") || !Json["mods"].is_object()) {
+        beammp_warnf("Mod index '{}' is invalid, ignoring it", IndexPath);
+        return Index;
+    }
+    for (const auto& [Path, Entry] : Json["mods"].items()) {
+        if (!Entry.is_object() || !Entry.contains("size") || !Entry.contains("mtime") || !Entry.contains("sha256")
+            || !Entry["size"].is_number_unsigned() || !Entry["mtime"].is_number_integer() || !Entry["sha256"].is_string()) {
+            continue;
+        }
+        TModInfo Mod;
+        Mod.Path = Path;
+        Mod.Size = Entry["size"].get<uint64_t>();
+        Mod.LastWrite = Entry["mtime"].get<int64_t>();
+        Mod.Hash = Entry["sha256"].get<std::string>();
+        Index.emplace(Path, std::move(Mod));
+    }
+    return Index;
+}
+
+void TResourceManager::WriteIndex(const std::string& IndexPath, const std::vector<TModInfo>& Mods) {
+    nlohmann::json Json;
+    Json["version"] = 1;
+    Json["mods"] = nlohmann::json::object();
+    for (const auto& Mod : Mods) {
+        if (Mod.Hash.empty()) {
+            continue;
+        }
+        Json["mods"][Mod.Path] = { { "size", Mod.Size }, { "mtime", Mod.LastWrite }, { "sha256", Mod.Hash } };
+    }
+    // written next to it and then renamed, so a crash can't leave a half written index behind
+    const auto TempPath = IndexPath + ".tmp";
+    {
+        std::ofstream File(TempPath, std::ios::trunc);
+        File << Json.dump(4);
+        if (!File) {
+            throw std::runtime_error("Failed to write " + TempPath);
+        }
+    }
+    std::error_code ec;
+    fs::rename(TempPath, IndexPath, ec);
+    if (ec) {
+        throw std::runtime_error("Failed to replace " + IndexPath + ": " + ec.message());
+    }
+}
+
+std::shared_ptr<const TMappedFile> TResourceManager::OpenMod(const std::string& Path) {
+    std::error_code ec;
+    const auto LastWriteTime = fs::last_write_time(Path, ec);
+    const auto Size = fs::file_size(Path, ec);
+    std::unique_lock Lock(mOpenModsMutex);
+    std::erase_if(mOpenMods, [](const auto& Entry) { return Entry.second.expired(); });
+    auto Iter = mOpenMods.find(Path);
+    if (ec) {
+        // gone, running downloads keep their reference
+        if (Iter != mOpenMods.end()) {
+            mOpenMods.erase(Iter);
+        }
+        throw std::runtime_error("Failed to open " + Path + ": " + ec.message());
+    }
+    if (Iter != mOpenMods.end()) {
+        auto Open = Iter->second.lock();
+        if (Open && Open->LastWriteTime() == LastWriteTime && Open->Size() == Size) {
+            return Open;
+        }
+        if (Open) {
+            beammp_debugf("Mod '{}' changed, re-opening it", Path);
+        }
+    }
+    auto File = TMappedFile::Open(Path);
+    mOpenMods.insert_or_assign(Path, File);
+    return File;
+}
+
+size_t TResourceManager::OpenModCount() {
+    std::unique_lock Lock(mOpenModsMutex);
+    return size_t(std::count_if(mOpenMods.begin(), mOpenMods.end(), [](const auto& Entry) { return !Entry.second.expired(); }));
+}
+
+TEST_CASE("TResourceManager::HashFile") {
+    const auto Path = (fs::temp_directory_path() / "beammp_hash_test.zip").string();
+    {
+        std::ofstream File(Path, std::ios::binary);
+        File << "abc";
+    }
+    CHECK(TResourceManager::HashFile(Path) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    fs::remove(Path);
+    CHECK_THROWS(TResourceManager::HashFile(Path));
+}
+
+TEST_CASE("TResourceManager mod index") {
+    const auto Path = (fs::temp_directory_path() / "beammp_mod_index_test.json").string();
+    fs::remove(Path);
+    CHECK(TResourceManager::ReadIndex(Path).empty());
+    std::vector<TResourceManager::TModInfo> Mods {
+        { "Resources/Client/a.zip", 123, 456, "aa" },
+        { "Resources/Client/b.zip", 1, -2, "bb" },
+        { "Resources/Client/unhashed.zip", 1, 2, "" },
+    };
+    TResourceManager::WriteIndex(Path, Mods);
+    auto Index = TResourceManager::ReadIndex(Path);
+    CHECK(Index.size() == 2);
+    CHECK(Index.at("Resources/Client/a.zip").Size == 123);
+    CHECK(Index.at("Resources/Client/a.zip").LastWrite == 456);
+    CHECK(Index.at("Resources/Client/b.zip").LastWrite == -2);
+    CHECK(Index.at("Resources/Client/b.zip").Hash == "bb");
+    {
+        std::ofstream File(Path, std::ios::trunc);
+        File << "{ not json";
+    }
+    CHECK(TResourceManager::ReadIndex(Path).empty());
+    fs::remove(Path);
+}
@@ -19,6 +19,7 @@
 #include "TServer.h"
 #include "Client.h"
 #include "Common.h"
+#include "Compression.h"
 #include "CustomAssert.h"
 #include "TNetwork.h"
 #include "TPPSMonitor.h"
@@ -139,10 +140,85 @@ void TServer::RemoveClient(const std::weak_ptr<TClient>& WeakClientPtr) {
     beammp_debug("removing client " + Client.GetName() + " (" + std::to_string(ClientCount()) + ")");
     // TODO: Send delete packets for all cars
     Client.ClearCars();
+    { // slots lock scope
+        WriteLock Lock(mClientSlotsMutex);
+        const auto ID = Client.GetID();
+        if (ID >= 0 && size_t(ID) < mClientSlots.size() && mClientSlots[size_t(ID)].lock() == LockedClientPtr) {
+            mClientSlots[size_t(ID)].reset();
+        }
+        if (auto Iter = mUDPEndpoints.find(Client.GetUDPAddr()); Iter != mUDPEndpoints.end() && Iter->second.lock() == LockedClientPtr) {
+            mUDPEndpoints.erase(Iter);
+        }
+    }
+    mInterestManager.RemovePlayer(Client.GetID());
     WriteLock Lock(mClientsMutex);
     mClients.erase(WeakClientPtr.lock());
 }
 
+int TServer::AssignClientID(const std::shared_ptr<TClient>& Client) {
+    WriteLock Lock(mClientSlotsMutex);
+    for (size_t i = 0; i < mClientSlots.size(); ++i) {
+        if (mClientSlots[i].expired()) {
+            mClientSlots[i] = Client;
+            Client->SetID(int(i));
+            return int(i);
+        }
+    }
+    return -1;
+}
+
+std::shared_ptr<TClient> TServer::GetClientByID(int ID) const {
+    if (ID < 0 || size_t(ID) >= mClientSlots.size()) {
+        return nullptr;
+    }
+    ReadLock Lock(mClientSlotsMutex);
+    return mClientSlots[size_t(ID)].lock();
+}
+
+std::shared_ptr<TClient> TServer::GetClientByUDPEndpoint(const ip::udp::endpoint& Endpoint) const {
+    ReadLock Lock(mClientSlotsMutex);
+    if (auto Iter = mUDPEndpoints.find(Endpoint); Iter != mUDPEndpoints.end()) {
+        return Iter->second.lock();
+    }
+    return nullptr;
+}
+
+void TServer::BindUDPEndpoint(const std::shared_ptr<TClient>& Client, const ip::udp::endpoint& Endpoint) {
+    WriteLock Lock(mClientSlotsMutex);
+    if (Client->IsConnected()) {
+        // the client's endpoint changed (e.g. NAT rebinding), forget the old one
+        if (auto Iter = mUDPEndpoints.find(Client->GetUDPAddr()); Iter != mUDPEndpoints.end() && Iter->second.lock() == Client) {
+            mUDPEndpoints.erase(Iter);
+        }
+    }
+    mUDPEndpoints[Endpoint] = Client;
+    Client->SetUDPAddr(Endpoint);
+    Client->SetIsConnected(true);
+}
+
+size_t TUDPEndpointHash::operator()(const ip::udp::endpoint& Endpoint) const {
+    size_t Hash = std::hash<unsigned short> {}(Endpoint.port());
+    const auto Address = Endpoint.address();
+    if (Address.is_v4()) {
+        Hash ^= std::hash<uint32_t> {}(Address.to_v4().to_uint()) + 0x9e3779b9 + (Hash << 6) + (Hash >> 2);
+    } else {
+        for (auto Byte : Address.to_v6().to_bytes()) {
+            Hash ^= std::hash<uint8_t> {}(Byte) + 0x9e3779b9 + (Hash << 6) + (Hash >> 2);
+        }
+    }
+    return Hash;
+}
+
+TEST_CASE("TUDPEndpointHash") {
+    TUDPEndpointHash Hash;
+    const ip::udp::endpoint A(ip::make_address("127.0.0.1"), 4444);
+    const ip::udp::endpoint B(ip::make_address("127.0.0.1"), 4445);
+    const ip::udp::endpoint C(ip::make_address("::1"), 4444);
+    CHECK(Hash(A) == Hash(ip::udp::endpoint(ip::make_address("127.0.0.1"), 4444)));
+    CHECK(Hash(A) != Hash(B));
+    CHECK(Hash(A) != Hash(C));
+}
+
 void TServer::ForEachClient(const std::function<bool(std::weak_ptr<TClient>)>& Fn) {
     decltype(mClients) Clients;
     {
@@ -162,11 +238,6 @@ size_t TServer::ClientCount() const {
 }
 
 void TServer::GlobalParser(const std::weak_ptr<TClient>& Client, std::vector<uint8_t>&& Packet, TPPSMonitor& PPSMonitor, TNetwork& Network) {
-    constexpr std::string_view ABG = "ABG:";
-    if (Packet.size() >= ABG.size() && std::equal(Packet.begin(), Packet.begin() + ABG.size(), ABG.begin(), ABG.end())) {
-        Packet.erase(Packet.begin(), Packet.begin() + ABG.size());
-        Packet = DeComp(Packet);
-    }
     if (Packet.empty()) {
         return;
     }
@@ -175,6 +246,10 @@ void TServer::GlobalParser(const std::weak_ptr<TClient>& Client, std::vector<uin
         return;
     }
     auto LockedClient = Client.lock();
+    Packet = Compression::DecompressPacket(std::move(Packet), &LockedClient->DecompressionBudget(), &LockedClient->Codec());
+    if (Packet.empty()) {
+        return;
+    }
 
     std::any Res;
     char Code = Packet.at(0);
@@ -184,7 +259,7 @@ void TServer::GlobalParser(const std::weak_ptr<TClient>& Client, std::vector<uin
     // V to Y
     if (Code <= 89 && Code >= 86) {
         PPSMonitor.IncrementInternalPPS();
-        Network.SendToAll(LockedClient.get(), Packet, false, false);
+        Network.SendToAll(LockedClient.get(), std::move(Packet), false, false);
         return;
     }
     switch (Code) {
@@ -240,12 +315,18 @@ void TServer::GlobalParser(const std::weak_ptr<TClient>& Client, std::vector<uin
         return;
     case 'N':
         beammp_trace("got 'N' packet (" + std::to_string(Packet.size()) + ")");
-        Network.SendToAll(LockedClient.get(), Packet, false, true);
+        Network.SendToAll(LockedClient.get(), std::move(Packet), false, true);
         return;
     case 'Z': // position packet
         PPSMonitor.IncrementInternalPPS();
-        Network.SendToAll(LockedClient.get(), Packet, false, false);
-        HandlePosition(*LockedClient, StringPacket);
+        HandlePosition(*LockedClient, std::move(Packet), StringPacket, Network);
+        return;
+    case 'X':
+        if (StringPacket.starts_with("Xk:")) {
+            Network.RequestPositionKeyframe(*LockedClient, StringPacket);
+        } else {
+            HandleCapabilities(*LockedClient, StringPacket, Network);
+        }
         return;
     default:
         return;
@@ -356,6 +437,7 @@ void TServer::ParseVehicle(TClient& c, const std::string& Pckt, TNetwork& Networ
                 std::string Destroy = "Od:" + std::to_string(c.GetID()) + "-" + std::to_string(VID);
                 Network.SendToAll(nullptr, StringToVector(Destroy), true, true);
                 c.DeleteCar(VID);
+                Network.ForgetVehicle(c.GetID(), VID);
             }
         }
         return;
@@ -374,6 +456,7 @@ void TServer::ParseVehicle(TClient& c, const std::string& Pckt, TNetwork& Networ
             // TODO: should this trigger on all vehicle deletions?
             LuaAPI::MP::Engine->ReportErrors(LuaAPI::MP::Engine->TriggerEvent("onVehicleDeleted", "", c.GetID(), VID));
             c.DeleteCar(VID);
+            Network.ForgetVehicle(c.GetID(), VID);
             beammp_debug(c.GetName() + (" deleted car with ID ") + std::to_string(VID));
         }
         return;
@@ -518,8 +601,58 @@ TEST_CASE("ParsePositionPacket") {
     }
 }
 
-void TServer::HandlePosition(TClient& c, const std::string& Packet) {
-    if (auto Parsed = ParsePositionPacket(Packet); Parsed.has_value()) {
-        c.SetCarPosition(Parsed.value().VID, Parsed.value().Data);
+void TServer::HandleCapabilities(TClient& c, const std::string& Packet, TNetwork& Network) {
+    // Xc:name,name,... where codecs are listed in the order the client prefers them
+    if (Packet.size() < 3 || Packet.compare(0, 3, "Xc:") != 0) {
+        beammp_debugf("Client '{}' ({}) sent an invalid capability packet, ignoring", c.GetName(), c.GetID());
+        return;
+    }
+    std::string Accepted;
+    const ICodec* Codec = nullptr;
+    std::string_view Rest = std::string_view(Packet).substr(3);
+    while (!Rest.empty()) {
+        const auto Name = Rest.substr(0, Rest.find(','));
+        Rest.remove_prefix(std::min(Rest.size(), Name.size() + 1));
+        if (Name == "zdelta" && Network.PositionDeltasEnabled()) {
+            c.AddCapabilities(TClient::CapPositionDeltas);
+        } else if (Name == "zbatch" && Network.PositionTicksEnabled()) {
+            c.AddCapabilities(TClient::CapPositionBatches);
+        } else if (!Codec && Compression::Find(Name)) {
+            Codec = Compression::Find(Name);
+        } else {
+            continue;
+        }
+        Accepted += (Accepted.empty() ? "" : ",") + std::string(Name);
+    }
+    beammp_debugf("Client '{}' ({}) supports: '{}'", c.GetName(), c.GetID(), Accepted);
+    // tells the client which of its capabilities will actually be used
+    if (!Network.Respond(c, StringToVector("Xc:" + Accepted), true)) {
+        // TODO: handle
+    }
+    // compressed packets carry their codec's prefix, so packets compressed before the switch
+    // are still understood
+    if (Codec) {
+        c.SetCodec(*Codec);
+    }
+}
+
+void TServer::HandlePosition(TClient& c, std::vector<uint8_t>&& Packet, const std::string& StringPacket, TNetwork& Network) {
+    auto Parsed = ParsePositionPacket(StringPacket);
+    std::optional<TInterestManager::TVec3> Position;
+    if (Parsed.has_value()) {
+        // decoded once here, everyone else reads the decoded position
+        auto Decoded = mVehiclePositions.Set(c.GetID(), Parsed.value().VID, Parsed.value().Data);
+        if (Decoded.has_value() && mInterestManager.IsEnabled()) {
+            Position = Decoded.value().Pos;
+        }
+    }
+    if (Parsed.has_value() && Network.PositionTicksEnabled()) {
+        // sent with the next tick, unless a newer position arrives before that
+        Network.QueuePosition(c, Parsed.value().VID, std::move(Packet), Position);
+    } else if (Position.has_value()) {
+        auto Recipients = mInterestManager.OnPosition(c.GetID(), Parsed.value().VID, Position.value());
+        Network.SendToAll(&c, std::move(Packet), false, false, &Recipients);
+    } else {
+        Network.SendToAll(&c, std::move(Packet), false, false);
     }
 }
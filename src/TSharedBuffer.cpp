@@ -0,0 +1,109 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "TSharedBuffer.h"
+
+#include <cstring>
+#include <doctest/doctest.h>
+#include <stdexcept>
+
+static thread_local uint64_t tAllocations = 0;
+
+TSharedBuffer::TSharedBuffer(std::vector<uint8_t>&& Data) {
+    if (Data.empty()) {
+        return;
+    }
+    // one allocation for the control block and the vector object, the vector's data
+    // is reused as-is. The aliasing constructor then points us at the bytes.
+    auto Owner = std::make_shared<const std::vector<uint8_t>>(std::move(Data));
+    mSize = Owner->size();
+    mData = std::shared_ptr<const uint8_t>(Owner, Owner->data());
+    ++tAllocations;
+}
+
+TSharedBuffer::TSharedBuffer(const std::vector<uint8_t>& Data)
+    : TSharedBuffer(Data.data(), Data.size()) {
+}
+
+TSharedBuffer::TSharedBuffer(const uint8_t* Data, size_t Size) {
+    if (Size == 0) {
+        return;
+    }
+    // control block and data in a single allocation
+    auto Slab = std::make_shared<uint8_t[]>(Size);
+    std::memcpy(Slab.get(), Data, Size);
+    mSize = Size;
+    mData = std::shared_ptr<const uint8_t>(Slab, Slab.get());
+    ++tAllocations;
+}
+
+TSharedBuffer TSharedBuffer::FromString(std::string_view Str) {
+    return TSharedBuffer(reinterpret_cast<const uint8_t*>(Str.data()), Str.size());
+}
+
+uint8_t TSharedBuffer::at(size_t i) const {
+    if (i >= mSize) {
+        throw std::out_of_range("TSharedBuffer index " + std::to_string(i) + " out of range (size " + std::to_string(mSize) + ")");
+    }
+    return mData.get()[i];
+}
+
+TSharedBuffer TSharedBuffer::Sub(size_t Offset, size_t Size) const {
+    if (Offset > mSize || Size > mSize - Offset) {
+        throw std::out_of_range("TSharedBuffer::Sub out of range");
+    }
+    TSharedBuffer Result;
+    Result.mData = std::shared_ptr<const uint8_t>(mData, mData.get() + Offset);
+    Result.mSize = Size;
+    return Result;
+}
+
+uint64_t TSharedBuffer::ThreadAllocationCount() {
+    return tAllocations;
+}
+
+TEST_CASE("TSharedBuffer") {
+    const auto Before = TSharedBuffer::ThreadAllocationCount();
+    std::vector<uint8_t> Vec { 'Z', 'p', ':', '1' };
+    const auto* RawData = Vec.data();
+    TSharedBuffer Adopted(std::move(Vec));
+    CHECK(Adopted.size() == 4);
+    CHECK(Adopted.data() == RawData); // no copy
+    CHECK(Adopted.AsStringView() == "Zp:1");
+    CHECK(TSharedBuffer::ThreadAllocationCount() == Before + 1);
+
+    // copies share the data and don't allocate
+    std::vector<TSharedBuffer> Copies(10, Adopted);
+    CHECK(Copies.back().data() == RawData);
+    CHECK(Adopted.UseCount() == 11);
+    CHECK(TSharedBuffer::ThreadAllocationCount() == Before + 1);
+
+    auto View = Adopted.Sub(3, 1);
+    CHECK(View.size() == 1);
+    CHECK(View.at(0) == '1');
+    CHECK_THROWS(View.at(1));
+    CHECK_THROWS(Adopted.Sub(2, 3));
+
+    auto FromString = TSharedBuffer::FromString("hello");
+    CHECK(FromString.ToVector() == std::vector<uint8_t> { 'h', 'e', 'l', 'l', 'o' });
+    CHECK(TSharedBuffer::ThreadAllocationCount() == Before + 2);
+
+    TSharedBuffer Empty;
+    CHECK(Empty.empty());
+    CHECK(Empty.begin() == Empty.end());
+}
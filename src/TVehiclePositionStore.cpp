@@ -0,0 +1,271 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "TVehiclePositionStore.h"
+
+#include <charconv>
+#include <cmath>
+#include <doctest/doctest.h>
+
+namespace {
+
+bool Consume(std::string_view& In, char C) {
+    if (In.empty() || In.front() != C) {
+        return false;
+    }
+    In.remove_prefix(1);
+    return true;
+}
+
+bool ParseNumbers(std::string_view& In, double* Out, size_t Count) {
+    const bool IsArray = Count > 1;
+    if (IsArray && !Consume(In, '[')) {
+        return false;
+    }
+    for (size_t i = 0; i < Count; ++i) {
+        if (i > 0 && !Consume(In, ',')) {
+            return false;
+        }
+        auto [Ptr, Error] = std::from_chars(In.data(), In.data() + In.size(), Out[i]);
+        if (Error != std::errc() || !std::isfinite(Out[i])) {
+            return false;
+        }
+        In.remove_prefix(size_t(Ptr - In.data()));
+    }
+    return !IsArray || Consume(In, ']');
+}
+
+void AppendNumbers(std::string& Out, const double* Values, size_t Count) {
+    if (Count > 1) {
+        Out += '[';
+    }
+    for (size_t i = 0; i < Count; ++i) {
+        if (i > 0) {
+            Out += ',';
+        }
+        std::array<char, 32> Buffer {};
+        auto [End, Error] = std::to_chars(Buffer.data(), Buffer.data() + Buffer.size(), Values[i]);
+        Out.append(Buffer.data(), End);
+    }
+    if (Count > 1) {
+        Out += ']';
+    }
+}
+
+}
+
+std::optional<TVehiclePosition> TVehiclePosition::Parse(std::string_view Json) {
+    TVehiclePosition Result;
+    struct TField {
+        std::string_view Name;
+        double* Values;
+        size_t Count;
+    };
+    const std::array<TField, 6> Fields { {
+        { "tim", &Result.Time, 1 },
+        { "ping", &Result.Ping, 1 },
+        { "pos", Result.Pos.data(), Result.Pos.size() },
+        { "rot", Result.Rot.data(), Result.Rot.size() },
+        { "vel", Result.Vel.data(), Result.Vel.size() },
+        { "rvel", Result.RVel.data(), Result.RVel.size() },
+    } };
+    if (!Consume(Json, '{')) {
+        return std::nullopt;
+    }
+    unsigned Seen = 0;
+    do {
+        if (!Consume(Json, '"')) {
+            return std::nullopt;
+        }
+        const auto NameEnd = Json.find('"');
+        if (NameEnd == std::string_view::npos) {
+            return std::nullopt;
+        }
+        const auto Name = Json.substr(0, NameEnd);
+        Json.remove_prefix(NameEnd + 1);
+        size_t i = 0;
+        while (i < Fields.size() && Fields[i].Name != Name) {
+            ++i;
+        }
+        if (i == Fields.size() || (Seen & (1u << i)) || !Consume(Json, ':') || !ParseNumbers(Json, Fields[i].Values, Fields[i].Count)) {
+            return std::nullopt;
+        }
+        Seen |= 1u << i;
+    } while (Consume(Json, ','));
+    if (!Consume(Json, '}') || !Json.empty() || Seen != (1u << Fields.size()) - 1) {
+        return std::nullopt;
+    }
+    return Result;
+}
+
+std::string TVehiclePosition::ToJson() const {
+    std::string Result;
+    Result.reserve(256);
+    Result += "{\"tim\":";
+    AppendNumbers(Result, &Time, 1);
+    Result += ",\"ping\":";
+    AppendNumbers(Result, &Ping, 1);
+    Result += ",\"pos\":";
+    AppendNumbers(Result, Pos.data(), Pos.size());
+    Result += ",\"rot\":";
+    AppendNumbers(Result, Rot.data(), Rot.size());
+    Result += ",\"vel\":";
+    AppendNumbers(Result, Vel.data(), Vel.size());
+    Result += ",\"rvel\":";
+    AppendNumbers(Result, RVel.data(), RVel.size());
+    Result += '}';
+    return Result;
+}
+
+TVehiclePositionStore::TPlayer* TVehiclePositionStore::PlayerOf(int PID, int VID) {
+    if (PID < 0 || size_t(PID) >= MaxPlayers || VID < 0 || size_t(VID) >= MaxVehiclesPerPlayer) {
+        return nullptr;
+    }
+    return &mPlayers[size_t(PID)];
+}
+
+const TVehiclePositionStore::TPlayer* TVehiclePositionStore::PlayerOf(int PID, int VID) const {
+    return const_cast<TVehiclePositionStore*>(this)->PlayerOf(PID, VID);
+}
+
+std::optional<TVehiclePosition> TVehiclePositionStore::Set(int PID, int VID, std::string_view Json) {
+    auto* Player = PlayerOf(PID, VID);
+    if (!Player) {
+        return std::nullopt;
+    }
+    // parse outside of the lock
+    auto Position = TVehiclePosition::Parse(Json);
+    std::unique_lock Lock(Player->Mutex);
+    if (Player->Vehicles.size() <= size_t(VID)) {
+        Player->Vehicles.resize(size_t(VID) + 1);
+    }
+    auto& Entry = Player->Vehicles[size_t(VID)];
+    if (Position) {
+        Entry.State = TEntry::TState::Decoded;
+        Entry.Position = Position.value();
+        Entry.Raw.clear();
+    } else {
+        Entry.State = TEntry::TState::RawOnly;
+        Entry.Raw.assign(Json);
+    }
+    return Position;
+}
+
+std::optional<TVehiclePosition> TVehiclePositionStore::Get(int PID, int VID) const {
+    const auto* Player = PlayerOf(PID, VID);
+    if (!Player) {
+        return std::nullopt;
+    }
+    std::unique_lock Lock(Player->Mutex);
+    if (size_t(VID) >= Player->Vehicles.size() || Player->Vehicles[size_t(VID)].State != TEntry::TState::Decoded) {
+        return std::nullopt;
+    }
+    return Player->Vehicles[size_t(VID)].Position;
+}
+
+std::string TVehiclePositionStore::GetJson(int PID, int VID) const {
+    const auto* Player = PlayerOf(PID, VID);
+    if (!Player) {
+        return "";
+    }
+    std::unique_lock Lock(Player->Mutex);
+    if (size_t(VID) >= Player->Vehicles.size()) {
+        return "";
+    }
+    const auto& Entry = Player->Vehicles[size_t(VID)];
+    switch (Entry.State) {
+    case TEntry::TState::Decoded:
+        return Entry.Position.ToJson();
+    case TEntry::TState::RawOnly:
+        return Entry.Raw;
+    case TEntry::TState::Empty:
+        break;
+    }
+    return "";
+}
+
+void TVehiclePositionStore::RemoveVehicle(int PID, int VID) {
+    auto* Player = PlayerOf(PID, VID);
+    if (!Player) {
+        return;
+    }
+    std::unique_lock Lock(Player->Mutex);
+    if (size_t(VID) < Player->Vehicles.size()) {
+        Player->Vehicles[size_t(VID)] = TEntry {};
+    }
+}
+
+void TVehiclePositionStore::RemovePlayer(int PID) {
+    auto* Player = PlayerOf(PID, 0);
+    if (!Player) {
+        return;
+    }
+    std::unique_lock Lock(Player->Mutex);
+    Player->Vehicles.clear();
+}
+
+TEST_CASE("TVehiclePosition::Parse") {
+    const auto Json = R"({"tim":10.428000331623,"vel":[-2.4171722121385e-05,-9.7184734153252e-06,-7.6420763232237e-06],"rot":[-0.0001296154171915,0.0031575385950029,0.98994906610295,0.14138903660382],"rvel":[5.3640324636461e-05,-9.9824529946024e-05,5.1664064641372e-05],"pos":[-0.27281248907838,-0.20515357944633,0.49695488960431],"ping":0.032999999821186})";
+    auto Position = TVehiclePosition::Parse(Json);
+    REQUIRE(Position.has_value());
+    CHECK(Position->Time == 10.428000331623);
+    CHECK(Position->Ping == 0.032999999821186);
+    CHECK(Position->Pos[2] == 0.49695488960431);
+    CHECK(Position->Rot[3] == 0.14138903660382);
+    CHECK(Position->RVel[1] == -9.9824529946024e-05);
+
+    // rebuilt json contains exactly the same values
+    auto Reparsed = TVehiclePosition::Parse(Position->ToJson());
+    REQUIRE(Reparsed.has_value());
+    CHECK(Reparsed->Pos == Position->Pos);
+    CHECK(Reparsed->Rot == Position->Rot);
+    CHECK(Reparsed->Time == Position->Time);
+
+    CHECK(!TVehiclePosition::Parse(R"({"tim":1,"ping":1,"pos":[1,2,3]})"));
+    CHECK(!TVehiclePosition::Parse(R"({"tim":1,"ping":1,"pos":[1,2,3],"rot":[0,0,0,1],"vel":[0,0,0],"rvel":[0,0,0],"extra":1})"));
+    CHECK(!TVehiclePosition::Parse(R"({"tim":1,"tim":1,"ping":1,"pos":[1,2,3],"rot":[0,0,0,1],"vel":[0,0,0]})"));
+    CHECK(!TVehiclePosition::Parse(R"({"tim":1,"ping":1,"pos":[1,2],"rot":[0,0,0,1],"vel":[0,0,0],"rvel":[0,0,0]})"));
+}
+
+TEST_CASE("TVehiclePositionStore") {
+    TVehiclePositionStore Store;
+    const std::string Json = R"({"tim":1.5,"ping":0.25,"pos":[1,2,3],"rot":[0,0,0,1],"vel":[4,5,6],"rvel":[0,0,0]})";
+    CHECK(Store.Set(2, 3, Json).has_value());
+    auto Position = Store.Get(2, 3);
+    REQUIRE(Position.has_value());
+    CHECK(Position->Vel == std::array<double, 3> { 4, 5, 6 });
+    CHECK(TVehiclePosition::Parse(Store.GetJson(2, 3))->Pos == Position->Pos);
+    CHECK(!Store.Get(2, 2));
+    CHECK(!Store.Get(3, 3));
+    CHECK(Store.GetJson(2, 2).empty());
+
+    // unknown formats are kept as they are
+    CHECK(!Store.Set(2, 3, R"({"something":"else"})"));
+    CHECK(!Store.Get(2, 3));
+    CHECK(Store.GetJson(2, 3) == R"({"something":"else"})");
+
+    // out of range IDs are ignored
+    CHECK(!Store.Set(-1, 0, Json));
+    CHECK(!Store.Set(0, int(TVehiclePositionStore::MaxVehiclesPerPlayer), Json));
+
+    Store.RemoveVehicle(2, 3);
+    CHECK(Store.GetJson(2, 3).empty());
+    (void)Store.Set(2, 0, Json);
+    Store.RemovePlayer(2);
+    CHECK(!Store.Get(2, 0));
+}
@@ -215,6 +215,10 @@ int BeamMPServerMain(MainArguments Arguments) {
     TNetwork Network(Server, PPSMonitor, ResourceManager);
     LuaEngine->SetNetwork(&Network);
     PPSMonitor.SetNetwork(Network);
+    std::unique_ptr<Http::Server::THttpServerInstance> HttpServer;
+    if (Application::Settings.getAsBool(Settings::Key::HTTP_Enabled)) {
+        HttpServer = std::make_unique<Http::Server::THttpServerInstance>(ResourceManager, Network.DownloadBandwidth());
+    }
     Application::CheckForUpdates();
 
     TPluginMonitor PluginMonitor(fs::path(Application::Settings.getAsString(Settings::Key::General_ResourceFolder)) / "Server", LuaEngine);
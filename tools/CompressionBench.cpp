@@ -0,0 +1,203 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*
+ * Compares the packet codecs on vehicle (Os/Oc) packets, and against zlib's one-shot
+ * compress()/uncompress(), which the server used to call for every packet.
+ *
+ * Usage: BeamMP-Server-compression-bench [--dictionary FILE] [FILE|DIRECTORY]...
+ *
+ * Every file is one packet as sent by the client (e.g. "Os:..." or "ABG:..."). Without
+ * arguments, generated vehicle packets are used instead, which are similar in structure
+ * to real ones, but compress a bit better. With a dictionary (see TrainDictionary.cpp), the
+ * dictionary codec is compared as well.
+ */
+
+#include "Compression.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <zlib.h>
+
+namespace fs = std::filesystem;
+
+using TPacket = std::vector<uint8_t>;
+
+static constexpr auto TimePerRun = std::chrono::milliseconds(500);
+
+static std::string GeneratedVehicleJson(int Seed) {
+    static const char* Slots[] = { "body", "door_FL", "door_FR", "hood", "tailgate", "bumper_F", "bumper_R", "fender_L", "fender_R",
+        "engine", "transmission", "differential_R", "suspension_F", "suspension_R", "wheel_FL", "wheel_FR", "wheel_RL", "wheel_RR",
+        "tire_F", "tire_R", "brake_F", "brake_R", "radiator", "exhaust", "intake", "fueltank", "interior", "seat_FL", "mirror_L", "mirror_R" };
+    std::string Json = R"({"jbm":"pickup","vcf":{"model":"pickup","partConfigFilename":"vehicles/pickup/d15_4wd_A.pc","mainPartName":"pickup"},"parts":{)";
+    for (size_t i = 0; i < std::size(Slots); ++i) {
+        Json += fmt::format(R"({}"pickup_{}":"pickup_{}_{}")", i == 0 ? "" : ",", Slots[i], Slots[i], (Seed + int(i)) % 3 == 0 ? "heavy" : "stock");
+    }
+    Json += R"(},"vars":{)";
+    for (int i = 0; i < 40; ++i) {
+        Json += fmt::format(R"({}"$var_{}":{:.3f})", i == 0 ? "" : ",", i, (Seed * 31 + i * 7) % 100 / 10.0);
+    }
+    Json += fmt::format(R"(}},"paints":[{{"baseColor":[0.{},0.2,0.3,1.2],"metallic":0.5,"roughness":0.5,"clearcoat":0.8,"clearcoatRoughness":0.1}}],"pos":[{},-{},0.2],"rot":[0,0,0.7,0.7]}})", Seed % 10, Seed * 13 % 1000, Seed * 7 % 1000);
+    return Json;
+}
+
+static std::map<std::string, std::vector<TPacket>> GeneratedPackets() {
+    std::map<std::string, std::vector<TPacket>> Packets;
+    for (int i = 0; i < 16; ++i) {
+        const auto Os = fmt::format("Os:USER:Player{}:{}-0:{}", i, i, GeneratedVehicleJson(i));
+        const auto Oc = fmt::format("Oc:{}-0:{}", i, GeneratedVehicleJson(i + 1));
+        Packets["Os"].emplace_back(Os.begin(), Os.end());
+        Packets["Oc"].emplace_back(Oc.begin(), Oc.end());
+    }
+    return Packets;
+}
+
+static void AddCapture(const fs::path& Path, std::map<std::string, std::vector<TPacket>>& Packets) {
+    std::ifstream File(Path, std::ios::binary);
+    TPacket Packet((std::istreambuf_iterator<char>(File)), std::istreambuf_iterator<char>());
+    Packet = Compression::DecompressPacket(std::move(Packet));
+    if (Packet.size() < 2) {
+        return;
+    }
+    Packets[std::string(Packet.begin(), Packet.begin() + 2)].push_back(std::move(Packet));
+}
+
+// calls `Fn` for all packets until `TimePerRun` has passed, returns the average time per packet
+static double MicrosPerPacket(const std::vector<TPacket>& Packets, const std::function<void(const TPacket&)>& Fn) {
+    using Clock = std::chrono::steady_clock;
+    size_t Count = 0;
+    const auto Start = Clock::now();
+    auto Now = Start;
+    while (Now - Start < TimePerRun) {
+        for (const auto& Packet : Packets) {
+            Fn(Packet);
+        }
+        Count += Packets.size();
+        Now = Clock::now();
+    }
+    return std::chrono::duration<double, std::micro>(Now - Start).count() / double(Count);
+}
+
+struct TBenchCodec {
+    std::string Name;
+    std::function<TPacket(const TPacket&)> Compress;
+    std::function<TPacket(const TPacket&)> Decompress;
+};
+
+static std::vector<TBenchCodec> BenchCodecs() {
+    std::vector<TBenchCodec> Result;
+    // what Comp() and DeComp() did before they used the codecs
+    Result.push_back({
+        "zlib (one-shot)",
+        [](const TPacket& In) {
+            TPacket Out(compressBound(uLong(In.size())));
+            uLongf Size = uLongf(Out.size());
+            compress(Out.data(), &Size, In.data(), uLong(In.size()));
+            Out.resize(Size);
+            return Out;
+        },
+        [](const TPacket& In) {
+            TPacket Out(In.size() * 5);
+            uLongf Size = uLongf(Out.size());
+            while (uncompress(Out.data(), &Size, In.data(), uLong(In.size())) == Z_BUF_ERROR) {
+                Out.resize(Out.size() * 2);
+                Size = uLongf(Out.size());
+            }
+            Out.resize(Size);
+            return Out;
+        },
+    });
+    for (const auto* Codec : Compression::Codecs()) {
+        Result.push_back({
+            std::string(Codec->Name()),
+            [Codec](const TPacket& In) {
+                TPacket Out;
+                Codec->Compress(In, Out);
+                return Out;
+            },
+            [Codec](const TPacket& In) {
+                TPacket Out;
+                Codec->Decompress(In, Out, Compression::MaxDecompressedSize);
+                return Out;
+            },
+        });
+    }
+    return Result;
+}
+
+int main(int argc, char** argv) {
+    std::map<std::string, std::vector<TPacket>> Packets;
+    bool HaveCaptures = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string_view(argv[i]) == "--dictionary" && i + 1 < argc) {
+            std::ifstream File(argv[++i], std::ios::binary);
+            (void)Compression::LoadDictionary({ std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>() });
+            continue;
+        }
+        HaveCaptures = true;
+        if (fs::is_directory(argv[i])) {
+            for (const auto& Entry : fs::recursive_directory_iterator(argv[i])) {
+                if (Entry.is_regular_file()) {
+                    AddCapture(Entry.path(), Packets);
+                }
+            }
+        } else {
+            AddCapture(argv[i], Packets);
+        }
+    }
+    if (!HaveCaptures) {
+        fmt::print("no captures given, using generated packets\n");
+        Packets = GeneratedPackets();
+    }
+    const auto Codecs = BenchCodecs();
+    fmt::print("{:<6} {:<16} {:>8} {:>10} {:>8} {:>14} {:>14}\n", "type", "codec", "packets", "avg size", "ratio", "comp us/pkt", "decomp us/pkt");
+    for (const auto& [Type, TypePackets] : Packets) {
+        size_t RawBytes = 0;
+        for (const auto& Packet : TypePackets) {
+            RawBytes += Packet.size();
+        }
+        for (const auto& Codec : Codecs) {
+            std::vector<TPacket> Compressed;
+            size_t CompressedBytes = 0;
+            for (const auto& Packet : TypePackets) {
+                Compressed.push_back(Codec.Compress(Packet));
+                CompressedBytes += Compressed.back().size();
+                if (Codec.Decompress(Compressed.back()) != Packet) {
+                    fmt::print(stderr, "{} failed to round-trip a {} packet\n", Codec.Name, Type);
+                    return 1;
+                }
+            }
+            const auto CompressTime = MicrosPerPacket(TypePackets, [&](const TPacket& Packet) { (void)Codec.Compress(Packet); });
+            const auto DecompressTime = MicrosPerPacket(Compressed, [&](const TPacket& Packet) {
+                // like the server does once a packet was handled
+                Compression::BufferPool().Release(Codec.Decompress(Packet));
+            });
+            fmt::print("{:<6} {:<16} {:>8} {:>10} {:>8.2f} {:>14.2f} {:>14.2f}\n", Type, Codec.Name, TypePackets.size(),
+                RawBytes / TypePackets.size(), double(RawBytes) / double(CompressedBytes), CompressTime, DecompressTime);
+        }
+    }
+}
@@ -0,0 +1,204 @@
+// BeamMP, the BeamNG.drive multiplayer mod.
+// Copyright (C) 2024 BeamMP Ltd., BeamMP team and contributors.
+//
+// BeamMP Ltd. can be contacted by electronic mail via contact@beammp.com.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*
+ * Builds a zlib dictionary for vehicle packets (Os/Oc) from captured packets.
+ *
+ * Usage: BeamMP-Server-train-dictionary CAPTURE_DIRECTORY OUTPUT_FILE [SIZE]
+ *
+ * Every file in the capture directory is one packet as sent by a client. The vehicle
+ * JSON of every 10th packet is held back and used to report how well the dictionary works.
+ *
+ * The dictionary is put together from short pieces of the training packets. Each piece
+ * is scored by how many packets contain its substrings, not counting substrings which
+ * already are in the dictionary, and the best pieces are taken until the dictionary is
+ * full. The best ones go last, as zlib encodes close matches more cheaply.
+ */
+
+#include "Compression.h"
+
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <iterator>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// substrings shorter than this aren't worth it, zlib's minimum match is 3 bytes
+static constexpr size_t SubstringLength = 8;
+static constexpr size_t PieceLength = 48;
+static constexpr size_t HeldBackEvery = 10;
+
+static uint64_t HashOf(std::string_view Str) {
+    // FNV-1a
+    uint64_t Hash = 14695981039346656037ull;
+    for (char C : Str) {
+        Hash = (Hash ^ uint8_t(C)) * 1099511628211ull;
+    }
+    return Hash;
+}
+
+static std::vector<std::string> ReadVehicleJson(const fs::path& Directory) {
+    std::vector<std::string> Documents;
+    for (const auto& Entry : fs::recursive_directory_iterator(Directory)) {
+        if (!Entry.is_regular_file()) {
+            continue;
+        }
+        std::ifstream File(Entry.path(), std::ios::binary);
+        std::vector<uint8_t> Packet((std::istreambuf_iterator<char>(File)), std::istreambuf_iterator<char>());
+        try {
+            Packet = Compression::DecompressPacket(std::move(Packet));
+        } catch (const std::exception& e) {
+            fmt::print(stderr, "skipping {}: {}\n", Entry.path().string(), e.what());
+            continue;
+        }
+        const std::string_view Str(reinterpret_cast<const char*>(Packet.data()), Packet.size());
+        const auto JsonStart = Str.find('{');
+        if ((Str.starts_with("Os:") || Str.starts_with("Oc:")) && JsonStart != std::string_view::npos) {
+            Documents.emplace_back(Str.substr(JsonStart));
+        }
+    }
+    return Documents;
+}
+
+static std::string Train(const std::vector<std::string>& Documents, size_t Size) {
+    // in how many documents each substring occurs
+    std::unordered_map<uint64_t, uint32_t> DocumentCounts;
+    for (const auto& Document : Documents) {
+        std::unordered_set<uint64_t> Seen;
+        for (size_t i = 0; i + SubstringLength <= Document.size(); ++i) {
+            Seen.insert(HashOf(std::string_view(Document).substr(i, SubstringLength)));
+        }
+        for (auto Hash : Seen) {
+            ++DocumentCounts[Hash];
+        }
+    }
+
+    struct TPiece {
+        std::string_view Text;
+        uint64_t Score;
+    };
+    std::unordered_set<uint64_t> Covered;
+    auto ScoreOf = [&](std::string_view Text) {
+        uint64_t Score = 0;
+        std::unordered_set<uint64_t> Counted;
+        for (size_t i = 0; i + SubstringLength <= Text.size(); ++i) {
+            const auto Hash = HashOf(Text.substr(i, SubstringLength));
+            // substrings which occur only once are useless
+            if (!Covered.contains(Hash) && Counted.insert(Hash).second && DocumentCounts[Hash] > 1) {
+                Score += DocumentCounts[Hash];
+            }
+        }
+        return Score;
+    };
+    auto Lower = [](const TPiece& A, const TPiece& B) { return A.Score < B.Score; };
+    std::priority_queue<TPiece, std::vector<TPiece>, decltype(Lower)> Candidates(Lower);
+    for (const auto& Document : Documents) {
+        // overlapping, so that a common string is fully in at least one piece
+        for (size_t i = 0; i < Document.size(); i += PieceLength / 2) {
+            const auto Text = std::string_view(Document).substr(i, PieceLength);
+            Candidates.push({ Text, ScoreOf(Text) });
+        }
+    }
+
+    std::vector<std::string_view> Chosen;
+    size_t ChosenSize = 0;
+    while (!Candidates.empty() && ChosenSize < Size) {
+        auto Best = Candidates.top();
+        Candidates.pop();
+        // scores only ever go down, so a piece whose updated score is still the best is the best
+        const auto Score = ScoreOf(Best.Text);
+        if (Score == 0) {
+            continue;
+        }
+        if (!Candidates.empty() && Score < Candidates.top().Score) {
+            Candidates.push({ Best.Text, Score });
+            continue;
+        }
+        for (size_t i = 0; i + SubstringLength <= Best.Text.size(); ++i) {
+            Covered.insert(HashOf(Best.Text.substr(i, SubstringLength)));
+        }
+        Chosen.push_back(Best.Text);
+        ChosenSize += Best.Text.size();
+    }
+
+    std::string Dictionary;
+    for (auto Iter = Chosen.rbegin(); Iter != Chosen.rend(); ++Iter) {
+        Dictionary += *Iter;
+    }
+    // the end of the dictionary is what's left after cutting it to size
+    if (Dictionary.size() > Size) {
+        Dictionary.erase(0, Dictionary.size() - Size);
+    }
+    return Dictionary;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3 || argc > 4) {
+        fmt::print(stderr, "Usage: {} CAPTURE_DIRECTORY OUTPUT_FILE [SIZE]\n", argv[0]);
+        return 1;
+    }
+    const size_t Size = argc == 4 ? std::stoul(argv[3]) : Compression::MaxDictionarySize;
+    if (Size == 0 || Size > Compression::MaxDictionarySize) {
+        fmt::print(stderr, "SIZE must be between 1 and {}\n", Compression::MaxDictionarySize);
+        return 1;
+    }
+
+    const auto Documents = ReadVehicleJson(argv[1]);
+    std::vector<std::string> Training;
+    std::vector<std::string> HeldBack;
+    for (size_t i = 0; i < Documents.size(); ++i) {
+        (i % HeldBackEvery == HeldBackEvery - 1 ? HeldBack : Training).push_back(Documents[i]);
+    }
+    if (Training.empty()) {
+        fmt::print(stderr, "no Os/Oc packets found in {}\n", argv[1]);
+        return 1;
+    }
+    fmt::print("training on {} vehicle packets, {} held back\n", Training.size(), HeldBack.size());
+
+    const auto Dictionary = Train(Training, Size);
+    std::ofstream Output(argv[2], std::ios::binary | std::ios::trunc);
+    Output.write(Dictionary.data(), std::streamsize(Dictionary.size()));
+    if (!Output) {
+        fmt::print(stderr, "failed to write {}\n", argv[2]);
+        return 1;
+    }
+    const auto Codec = Compression::MakeDictionaryCodec({ Dictionary.begin(), Dictionary.end() });
+    fmt::print("wrote {} bytes to {}, the codec is '{}'\n", Dictionary.size(), argv[2], Codec->Name());
+
+    size_t RawBytes = 0;
+    size_t ZlibBytes = 0;
+    size_t DictionaryBytes = 0;
+    for (const auto& Document : HeldBack) {
+        const std::span Data(reinterpret_cast<const uint8_t*>(Document.data()), Document.size());
+        RawBytes += Data.size();
+        ZlibBytes += Compression::CompressPacket(Compression::Zlib(), Data).size();
+        DictionaryBytes += Compression::CompressPacket(*Codec, Data).size();
+    }
+    if (RawBytes != 0) {
+        fmt::print("held back packets: {} bytes, {} with zlib, {} with the dictionary ({:.1f}% smaller)\n",
+            RawBytes, ZlibBytes, DictionaryBytes, 100.0 - 100.0 * double(DictionaryBytes) / double(ZlibBytes));
+    }
+}